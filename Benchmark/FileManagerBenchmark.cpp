@@ -0,0 +1,818 @@
+#include "..\FileManager\FileManager.h"
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <utility>
+
+#pragma comment(lib, "FileManager.lib")
+#pragma comment(lib, "LogManager.lib")
+
+// FileManager I/O suite, every result is printed and written as JSON (see WriteJson) to track regressions :
+//	- Sequential reads of 4 KB to maxSize files through every read path, cold (dropped from the system cache) and warm
+//	- Random reads (4 KB / 64 KB / 1 MB) in one big file, cold and warm
+//	- Sequential writes through every write path (returned, and flushed to the disk) and random writes
+//	- Small file overhead : open, size, read of SMALL_FILE_COUNT files one by one and with LoadBatch
+//	- EraseSection cost against the position and length of the section, for every EraseMode
+//	- Compression ratio and speed on binary (mesh), text (log) and random data
+// Each operation is timed on its own : throughput, IOPS and latency percentiles.
+// Usage : FileManagerBenchmark.exe [directory] [--max-size MB] [--json file]
+//	directory defaults to %TEMP%\myLibBenchmark, --max-size to 1024 (use 4096+ for the multi-GB points),
+//	--json to directory\FileManagerBenchmark.json. Test files are kept between runs.
+
+namespace {
+    constexpr size_t SMALL_FILE_COUNT = 10'000;
+    constexpr UINT32 SMALL_FILE_MIN_SIZE = 512;
+    constexpr UINT32 SMALL_FILE_MAX_SIZE = 16 * 1024;
+    constexpr size_t COMPRESSION_DATA_SIZE = 64 * 1024 * 1024;
+
+    constexpr UINT64 KB = 1024;
+    constexpr UINT64 MB = 1024 * KB;
+    constexpr UINT64 GB = 1024 * MB;
+    constexpr UINT64 SEQUENTIAL_SIZES[] = { 4 * KB, 64 * KB, MB, 16 * MB, 256 * MB, GB, 4 * GB, 16 * GB };
+    constexpr UINT64 RANDOM_BLOCK_SIZES[] = { 4 * KB, 64 * KB, MB };
+    constexpr UINT64 DEFAULT_MAX_SIZE = GB;
+    constexpr UINT64 TARGET_BYTES = GB;				// Per measure : small sizes are repeated up to this
+    constexpr UINT64 MIN_OPERATIONS = 3;
+    constexpr UINT64 MAX_OPERATIONS = 200;
+    constexpr UINT64 RANDOM_OPERATIONS = 10'000;
+    constexpr UINT64 PACKED_MAX_SIZE = 256 * MB;	// Archive and compressed copies are only made up to this
+    constexpr UINT64 PIECE_SIZE = MB;				// ReadScatter / WriteGather / AppendWriter granularity
+    constexpr UINT64 PATTERN_SIZE = 16 * MB;
+    constexpr UINT64 ERASE_FILE_SIZE = 256 * MB;
+    constexpr double ERASE_POSITIONS[] = { 0.0, 0.125, 0.25, 0.5, 0.75, 0.875, 1.0 };
+    constexpr UINT64 ERASE_LENGTHS[] = { 4 * KB, MB, 64 * MB };
+
+    using Clock = std::chrono::high_resolution_clock;
+    using FM = FileManager::FileManager;
+
+    // One measure : operations of size bytes, each timed
+    struct Result {
+        string group;
+        string operation;
+        string cache;		// cold / warm for reads, returned / flushed for writes
+        UINT64 size = 0;
+        UINT64 operations = 0;
+        UINT64 failures = 0;
+        UINT64 bytes = 0;
+        double seconds = 0.0;
+        vector<double> latenciesUs;
+        vector<std::pair<string, double>> extra;
+    };
+    vector<Result> results;
+
+    wstring DefaultDirectory() {
+        WCHAR buffer[MAX_PATH];
+        DWORD size = GetTempPathW(MAX_PATH, buffer);
+        return wstring(buffer, size) + L"myLibBenchmark";
+    }
+
+    string FormatSize(UINT64 size) {
+        if (size >= GB && size % GB == 0) {
+            return to_string(size / GB) + " GB";
+        }
+        if (size >= MB && size % MB == 0) {
+            return to_string(size / MB) + " MB";
+        }
+        if (size >= KB && size % KB == 0) {
+            return to_string(size / KB) + " KB";
+        }
+        return to_string(size) + " B";
+    }
+    wstring SizeTag(UINT64 size) {
+        string tag = FormatSize(size);
+        std::erase(tag, ' ');
+        return wstring(tag.begin(), tag.end());
+    }
+
+    // Deterministic sizes and content so runs are comparable
+    UINT32 NextRandom(UINT32& state) {
+        state = state * 1664525u + 1013904223u;
+        return state;
+    }
+
+    // Opening a file without buffering purges its pages from the system cache
+    void DropFromCache(const vector<wstring>& paths) {
+        FM::ClearHandleCache();
+        for (const wstring& path : paths) {
+            HANDLE hFile = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                nullptr, OPEN_EXISTING, FILE_FLAG_NO_BUFFERING, nullptr);
+            if (hFile != INVALID_HANDLE_VALUE) {
+                CloseHandle(hFile);
+            }
+        }
+    }
+    // Waits until everything written to path is on the disk
+    bool FlushToDisk(const wstring& path) {
+        HANDLE hFile = CreateFileW(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (hFile == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        BOOL success = FlushFileBuffers(hFile);
+        CloseHandle(hFile);
+        return success != FALSE;
+    }
+
+    template<typename Fn>
+    double MeasureMs(Fn&& fn) {
+        const auto start = Clock::now();
+        fn();
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    UINT64 OperationCount(UINT64 size) {
+        return std::clamp(TARGET_BYTES / size, MIN_OPERATIONS, MAX_OPERATIONS);
+    }
+
+    double Percentile(const vector<double>& sorted, double p) {
+        if (sorted.empty()) {
+            return 0.0;
+        }
+        size_t index = static_cast<size_t>(std::ceil(p * sorted.size()));
+        return sorted[std::clamp<size_t>(index, 1, sorted.size()) - 1];
+    }
+
+    void Print(const Result& result) {
+        vector<double> sorted = result.latenciesUs;
+        std::sort(sorted.begin(), sorted.end());
+
+        wprintf(L"%-16hs %-30hs %-8hs %7hs  %10.1f MB/s %10.0f IOPS   p50 %9.1f   p99 %9.1f   max %9.1f us%ls\n",
+            result.group.c_str(), result.operation.c_str(), result.cache.c_str(), FormatSize(result.size).c_str(),
+            result.seconds > 0.0 ? result.bytes / result.seconds / 1e6 : 0.0,
+            result.seconds > 0.0 ? result.operations / result.seconds : 0.0,
+            Percentile(sorted, 0.5), Percentile(sorted, 0.99), sorted.empty() ? 0.0 : sorted.back(),
+            result.failures != 0 ? L"   FAILED" : L"");
+    }
+
+    // Runs operation(i) count times, prepare(i) before each one (not timed). operation returns false on failure.
+    template<typename Prepare, typename Operation>
+    Result& Measure(string group, string operation, string cache, UINT64 size, UINT64 count, Prepare&& prepare, Operation&& run) {
+        Result result;
+        result.group = move(group);
+        result.operation = move(operation);
+        result.cache = move(cache);
+        result.size = size;
+        result.latenciesUs.reserve(count);
+
+        for (UINT64 i = 0; i < count; i++) {
+            prepare(i);
+
+            const auto start = Clock::now();
+            bool success = run(i);
+            const double us = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+
+            result.latenciesUs.push_back(us);
+            result.seconds += us / 1e6;
+            result.operations++;
+            if (success) [[likely]] {
+                result.bytes += size;
+            }
+            else {
+                result.failures++;
+            }
+        }
+
+        Print(result);
+        results.push_back(move(result));
+        return results.back();
+    }
+    constexpr auto NoPrepare = [](UINT64) {};
+
+    // Start : Test data
+    // Interleaved vertices (position, normal, uv) of a flat grid with a little noise, like a terrain chunk
+    vector<std::byte> MakeMeshData() {
+        struct Vertex {
+            float position[3];
+            float normal[3];
+            float uv[2];
+        };
+        const size_t side = static_cast<size_t>(std::sqrt(double(COMPRESSION_DATA_SIZE / sizeof(Vertex))));
+        UINT32 state = 7;
+
+        vector<Vertex> vertices;
+        vertices.reserve(side * side);
+        for (size_t z = 0; z < side; z++) {
+            for (size_t x = 0; x < side; x++) {
+                float height = float(NextRandom(state) >> 24) / 64.0f;
+                vertices.push_back({ { float(x), height, float(z) }, { 0.0f, 1.0f, 0.0f }, { float(x) / side, float(z) / side } });
+            }
+        }
+
+        vector<std::byte> data(vertices.size() * sizeof(Vertex));
+        std::memcpy(data.data(), vertices.data(), data.size());
+        return data;
+    }
+    // Lines shaped like the LogManager ones
+    vector<std::byte> MakeLogData() {
+        static const char* const sources[] = { "FileManager - ReadFile", "DX12 - Initialize", "ShaderManager - LoadShader", "Input - Update" };
+        static const char* const levels[] = { "INFO", "DEBUG", "WARNING", "ERROR" };
+        UINT32 state = 11;
+
+        string text;
+        text.reserve(COMPRESSION_DATA_SIZE + 256);
+        for (UINT64 line = 0; text.size() < COMPRESSION_DATA_SIZE; line++) {
+            UINT32 r = NextRandom(state);
+            text += "[12:" + to_string(line / 6000 % 60) + ":" + to_string(line / 100 % 60) + "." + to_string(line % 1000) + "] ";
+            text += string(levels[r & 3]) + " " + sources[(r >> 2) & 3] + " : (C:\\Assets\\Textures\\tex_" + to_string(r >> 20) + ".dds) ";
+            text += "Readed: " + to_string(r & 0xFFFF) + " / Should've been: " + to_string((r >> 8) & 0xFFFF) + "\n";
+        }
+        text.resize(COMPRESSION_DATA_SIZE);
+
+        vector<std::byte> data(text.size());
+        std::memcpy(data.data(), text.data(), data.size());
+        return data;
+    }
+    vector<std::byte> MakeRandomData() {
+        UINT32 state = 13;
+        vector<std::byte> data(COMPRESSION_DATA_SIZE);
+        for (std::byte& b : data) {
+            b = std::byte(NextRandom(state) >> 24);
+        }
+        return data;
+    }
+
+    bool CreateSmallFiles(const wstring& dir, vector<wstring>& paths) {
+        // With the trailing '\' FM::CreateFile would add, so the paths match the files it creates
+        wstring directory = dir;
+        if (!directory.empty() && directory.back() != L'\\') {
+            directory += L'\\';
+        }
+        UINT32 state = 42;
+        vector<std::byte> content(SMALL_FILE_MAX_SIZE);
+        for (std::byte& b : content) {
+            b = std::byte(NextRandom(state) >> 24);
+        }
+
+        paths.clear();
+        paths.reserve(SMALL_FILE_COUNT);
+        for (size_t i = 0; i < SMALL_FILE_COUNT; i++) {
+            wstring name = L"small_" + to_wstring(i) + L".bin";
+            wstring path = directory + name;
+            UINT32 size = SMALL_FILE_MIN_SIZE + NextRandom(state) % (SMALL_FILE_MAX_SIZE - SMALL_FILE_MIN_SIZE);
+
+            if (!FM::FileExists(path)) {
+                wstring dirPath = directory;    // FM::CreateFile modifies it
+                if (!FM::CreateFile(dirPath, name) ||
+                    !FM::WriteFile(path, std::span<const std::byte>(content.data(), size))) {
+                    wprintf(L"Couldn't create %ls\n", path.c_str());
+                    return false;
+                }
+            }
+            paths.push_back(path);
+        }
+        return true;
+    }
+    // size bytes of pattern repeated, kept if it already has the right size
+    bool CreateDataFile(const wstring& path, UINT64 size, std::span<const std::byte> pattern) {
+        UINT64 existingSize = 0;
+        if (FM::FileExists(path) && FM::GetFileSize(path, existingSize) && existingSize == size) {
+            return true;
+        }
+
+        FileManager::AppendWriter writer;
+        if (!writer.Open(path, true)) {
+            return false;
+        }
+        for (UINT64 written = 0; written < size; written += pattern.size()) {
+            if (!writer.Append(pattern.first(static_cast<size_t>(std::min<UINT64>(pattern.size(), size - written))))) {
+                return false;
+            }
+        }
+        return writer.Close();
+    }
+    // End : Test data
+
+    // Start : Sequential reads
+    struct SequentialFiles {
+        wstring directory;
+        vector<UINT64> sizes;
+        std::shared_ptr<FileManager::Archive> archive;
+        FileManager::VirtualFileSystem::MountId archiveMount = FileManager::VirtualFileSystem::INVALID_MOUNT;
+
+        wstring Path(UINT64 size) const { return directory + L"\\seq_" + SizeTag(size) + L".bin"; }
+        wstring PackedSource(UINT64 size) const { return directory + L"\\pak\\seq_" + SizeTag(size) + L".bin"; }
+        wstring PackedPath(UINT64 size) const { return directory + L"\\packed\\seq_" + SizeTag(size) + L".bin"; }
+        wstring CompressedPath(UINT64 size) const { return directory + L"\\seq_" + SizeTag(size) + L".mflz"; }
+        wstring ArchivePath() const { return directory + L"\\seq.pak"; }
+    };
+
+    bool PrepareSequentialFiles(SequentialFiles& files, std::span<const std::byte> pattern) {
+        const wstring pakDirectory = files.directory + L"\\pak";
+        if (!FM::DirectoryExists(pakDirectory) && CreateDirectoryW(pakDirectory.c_str(), nullptr) == FALSE) {
+            return false;
+        }
+
+        bool rebuildArchive = false;
+        for (UINT64 size : files.sizes) {
+            if (!CreateDataFile(files.Path(size), size, pattern)) {
+                wprintf(L"Couldn't create %ls\n", files.Path(size).c_str());
+                return false;
+            }
+            if (size > PACKED_MAX_SIZE) {
+                continue;
+            }
+
+            if (!FM::FileExists(files.PackedSource(size))) {
+                CopyFileW(files.Path(size).c_str(), files.PackedSource(size).c_str(), FALSE);
+                rebuildArchive = true;
+            }
+            if (!FM::FileExists(files.CompressedPath(size))) {
+                FileManager::BufferLease content;
+                if (!FM::ReadFile(files.Path(size), content) || !FM::WriteFileCompressed(files.CompressedPath(size), content.GetSpan())) {
+                    wprintf(L"Couldn't create %ls\n", files.CompressedPath(size).c_str());
+                    return false;
+                }
+            }
+        }
+
+        if ((rebuildArchive || !FM::FileExists(files.ArchivePath())) && !FileManager::Archive::Build(pakDirectory, files.ArchivePath())) {
+            wprintf(L"Couldn't build %ls\n", files.ArchivePath().c_str());
+            return false;
+        }
+
+        files.archive = std::make_shared<FileManager::Archive>();
+        if (!files.archive->Open(files.ArchivePath())) {
+            wprintf(L"Couldn't open %ls\n", files.ArchivePath().c_str());
+            return false;
+        }
+        files.archiveMount = FM::MountArchive(files.directory + L"\\packed", files.archive);
+        return files.archiveMount != FileManager::VirtualFileSystem::INVALID_MOUNT;
+    }
+
+    void BenchmarkSequentialReads(SequentialFiles& files) {
+        wprintf(L"\nSequential reads\n");
+
+        for (UINT64 size : files.sizes) {
+            const wstring path = files.Path(size);
+            const UINT64 count = OperationCount(size);
+
+            FileManager::AlignedBuffer buffer(static_cast<size_t>(size));
+            vector<std::span<std::byte>> pieces;
+            for (UINT64 offset = 0; offset < size; offset += PIECE_SIZE) {
+                pieces.push_back(buffer.GetSpan().subspan(static_cast<size_t>(offset), static_cast<size_t>(std::min(PIECE_SIZE, size - offset))));
+            }
+            FileManager::AlignedBuffer whole;
+            vector<std::byte> decompressed;
+            const vector<wstring> batchPaths = { path };
+
+            for (bool cold : { true, false }) {
+                const string cache = cold ? "cold" : "warm";
+                auto drop = [&](UINT64) {
+                    if (cold) {
+                        DropFromCache({ path });
+                    }
+                };
+
+                Measure("sequential_read", "ReadFile (member data)", cache, size, count, drop, [&](UINT64) {
+                    FM fm;
+                    return fm.ReadFile(path);
+                });
+                Measure("sequential_read", "ReadFile (span)", cache, size, count, drop, [&](UINT64) {
+                    return FM::ReadFile(path, buffer.GetSpan());
+                });
+                Measure("sequential_read", "ReadFile (BufferLease)", cache, size, count, drop, [&](UINT64) {
+                    FileManager::BufferLease lease;
+                    return FM::ReadFile(path, lease);
+                });
+                Measure("sequential_read", "ReadFileUnbuffered (span)", cache, size, count, drop, [&](UINT64) {
+                    return FM::ReadFileUnbuffered(path, buffer.GetSpan());
+                });
+                Measure("sequential_read", "ReadFileUnbuffered (Aligned)", cache, size, count, drop, [&](UINT64) {
+                    return FM::ReadFileUnbuffered(path, whole);
+                });
+                Measure("sequential_read", "ReadScatter", cache, size, count, drop, [&](UINT64) {
+                    return FM::ReadScatter(path, 0, pieces);
+                });
+                Measure("sequential_read", "LoadBatch", cache, size, count, drop, [&](UINT64) {
+                    return FM::LoadBatch(batchPaths).failedCount == 0;
+                });
+
+                if (size > PACKED_MAX_SIZE) {
+                    continue;
+                }
+
+                // The archive keeps its mapping : it has to be closed for its pages to be dropped
+                Measure("sequential_read", "Archive (mounted)", cache, size, count, [&](UINT64) {
+                    if (cold) {
+                        // Remounted : the mount indexes the entries of the mapping being replaced
+                        FM::UnmountArchive(files.archiveMount);
+                        files.archive->Close();
+                        DropFromCache({ files.ArchivePath() });
+                        files.archive->Open(files.ArchivePath());
+                        files.archiveMount = FM::MountArchive(files.directory + L"\\packed", files.archive);
+                    }
+                }, [&](UINT64) {
+                    return FM::ReadFile(files.PackedPath(size), buffer.GetSpan());
+                });
+
+                const wstring compressedPath = files.CompressedPath(size);
+                Measure("sequential_read", "ReadFileCompressed", cache, size, count, [&](UINT64) {
+                    if (cold) {
+                        DropFromCache({ compressedPath });
+                    }
+                }, [&](UINT64) {
+                    return FM::ReadFileCompressed(compressedPath, decompressed);
+                });
+            }
+        }
+    }
+    // End : Sequential reads
+
+    // Start : Random reads
+    void BenchmarkRandomReads(const wstring& path, UINT64 fileSize) {
+        wprintf(L"\nRandom reads in a %hs file\n", FormatSize(fileSize).c_str());
+
+        for (UINT64 blockSize : RANDOM_BLOCK_SIZES) {
+            if (blockSize > fileSize) {
+                continue;
+            }
+
+            // Same offsets for every path, aligned so the unbuffered path reads in place
+            const UINT64 count = std::min(RANDOM_OPERATIONS, fileSize / blockSize);
+            vector<UINT64> offsets(count);
+            UINT32 state = 17;
+            for (UINT64& offset : offsets) {
+                const UINT64 slots = (fileSize - blockSize) / (4 * KB) + 1;
+                offset = ((UINT64(NextRandom(state)) << 16 ^ NextRandom(state)) % slots) * (4 * KB);
+            }
+
+            FileManager::AlignedBuffer buffer(static_cast<size_t>(blockSize));
+            std::span<std::byte> target = buffer.GetSpan();
+
+            for (bool cold : { true, false }) {
+                const string cache = cold ? "cold" : "warm";
+                // Cold : dropped once, a run over a big file mostly misses. Warm : the whole file is read first.
+                auto prepare = [&]() {
+                    if (cold) {
+                        DropFromCache({ path });
+                        return;
+                    }
+                    FileManager::AlignedBuffer chunk(static_cast<size_t>(PATTERN_SIZE));
+                    for (UINT64 offset = 0; offset < fileSize; offset += PATTERN_SIZE) {
+                        FM::ReadFile(path, chunk.GetSpan().first(static_cast<size_t>(std::min(PATTERN_SIZE, fileSize - offset))), offset);
+                    }
+                };
+
+                prepare();
+                Measure("random_read", "ReadFile (span)", cache, blockSize, count, NoPrepare, [&](UINT64 i) {
+                    return FM::ReadFile(path, target, offsets[i]);
+                });
+                prepare();
+                Measure("random_read", "ReadFile (BufferLease)", cache, blockSize, count, NoPrepare, [&](UINT64 i) {
+                    FileManager::BufferLease lease;
+                    return FM::ReadFile(path, lease, offsets[i], offsets[i] + blockSize);
+                });
+                prepare();
+                Measure("random_read", "ReadFileUnbuffered (span)", cache, blockSize, count, NoPrepare, [&](UINT64 i) {
+                    return FM::ReadFileUnbuffered(path, target, offsets[i]);
+                });
+            }
+        }
+    }
+    // End : Random reads
+
+    // Start : Writes
+    void BenchmarkSequentialWrites(const wstring& directory, const vector<UINT64>& sizes, std::span<const std::byte> pattern) {
+        wprintf(L"\nSequential writes\n");
+        const wstring path = directory + L"\\write.bin";
+
+        for (UINT64 size : sizes) {
+            const UINT64 count = std::clamp(TARGET_BYTES / 2 / size, MIN_OPERATIONS, MAX_OPERATIONS);
+
+            FileManager::AlignedBuffer buffer(static_cast<size_t>(size));
+            for (UINT64 offset = 0; offset < size; offset += pattern.size()) {
+                const size_t chunk = static_cast<size_t>(std::min<UINT64>(pattern.size(), size - offset));
+                std::memcpy(buffer.GetData() + offset, pattern.data(), chunk);
+            }
+            vector<std::span<const std::byte>> pieces;
+            for (UINT64 offset = 0; offset < size; offset += PIECE_SIZE) {
+                pieces.push_back(std::as_const(buffer).GetSpan().subspan(static_cast<size_t>(offset), static_cast<size_t>(std::min(PIECE_SIZE, size - offset))));
+            }
+            const std::span<const std::byte> data = std::as_const(buffer).GetSpan();
+
+            for (bool flushed : { false, true }) {
+                const string cache = flushed ? "flushed" : "returned";
+                auto finish = [&](bool success) { return success && (!flushed || FlushToDisk(path)); };
+
+                Measure("sequential_write", "SaveFile", cache, size, count, NoPrepare, [&](UINT64) {
+                    return finish(FM::SaveFile(path, data));
+                });
+                // The overwriting paths start from the file SaveFile left, of the right size
+                FM::InvalidateHandle(path);
+                Measure("sequential_write", "WriteFile (span, overwrite)", cache, size, count, NoPrepare, [&](UINT64) {
+                    return finish(FM::WriteFile(path, data, 0));
+                });
+                Measure("sequential_write", "WriteGather (overwrite)", cache, size, count, NoPrepare, [&](UINT64) {
+                    return finish(FM::WriteGather(path, 0, pieces));
+                });
+                Measure("sequential_write", "AppendWriter", cache, size, count, NoPrepare, [&](UINT64) {
+                    FileManager::AppendWriter writer;
+                    bool success = writer.Open(path, true);
+                    for (std::span<const std::byte> piece : pieces) {
+                        success = success && writer.Append(piece);
+                    }
+                    return finish(writer.Close() && success);
+                });
+                if (size <= PACKED_MAX_SIZE) {
+                    Measure("sequential_write", "WriteFileCompressed", cache, size, count, NoPrepare, [&](UINT64) {
+                        return finish(FM::WriteFileCompressed(path, data));
+                    });
+                }
+            }
+        }
+
+        FM::InvalidateHandle(path);
+        FM::DeleteFile(path);
+    }
+
+    void BenchmarkRandomWrites(const wstring& directory, UINT64 fileSize, std::span<const std::byte> pattern) {
+        wprintf(L"\nRandom writes in a %hs file\n", FormatSize(fileSize).c_str());
+        const wstring path = directory + L"\\random_write.bin";
+        if (!CreateDataFile(path, fileSize, pattern)) {
+            wprintf(L"Couldn't create %ls\n", path.c_str());
+            return;
+        }
+
+        for (UINT64 blockSize : RANDOM_BLOCK_SIZES) {
+            if (blockSize > fileSize) {
+                continue;
+            }
+
+            const UINT64 count = std::min(RANDOM_OPERATIONS, fileSize / blockSize);
+            vector<UINT64> offsets(count);
+            UINT32 state = 19;
+            for (UINT64& offset : offsets) {
+                const UINT64 slots = (fileSize - blockSize) / (4 * KB) + 1;
+                offset = ((UINT64(NextRandom(state)) << 16 ^ NextRandom(state)) % slots) * (4 * KB);
+            }
+            const std::span<const std::byte> block = pattern.first(static_cast<size_t>(blockSize));
+
+            Result& result = Measure("random_write", "WriteFile (span)", "returned", blockSize, count, NoPrepare, [&](UINT64 i) {
+                return FM::WriteFile(path, block, offsets[i]);
+            });
+            // What the run left in the system cache
+            result.extra.push_back({ "flushMs", MeasureMs([&] { FlushToDisk(path); }) });
+        }
+
+        FM::InvalidateHandle(path);
+    }
+    // End : Writes
+
+    // Start : Small files
+    void BenchmarkSmallFiles(const vector<wstring>& paths) {
+        wprintf(L"\n%zu small files (%u - %u bytes)\n", paths.size(), SMALL_FILE_MIN_SIZE, SMALL_FILE_MAX_SIZE);
+
+        UINT64 totalSize = 0;
+        for (const wstring& path : paths) {
+            UINT64 size = 0;
+            FM::GetFileSize(path, size);
+            totalSize += size;
+        }
+        const UINT64 averageSize = totalSize / paths.size();
+        const UINT64 count = paths.size();
+
+        for (bool cold : { true, false }) {
+            const string cache = cold ? "cold" : "warm";
+            auto prepare = [&]() {
+                if (cold) {
+                    DropFromCache(paths);
+                }
+            };
+
+            // Baseline : what the OS charges for an open
+            prepare();
+            Measure("small_files", "CreateFileW + CloseHandle", cache, 0, count, NoPrepare, [&](UINT64 i) {
+                HANDLE hFile = CreateFileW(paths[i].c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+                if (hFile == INVALID_HANDLE_VALUE) {
+                    return false;
+                }
+                CloseHandle(hFile);
+                return true;
+            });
+            prepare();
+            Measure("small_files", "FileExists", cache, 0, count, NoPrepare, [&](UINT64 i) {
+                return FM::FileExists(paths[i]);
+            });
+            prepare();
+            Measure("small_files", "GetFileSize", cache, 0, count, NoPrepare, [&](UINT64 i) {
+                UINT64 size = 0;
+                return FM::GetFileSize(paths[i], size);
+            });
+            prepare();
+            Measure("small_files", "ReadFile (member data)", cache, averageSize, count, NoPrepare, [&](UINT64 i) {
+                FM fm;
+                return fm.ReadFile(paths[i]);
+            });
+            prepare();
+            Measure("small_files", "ReadFile (BufferLease)", cache, averageSize, count, NoPrepare, [&](UINT64 i) {
+                FileManager::BufferLease lease;
+                return FM::ReadFile(paths[i], lease);
+            });
+
+            // One operation for the whole batch, the per file cost is in extra
+            prepare();
+            Result& batch = Measure("small_files", "LoadBatch", cache, totalSize, 1, NoPrepare, [&](UINT64) {
+                return FM::LoadBatch(paths).failedCount == 0;
+            });
+            batch.extra.push_back({ "files", double(paths.size()) });
+            batch.extra.push_back({ "usPerFile", batch.seconds * 1e6 / paths.size() });
+        }
+    }
+    // End : Small files
+
+    // Start : EraseSection
+    void BenchmarkEraseSection(const wstring& directory, const wstring& sourcePath, UINT64 fileSize) {
+        wprintf(L"\nEraseSection in a %hs file\n", FormatSize(fileSize).c_str());
+        const wstring path = directory + L"\\erase.bin";
+
+        static constexpr std::pair<FileManager::EraseMode, const char*> modes[] = {
+            { FileManager::EraseMode::Compact, "EraseSection (Compact)" },
+            { FileManager::EraseMode::Zero, "EraseSection (Zero)" },
+            { FileManager::EraseMode::PunchHole, "EraseSection (PunchHole)" },
+        };
+
+        for (const auto& [mode, name] : modes) {
+            for (UINT64 length : ERASE_LENGTHS) {
+                if (length >= fileSize) {
+                    continue;
+                }
+                for (double position : ERASE_POSITIONS) {
+                    const UINT64 offset = static_cast<UINT64>(position * (fileSize - length)) / (4 * KB) * (4 * KB);
+
+                    // A fresh copy every time : Compact shrinks the file, PunchHole makes it sparse
+                    Result& result = Measure("erase_section", name, "warm", length, 1, [&](UINT64) {
+                        FM::InvalidateHandle(path);
+                        CopyFileW(sourcePath.c_str(), path.c_str(), FALSE);
+                    }, [&](UINT64) {
+                        return FM::EraseSection(path, offset, offset + length, mode);
+                    });
+                    result.extra.push_back({ "offset", double(offset) });
+                    result.extra.push_back({ "tailBytes", double(fileSize - offset - length) });
+                }
+            }
+        }
+
+        FM::InvalidateHandle(path);
+        FM::DeleteFile(path);
+    }
+    // End : EraseSection
+
+    void BenchmarkCompression(const char* name, const vector<std::byte>& data) {
+        vector<std::byte> frame;
+        vector<std::byte> restored(data.size());
+
+        Result& compress = Measure("compression", string(name) + " Compress", "memory", data.size(), 1, NoPrepare, [&](UINT64) {
+            frame = FileManager::Compression::Compress(data);
+            return true;
+        });
+        compress.extra.push_back({ "ratio", double(data.size()) / frame.size() });
+
+        Measure("compression", string(name) + " Decompress (1 thread)", "memory", data.size(), 1, NoPrepare, [&](UINT64) {
+            return FileManager::Compression::Decompress(frame, restored, 1);
+        });
+        Measure("compression", string(name) + " Decompress", "memory", data.size(), 1, NoPrepare, [&](UINT64) {
+            return FileManager::Compression::Decompress(frame, restored) && std::memcmp(data.data(), restored.data(), data.size()) == 0;
+        });
+    }
+
+    // Start : JSON
+    string Escape(const string& text) {
+        string escaped;
+        for (char c : text) {
+            if (c == '"' || c == '\\') {
+                escaped += '\\';
+            }
+            escaped += c;
+        }
+        return escaped;
+    }
+    string Number(double value) {
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%.3f", value);
+        return buffer;
+    }
+
+    bool WriteJson(const wstring& jsonPath, const wstring& directory, UINT64 maxSize) {
+        SYSTEMTIME time;
+        GetSystemTime(&time);
+        char timestamp[32];
+        snprintf(timestamp, sizeof(timestamp), "%04u-%02u-%02uT%02u:%02u:%02uZ",
+            time.wYear, time.wMonth, time.wDay, time.wHour, time.wMinute, time.wSecond);
+
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+
+        string json = "{\n  \"version\": 1,\n  \"timestamp\": \"" + string(timestamp) + "\",\n";
+        json += "  \"machine\": { \"logicalProcessors\": " + to_string(info.dwNumberOfProcessors)
+            + ", \"pageSize\": " + to_string(info.dwPageSize) + " },\n";
+        json += "  \"settings\": { \"directory\": \"" + Escape(string(directory.begin(), directory.end()))
+            + "\", \"maxSize\": " + to_string(maxSize) + " },\n";
+        json += "  \"results\": [";
+
+        for (size_t i = 0; i < results.size(); i++) {
+            const Result& result = results[i];
+            vector<double> sorted = result.latenciesUs;
+            std::sort(sorted.begin(), sorted.end());
+
+            json += i == 0 ? "\n" : ",\n";
+            json += "    { \"group\": \"" + Escape(result.group) + "\", \"operation\": \"" + Escape(result.operation)
+                + "\", \"cache\": \"" + result.cache + "\", \"size\": " + to_string(result.size)
+                + ", \"operations\": " + to_string(result.operations) + ", \"failures\": " + to_string(result.failures)
+                + ", \"bytes\": " + to_string(result.bytes) + ", \"seconds\": " + Number(result.seconds)
+                + ", \"throughputMBs\": " + Number(result.seconds > 0.0 ? result.bytes / result.seconds / 1e6 : 0.0)
+                + ", \"iops\": " + Number(result.seconds > 0.0 ? result.operations / result.seconds : 0.0)
+                + ", \"latencyUs\": { \"min\": " + Number(sorted.empty() ? 0.0 : sorted.front())
+                + ", \"p50\": " + Number(Percentile(sorted, 0.5)) + ", \"p90\": " + Number(Percentile(sorted, 0.9))
+                + ", \"p99\": " + Number(Percentile(sorted, 0.99)) + ", \"p999\": " + Number(Percentile(sorted, 0.999))
+                + ", \"max\": " + Number(sorted.empty() ? 0.0 : sorted.back()) + " }";
+
+            for (const auto& [key, value] : result.extra) {
+                json += ", \"" + key + "\": " + Number(value);
+            }
+            json += " }";
+        }
+        json += "\n  ]\n}\n";
+
+        return FM::SaveFile(jsonPath, std::as_bytes(std::span(json.data(), json.size())));
+    }
+    // End : JSON
+}
+
+int wmain(int argc, wchar_t** argv) {
+    wstring dir = DefaultDirectory();
+    wstring jsonPath;
+    UINT64 maxSize = DEFAULT_MAX_SIZE;
+
+    for (int i = 1; i < argc; i++) {
+        const wstring arg = argv[i];
+        if (arg == L"--max-size" && i + 1 < argc) {
+            maxSize = std::wcstoull(argv[++i], nullptr, 10) * MB;
+        }
+        else if (arg == L"--json" && i + 1 < argc) {
+            jsonPath = argv[++i];
+        }
+        else {
+            dir = arg;
+        }
+    }
+    if (jsonPath.empty()) {
+        jsonPath = dir + L"\\FileManagerBenchmark.json";
+    }
+
+    if (!FM::DirectoryExists(dir) && CreateDirectoryW(dir.c_str(), nullptr) == FALSE) {
+        wprintf(L"Couldn't create %ls\n", dir.c_str());
+        return 1;
+    }
+
+    // Start : Test data
+    const vector<std::byte> mesh = MakeMeshData();
+    const std::span<const std::byte> pattern = std::span(mesh).first(static_cast<size_t>(PATTERN_SIZE));
+
+    SequentialFiles files;
+    files.directory = dir;
+    for (UINT64 size : SEQUENTIAL_SIZES) {
+        if (size <= maxSize) {
+            files.sizes.push_back(size);
+        }
+    }
+
+    if (files.sizes.empty()) {
+        wprintf(L"--max-size is smaller than the smallest file (%hs)\n", FormatSize(SEQUENTIAL_SIZES[0]).c_str());
+        return 1;
+    }
+
+    vector<wstring> smallPaths;
+    if (!CreateSmallFiles(dir, smallPaths) || !PrepareSequentialFiles(files, pattern)) {
+        return 1;
+    }
+    // End : Test data
+
+    BenchmarkSequentialReads(files);
+
+    // The biggest file up to 1 GB : big enough that random reads aren't served by the drive cache
+    const UINT64 randomFileSize = *std::prev(std::upper_bound(files.sizes.begin(), files.sizes.end(), GB));
+    BenchmarkRandomReads(files.Path(randomFileSize), randomFileSize);
+
+    BenchmarkSequentialWrites(dir, files.sizes, pattern);
+    BenchmarkRandomWrites(dir, randomFileSize, pattern);
+    BenchmarkSmallFiles(smallPaths);
+
+    const UINT64 eraseFileSize = *std::prev(std::upper_bound(files.sizes.begin(), files.sizes.end(), ERASE_FILE_SIZE));
+    BenchmarkEraseSection(dir, files.Path(eraseFileSize), eraseFileSize);
+
+    wprintf(L"\nCompression (%zu MB, %u KB blocks)\n", COMPRESSION_DATA_SIZE >> 20, FileManager::Compression::DEFAULT_BLOCK_SIZE >> 10);
+    BenchmarkCompression("Mesh", mesh);
+    BenchmarkCompression("Log", MakeLogData());
+    BenchmarkCompression("Random", MakeRandomData());
+
+    FM::UnmountArchive(files.archiveMount);
+
+    if (!WriteJson(jsonPath, dir, maxSize)) {
+        wprintf(L"Couldn't write %ls\n", jsonPath.c_str());
+        return 1;
+    }
+    wprintf(L"\n%zu results written to %ls\n", results.size(), jsonPath.c_str());
+    return 0;
+}
@@ -46,9 +46,7 @@ namespace DX12 {
 
 
 		auto& shader = dxPipelineManager.GetShaderManager();
-		shader.LoadShader(rt);
-		shader.LoadShader(vs);
-		shader.LoadShader(ps);
+		shader.LoadShaders({ rt, vs, ps });
 
 		dxPipelineManager.SetRootSignature(rt);
 		dxPipelineManager.CreateMaterialPSO("basicMat", vs, ps);
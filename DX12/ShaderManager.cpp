@@ -23,30 +23,91 @@ namespace DX12 {
 	}
 	
 	bool ShaderManager::LoadShader(const std::string& name) {
-		if (pathToShader.empty()) [[unlikely]] {
+		if (pathToShader.IsEmpty()) [[unlikely]] {
 			LOG_ERROR(L"ShaderManager - LoadShader", L"pathToShader is empty");
 			return false;
 		}
 		
-		std::wstring fullPath = pathToShader + L"\\" + std::wstring(name.begin(), name.end());
+		const FileManager::VirtualPath shaderPath = pathToShader / std::wstring(name.begin(), name.end());
+		const std::wstring& fullPath = shaderPath.Get();
 
-		FileManager::FileManager fm;
-		if (!fm.FileExists(fullPath)) [[unlikely]] {
-			LOG_WARNING(L"ShaderManager - LoadShader", L"File (" + fullPath + L") doesn't exist");
-			return false;
-		}
-		if (!fm.ReadFile(fullPath)) [[unlikely]] {
+		// ReadFile already reports a missing file, no need to probe it first
+		FileManager::ContentCache::Content shader = FileManager::FileManager::ReadFileCached(fullPath);
+		if (!shader) [[unlikely]] {
 			LOG_WARNING(L"ShaderManager - LoadShader", L"File (" + fullPath + L") couldn't be readed");
 			return false;
 		}
 
-		cachedShader[name] = fm.MoveData();
-		if (cachedShader[name].empty()) [[unlikely]] {
+		cachedShader[name] = move(shader);
+		if (cachedShader[name]->GetSize() == 0) [[unlikely]] {
 			LOG_WARNING("ShaderManager - LoadShader", "Shader (" + name + ") is empty");
 		}
 
 		return true;
 	}
+	bool ShaderManager::LoadShaders(const std::vector<std::string>& names) {
+		if (pathToShader.IsEmpty()) [[unlikely]] {
+			LOG_ERROR(L"ShaderManager - LoadShaders", L"pathToShader is empty");
+			return false;
+		}
+
+		std::vector<std::wstring> fullPaths;
+		fullPaths.reserve(names.size());
+		for (const std::string& name : names) {
+			fullPaths.push_back((pathToShader / std::wstring(name.begin(), name.end())).Get());
+		}
+
+		// Start : Cached shaders
+		FileManager::ContentCache& contentCache = FileManager::FileManager::GetContentCache();
+
+		std::vector<size_t> missing;
+		std::vector<std::wstring> missingPaths;
+		std::vector<FileManager::ContentCache::PendingInsert> pending;
+		for (size_t i = 0; i < names.size(); i++) {
+			if (FileManager::ContentCache::Content shader = contentCache.Find(fullPaths[i])) {
+				cachedShader[names[i]] = move(shader);
+				continue;
+			}
+			missing.push_back(i);
+			missingPaths.push_back(fullPaths[i]);
+			// Before the read : a shader saved while the batch runs isn't cached with its old bytes
+			pending.push_back(contentCache.BeginInsert(fullPaths[i]));
+		}
+		if (missing.empty()) {
+			return true;
+		}
+		// End : Cached shaders
+
+		FileManager::BatchResult batch = FileManager::FileManager::LoadBatch(missingPaths);
+
+		for (size_t j = 0; j < missing.size(); j++) {
+			const size_t i = missing[j];
+			if (!batch.Succeeded(j)) [[unlikely]] {
+				contentCache.CancelInsert(pending[j]);
+				LOG_WARNING(L"ShaderManager - LoadShaders", L"File (" + fullPaths[i] + L") couldn't be readed");
+				continue;
+			}
+
+			std::span<const std::byte> shader = batch.Get(j);
+			if (shader.empty()) [[unlikely]] {
+				LOG_WARNING("ShaderManager - LoadShaders", "Shader (" + names[i] + ") is empty");
+			}
+
+			cachedShader[names[i]] = contentCache.EndInsert(pending[j], shader);
+		}
+
+		return batch.failedCount == 0;
+	}
+	std::span<const UINT8> ShaderManager::GetShader(const std::string& name) const {
+		auto it = cachedShader.find(name);
+		if (it == cachedShader.end()) [[unlikely]] {
+			LOG_ERROR(L"ShaderManager - GetShader", L"Shader doesn't exist");
+			return {};
+		}
+
+		std::span<const std::byte> shader = it->second->GetSpan();
+		return { reinterpret_cast<const UINT8*>(shader.data()), shader.size() };
+	}
 	bool ShaderManager::UnloadShader(const std::string& name) {
 		if (!cachedShader.contains(name)) {
 			LOG_WARNING("ShaderManager - UnloadShader", "cachedShader doesn't contains " + name);
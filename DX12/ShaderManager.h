@@ -1,5 +1,11 @@
 #pragma once
 #include "include.h"
+#include "..\FileManager\VirtualFileSystem.h"
+#include <span>
+
+namespace FileManager {
+	class CachedFile;
+}
 
 namespace DX12 {
 	class ShaderManager {
@@ -8,18 +14,16 @@ namespace DX12 {
 		ShaderManager(const std::string path);
 
 		bool LoadShader(const std::string& name);
+		// Reads every shader concurrently (FileManager::LoadBatch), false if any of them failed
+		bool LoadShaders(const std::vector<std::string>& names);
 		bool UnloadShader(const std::string& name);
 
-		inline const std::vector<UINT8>& GetShader(const std::string& name) {
-			auto it = cachedShader.find(name);
-			if (it == cachedShader.end()) {
-				LOG_ERROR(L"ShaderManager - GetShader", L"Shader doesn't exist");
-			}
-			return it->second;
-		}
+		// Empty if the shader isn't loaded
+		std::span<const UINT8> GetShader(const std::string& name) const;
 	private:
-		std::wstring pathToShader;
+		FileManager::VirtualPath pathToShader;
 
-		std::unordered_map<std::string, std::vector<UINT8>> cachedShader;
+		// Shared with FileManager's ContentCache : a shader loaded twice (or by another ShaderManager) is read once
+		std::unordered_map<std::string, std::shared_ptr<const FileManager::CachedFile>> cachedShader;
 	};
 }
@@ -0,0 +1,48 @@
+#include "AlignedBuffer.h"
+#include "FileManager.h"
+#include <utility>
+
+namespace FileManager {
+
+    AlignedBuffer& AlignedBuffer::operator=(AlignedBuffer&& other) noexcept {
+        if (this != &other) {
+            Release();
+            data = std::exchange(other.data, nullptr);
+            bufferSize = std::exchange(other.bufferSize, 0);
+            capacity = std::exchange(other.capacity, 0);
+        }
+        return *this;
+    }
+
+    bool AlignedBuffer::Allocate(size_t size) {
+        if (size <= capacity) {
+            bufferSize = size;
+            return true;
+        }
+
+        Release();
+
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        const size_t newCapacity = (size + info.dwPageSize - 1) / info.dwPageSize * info.dwPageSize;
+
+        data = static_cast<std::byte*>(VirtualAlloc(nullptr, newCapacity, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+        if (!data) [[unlikely]] {
+            LOG_ERROR("AlignedBuffer - Allocate", "VirtualAlloc failed for " + to_string(newCapacity) + " bytes");
+            return false;
+        }
+
+        bufferSize = size;
+        capacity = newCapacity;
+        return true;
+    }
+    void AlignedBuffer::Release() {
+        if (data) {
+            VirtualFree(data, 0, MEM_RELEASE);
+            data = nullptr;
+        }
+        bufferSize = 0;
+        capacity = 0;
+    }
+
+}
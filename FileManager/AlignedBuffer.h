@@ -0,0 +1,38 @@
+#pragma once
+#include "include.h"
+
+namespace FileManager {
+
+	// Page aligned memory (VirtualAlloc), usable for unbuffered I/O on any volume : pages are a multiple of every sector size.
+	// The capacity is rounded up to whole pages, size is the part in use.
+	class AlignedBuffer {
+	public:
+		AlignedBuffer() = default;
+		explicit AlignedBuffer(size_t size) { Allocate(size); }
+		AlignedBuffer(const AlignedBuffer&) = delete;
+		AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+		AlignedBuffer(AlignedBuffer&& other) noexcept { *this = move(other); }
+		AlignedBuffer& operator=(AlignedBuffer&& other) noexcept;
+		~AlignedBuffer() { Release(); }
+
+		// Makes room for size bytes, the content isn't kept if it has to grow
+		bool Allocate(size_t size);
+		void Release();
+		// Changes the size in use, within the capacity
+		void SetSize(size_t newSize) { bufferSize = std::min(newSize, capacity); }
+
+		std::byte* GetData() { return data; }
+		const std::byte* GetData() const { return data; }
+		size_t GetSize() const { return bufferSize; }
+		size_t GetCapacity() const { return capacity; }
+
+		std::span<std::byte> GetSpan() { return { data, bufferSize }; }
+		std::span<const std::byte> GetSpan() const { return { data, bufferSize }; }
+
+	private:
+		std::byte* data = nullptr;
+		size_t bufferSize = 0;
+		size_t capacity = 0;
+	};
+
+}
@@ -0,0 +1,207 @@
+#include "AppendWriter.h"
+#include "FileManager.h"
+
+namespace FileManager {
+
+    namespace {
+        constexpr DWORD MAX_IO_SIZE = 1 << 30;     // ::WriteFile takes a DWORD size
+    }
+
+    bool AppendWriter::Open(const wstring& path, bool truncate, UINT64 extent, size_t buffer) {
+        if (IsOpen()) {
+            LOG_WARNING(L"AppendWriter - Open", L"Already writing (" + filePath + L"), call Close first");
+            return false;
+        }
+
+        // A cached handle would see a stale size once we are done
+        FileManager::InvalidateHandle(path);
+
+        // Start : Get HANDLE
+        hFile = CreateFileW(
+            path.c_str(),
+            GENERIC_READ | GENERIC_WRITE,
+            FILE_SHARE_READ,
+            nullptr,
+            truncate ? CREATE_ALWAYS : OPEN_ALWAYS,
+            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+            nullptr
+        );
+
+        if (hFile == INVALID_HANDLE_VALUE) [[unlikely]] {
+            LOG_ERROR(L"AppendWriter - Open", L"(" + path + L") CreateFileW failed with error " + to_wstring(GetLastError()));
+            return false;
+        }
+        // End : Get HANDLE
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(hFile, &fileSize)) [[unlikely]] {
+            LOG_ERROR(L"AppendWriter - Open", L"(" + path + L") Couldn't get the file size");
+            CloseHandle(hFile);
+            hFile = INVALID_HANDLE_VALUE;
+            return false;
+        }
+
+        filePath = path;
+        extentSize = std::max<UINT64>(extent, 64 * 1024);
+        bufferSize = std::max<size_t>(buffer, 4096);
+        tail = fileSize.QuadPart;
+        writtenEnd = tail;
+        allocated = tail;
+
+        filling.clear();
+        filling.reserve(bufferSize);
+        writing.clear();
+        writing.reserve(bufferSize);
+        writePending = false;
+        stopping = false;
+        failed = false;
+
+        thread = std::jthread(&AppendWriter::Worker, this);
+        return true;
+    }
+
+    bool AppendWriter::Append(std::span<const std::byte> data) {
+        if (!IsOpen() || failed) [[unlikely]] {
+            return false;
+        }
+
+        while (!data.empty()) {
+            size_t count = std::min(data.size(), bufferSize - filling.size());
+            filling.insert(filling.end(), data.begin(), data.begin() + count);
+            data = data.subspan(count);
+            tail += count;
+
+            if (filling.size() == bufferSize) {
+                std::unique_lock<std::mutex> lock(mtx);
+                Submit(lock);
+                if (failed) [[unlikely]] {
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+    void AppendWriter::Submit(std::unique_lock<std::mutex>& lock) {
+        cv.wait(lock, [&] { return !writePending; });
+
+        std::swap(filling, writing);
+        filling.clear();
+        writePending = true;
+        cv.notify_all();
+    }
+
+    bool AppendWriter::Flush() {
+        if (!IsOpen()) {
+            return false;
+        }
+
+        std::unique_lock<std::mutex> lock(mtx);
+        if (!filling.empty()) {
+            Submit(lock);
+        }
+        cv.wait(lock, [&] { return !writePending; });
+
+        return !failed;
+    }
+
+    bool AppendWriter::Close() {
+        if (!IsOpen()) {
+            return false;
+        }
+
+        bool success = Flush();
+
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        cv.notify_all();
+        thread.join();
+
+        // Start : Trim the preallocation
+        FILE_END_OF_FILE_INFO endOfFile;
+        endOfFile.EndOfFile.QuadPart = writtenEnd;
+        FILE_ALLOCATION_INFO allocation;
+        allocation.AllocationSize.QuadPart = writtenEnd;
+
+        if (!SetFileInformationByHandle(hFile, FileEndOfFileInfo, &endOfFile, sizeof(endOfFile)) ||
+            !SetFileInformationByHandle(hFile, FileAllocationInfo, &allocation, sizeof(allocation))) [[unlikely]] {
+            LOG_ERROR(L"AppendWriter - Close", L"(" + filePath + L") Couldn't truncate at offset " + to_wstring(writtenEnd));
+            success = false;
+        }
+        // End : Trim the preallocation
+
+        CloseHandle(hFile);
+        hFile = INVALID_HANDLE_VALUE;
+        filePath.clear();
+        filling = vector<std::byte>();
+        writing = vector<std::byte>();
+
+        return success;
+    }
+
+    bool AppendWriter::Reserve(UINT64 end) {
+        if (end <= allocated) [[likely]] {
+            return true;
+        }
+
+        const UINT64 newAllocated = (end + extentSize - 1) / extentSize * extentSize;
+        FILE_ALLOCATION_INFO allocation;
+        allocation.AllocationSize.QuadPart = newAllocated;
+
+        if (!SetFileInformationByHandle(hFile, FileAllocationInfo, &allocation, sizeof(allocation))) [[unlikely]] {
+            // Not fatal : the file system grows the file on its own, just in smaller pieces
+            LOG_WARNING(L"AppendWriter - Reserve", L"(" + filePath + L") Couldn't preallocate " + to_wstring(newAllocated) + L" bytes");
+            return false;
+        }
+
+        allocated = newAllocated;
+        return true;
+    }
+
+    void AppendWriter::Worker() {
+        std::unique_lock<std::mutex> lock(mtx);
+
+        while (true) {
+            cv.wait(lock, [&] { return writePending || stopping; });
+            if (!writePending) {
+                return;
+            }
+
+            // writing belongs to this thread until writePending is cleared
+            lock.unlock();
+
+            Reserve(writtenEnd + writing.size());
+
+            bool success = true;
+            for (size_t done = 0; done < writing.size();) {
+                DWORD bytesToWrite = static_cast<DWORD>(std::min<size_t>(writing.size() - done, MAX_IO_SIZE));
+                DWORD bytesWritten = 0;
+
+                OVERLAPPED overlapped = { 0 };
+                overlapped.Offset = (DWORD)((writtenEnd + done) & 0xFFFFFFFF);
+                overlapped.OffsetHigh = (DWORD)((writtenEnd + done) >> 32);
+
+                if (!::WriteFile(hFile, writing.data() + done, bytesToWrite, &bytesWritten, &overlapped) || bytesWritten != bytesToWrite) [[unlikely]] {
+                    LOG_ERROR(L"AppendWriter - Worker", L"(" + filePath + L") WriteFile failed at offset " + to_wstring(writtenEnd + done));
+                    success = false;
+                    break;
+                }
+                done += bytesWritten;
+            }
+
+            lock.lock();
+            if (success) [[likely]] {
+                writtenEnd += writing.size();
+            }
+            else {
+                failed = true;
+            }
+            writing.clear();
+            writePending = false;
+            cv.notify_all();
+        }
+    }
+
+}
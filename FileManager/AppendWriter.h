@@ -0,0 +1,61 @@
+#pragma once
+#include "include.h"
+
+namespace FileManager {
+
+	// Sequential writer for high rate record streams (telemetry, replays, captures).
+	// The file is grown in large preallocated extents so it ends up in a few contiguous runs,
+	//	appended records are buffered and written behind on a background thread (two buffers : one filled, one written),
+	//	and the preallocated space past the last record is released on Close.
+	class AppendWriter {
+	public:
+		static constexpr UINT64 DEFAULT_EXTENT_SIZE = 64 * 1024 * 1024;
+		static constexpr size_t DEFAULT_BUFFER_SIZE = 4 * 1024 * 1024;
+
+		AppendWriter() = default;
+		AppendWriter(const AppendWriter&) = delete;
+		AppendWriter& operator=(const AppendWriter&) = delete;
+		~AppendWriter() { Close(); }
+
+		// Creates filePath or appends to it (truncate = false). Other processes can read it while it is written.
+		bool Open(const wstring& filePath, bool truncate = false,
+			UINT64 extentSize = DEFAULT_EXTENT_SIZE, size_t bufferSize = DEFAULT_BUFFER_SIZE);
+		// Only copies into the current buffer, unless it is full and the previous one is still being written
+		bool Append(std::span<const std::byte> data);
+		// Waits until everything appended so far is handed to the OS
+		bool Flush();
+		// Flushes, trims the unused preallocation and closes the file
+		bool Close();
+
+		bool IsOpen() const { return hFile != INVALID_HANDLE_VALUE; }
+		// Offset of the next appended byte (the logical size of the file)
+		UINT64 GetTail() const { return tail; }
+
+	private:
+		// Hands the filled buffer to the worker, waiting for the previous write if needed (mtx must be held)
+		void Submit(std::unique_lock<std::mutex>& lock);
+		void Worker();
+		// Grows the allocation by whole extents so [0, end) is reserved
+		bool Reserve(UINT64 end);
+
+		wstring filePath;
+		HANDLE hFile = INVALID_HANDLE_VALUE;
+		UINT64 extentSize = DEFAULT_EXTENT_SIZE;
+		size_t bufferSize = DEFAULT_BUFFER_SIZE;
+
+		UINT64 tail = 0;			// Caller side : includes what is still buffered
+		UINT64 writtenEnd = 0;		// Worker side : end of what was written
+		UINT64 allocated = 0;
+
+		vector<std::byte> filling;	// Caller thread
+		vector<std::byte> writing;	// Worker thread while writePending
+
+		std::mutex mtx;
+		std::condition_variable cv;
+		bool writePending = false;
+		bool stopping = false;
+		std::atomic<bool> failed = false;	// Checked by Append without the lock
+		std::jthread thread;
+	};
+
+}
@@ -0,0 +1,375 @@
+#include "Archive.h"
+#include "FileManager.h"
+#include <bit>
+#include <cstring>
+#include <numeric>
+
+namespace FileManager {
+
+    namespace {
+        constexpr UINT64 AlignUp(UINT64 value, UINT64 alignment) {
+            return (value + alignment - 1) & ~(alignment - 1);
+        }
+    }
+
+    bool Archive::Open(const wstring& path) {
+        Close();
+        archivePath = path;
+
+        // Start : Map the archive
+        hFile = CreateFileW(
+            archivePath.c_str(),
+            GENERIC_READ,
+            FILE_SHARE_DELETE | FILE_SHARE_READ,
+            nullptr,
+            OPEN_EXISTING,
+            FILE_FLAG_RANDOM_ACCESS,
+            nullptr
+        );
+
+        if (hFile == INVALID_HANDLE_VALUE) [[unlikely]] {
+            LOG_WARNING(L"Archive - Open", L"(" + archivePath + L") Couldn't open the archive");
+            return false;
+        }
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(hFile, &fileSize) || UINT64(fileSize.QuadPart) < sizeof(Header)) [[unlikely]] {
+            LOG_WARNING(L"Archive - Open", L"(" + archivePath + L") Too small to be an archive");
+            Close();
+            return false;
+        }
+        viewSize = fileSize.QuadPart;
+
+        hMapping = CreateFileMappingW(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!hMapping) [[unlikely]] {
+            LOG_ERROR(L"Archive - Open", L"(" + archivePath + L") CreateFileMappingW failed");
+            Close();
+            return false;
+        }
+
+        view = static_cast<const std::byte*>(MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0));
+        if (!view) [[unlikely]] {
+            LOG_ERROR(L"Archive - Open", L"(" + archivePath + L") MapViewOfFile failed");
+            Close();
+            return false;
+        }
+        // End : Map the archive
+
+        if (!Validate()) [[unlikely]] {
+            LOG_WARNING(L"Archive - Open", L"(" + archivePath + L") Invalid or corrupted archive");
+            Close();
+            return false;
+        }
+
+        return true;
+    }
+    void Archive::Close() {
+        if (view) {
+            UnmapViewOfFile(view);
+            view = nullptr;
+        }
+        if (hMapping) {
+            CloseHandle(hMapping);
+            hMapping = nullptr;
+        }
+        if (hFile != INVALID_HANDLE_VALUE) {
+            CloseHandle(hFile);
+            hFile = INVALID_HANDLE_VALUE;
+        }
+
+        viewSize = 0;
+        header = nullptr;
+        entries = nullptr;
+        buckets = nullptr;
+        names = nullptr;
+    }
+
+    bool Archive::Validate() {
+        auto inBounds = [&](UINT64 offset, UINT64 size) {
+            return offset <= viewSize && size <= viewSize - offset;
+        };
+
+        header = reinterpret_cast<const Header*>(view);
+        if (header->magic != MAGIC || header->version != VERSION) {
+            return false;
+        }
+        if (!std::has_single_bit(header->bucketCount) || header->bucketCount <= header->entryCount) {
+            return false;
+        }
+
+        // Start : Tables
+        if (header->entriesOffset % alignof(Entry) != 0 || !inBounds(header->entriesOffset, UINT64(header->entryCount) * sizeof(Entry))) {
+            return false;
+        }
+        if (header->bucketsOffset % alignof(UINT32) != 0 || !inBounds(header->bucketsOffset, UINT64(header->bucketCount) * sizeof(UINT32))) {
+            return false;
+        }
+        if (header->namesOffset % alignof(WCHAR) != 0 || header->namesSize > viewSize || !inBounds(header->namesOffset, header->namesSize * sizeof(WCHAR))) {
+            return false;
+        }
+
+        entries = reinterpret_cast<const Entry*>(view + header->entriesOffset);
+        buckets = reinterpret_cast<const UINT32*>(view + header->bucketsOffset);
+        names = reinterpret_cast<const WCHAR*>(view + header->namesOffset);
+        // End : Tables
+
+        // Start : Entries
+        for (UINT32 i = 0; i < header->entryCount; i++) {
+            const Entry& entry = entries[i];
+
+            if (!inBounds(entry.offset, entry.storedSize)) {
+                return false;
+            }
+            if (UINT64(entry.nameOffset) + entry.nameLength > header->namesSize) {
+                return false;
+            }
+            if (!(entry.flags & ENTRY_COMPRESSED) && entry.storedSize != entry.size) {
+                return false;
+            }
+            // Readers size their buffers from entry.size before decompressing : it has to be the frame's
+            //	(which can't claim more than its stored bytes decode to)
+            if (entry.flags & ENTRY_COMPRESSED) {
+                UINT64 frameSize = 0;
+                if (!Compression::GetDecompressedSize({ view + entry.offset, entry.storedSize }, frameSize) || frameSize != entry.size) {
+                    return false;
+                }
+            }
+        }
+        // Each entry in exactly one bucket : with bucketCount > entryCount some bucket stays empty and ends every probe
+        vector<bool> bucketed(header->entryCount, false);
+        for (UINT32 i = 0; i < header->bucketCount; i++) {
+            const UINT32 index = buckets[i];
+            if (index == 0) {
+                continue;
+            }
+            if (index > header->entryCount || bucketed[index - 1]) {
+                return false;
+            }
+            bucketed[index - 1] = true;
+        }
+        if (std::ranges::find(bucketed, false) != bucketed.end()) {
+            return false;
+        }
+        // End : Entries
+
+        return true;
+    }
+
+    wstring Archive::NormalizePath(std::wstring_view path) {
+        wstring normalized(path.size(), L'\0');
+        normalized.resize(NormalizePath(path, normalized));
+        return normalized;
+    }
+    size_t Archive::NormalizePath(std::wstring_view path, std::span<WCHAR> destination) {
+        if (path.starts_with(L".\\") || path.starts_with(L"./")) {
+            path.remove_prefix(2);
+        }
+
+        size_t size = 0;
+        // A UNC path (\\server\share, \\?\...) keeps its two leading separators : it isn't relative
+        if (path.size() > 2 && (path[0] == L'/' || path[0] == L'\\') && (path[1] == L'/' || path[1] == L'\\')) {
+            destination[size++] = L'\\';
+            destination[size++] = L'\\';
+            path.remove_prefix(2);
+        }
+
+        for (WCHAR c : path) {
+            if (c == L'/' || c == L'\\') {
+                // No leading or doubled separator
+                if (size == 0 || destination[size - 1] == L'\\') {
+                    continue;
+                }
+                destination[size++] = L'\\';
+            }
+            else {
+                destination[size++] = static_cast<WCHAR>(towlower(c));
+            }
+        }
+
+        return size;
+    }
+    UINT64 Archive::HashPath(std::wstring_view normalizedPath) {
+        return Hasher::Hash(std::as_bytes(std::span(normalizedPath.data(), normalizedPath.size())));
+    }
+
+    const Archive::Entry* Archive::Find(std::wstring_view path) const {
+        return FindNormalized(NormalizePath(path));
+    }
+    const Archive::Entry* Archive::FindNormalized(std::wstring_view normalizedPath) const {
+        if (!IsOpen()) [[unlikely]] {
+            return nullptr;
+        }
+
+        const UINT64 hash = HashPath(normalizedPath);
+        const UINT32 mask = header->bucketCount - 1;
+
+        // The table is never full (bucketCount > entryCount, checked by Validate), an empty bucket ends the probe.
+        //	Still never more than one lap.
+        UINT32 bucket = UINT32(hash) & mask;
+        for (UINT32 probe = 0; probe < header->bucketCount; probe++, bucket = (bucket + 1) & mask) {
+            UINT32 index = buckets[bucket];
+            if (index == 0) {
+                return nullptr;
+            }
+
+            const Entry& entry = entries[index - 1];
+            if (entry.pathHash == hash && std::wstring_view(names + entry.nameOffset, entry.nameLength) == normalizedPath) [[likely]] {
+                return &entry;
+            }
+        }
+        return nullptr;
+    }
+
+    bool Archive::GetView(std::wstring_view path, std::span<const std::byte>& data) const {
+        const Entry* entry = Find(path);
+        if (!entry || (entry->flags & ENTRY_COMPRESSED)) {
+            return false;
+        }
+
+        data = { view + entry->offset, entry->size };
+        return true;
+    }
+    bool Archive::Prefetch(const Entry& entry) const {
+        if (!IsOpen() || entry.storedSize == 0) {
+            return IsOpen();
+        }
+
+        WIN32_MEMORY_RANGE_ENTRY range = { const_cast<std::byte*>(view + entry.offset), static_cast<SIZE_T>(entry.storedSize) };
+        if (!PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0)) [[unlikely]] {
+            LOG_WARNING(L"Archive - Prefetch", L"(" + archivePath + L") PrefetchVirtualMemory failed with error " + to_wstring(GetLastError()));
+            return false;
+        }
+        return true;
+    }
+    bool Archive::Read(const Entry& entry, std::span<std::byte> destination, UINT64 offset) const {
+        if (offset > entry.size || destination.size() > entry.size - offset) [[unlikely]] {
+            LOG_WARNING("Archive - Read", "Reading past the end of the entry : "
+                + to_string(offset) + " + " + to_string(destination.size()) + " > " + to_string(entry.size));
+            return false;
+        }
+
+        if (!(entry.flags & ENTRY_COMPRESSED)) {
+            std::memcpy(destination.data(), view + entry.offset + offset, destination.size());
+            return true;
+        }
+
+        std::span<const std::byte> frame(view + entry.offset, entry.storedSize);
+        if (offset == 0 && destination.size() == entry.size) [[likely]] {
+            return Compression::Decompress(frame, destination);
+        }
+
+        // Partial read : blocks aren't addressed individually here, the whole entry is decompressed
+        BufferLease content = BufferPool::Acquire(entry.size);
+        if (!Compression::Decompress(frame, content.GetSpan())) [[unlikely]] {
+            return false;
+        }
+        std::memcpy(destination.data(), content.GetData() + offset, destination.size());
+        return true;
+    }
+
+    bool Archive::Build(const wstring& dirPath, const wstring& archivePath, bool compress) {
+        DirectoryListing listing = FileManager::Enumerate(dirPath, true);
+
+        // Start : Sort (same directory -> same archive)
+        vector<wstring> normalizedPaths(listing.GetCount());
+        for (size_t i = 0; i < listing.GetCount(); i++) {
+            normalizedPaths[i] = NormalizePath(listing.GetPath(i));
+        }
+
+        vector<size_t> order(listing.GetCount());
+        std::iota(order.begin(), order.end(), size_t(0));
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return normalizedPaths[a] < normalizedPaths[b]; });
+        // End : Sort
+
+        Header header = {};
+        if (!FileManager::SaveFile(archivePath, std::as_bytes(std::span(&header, 1)))) {
+            LOG_ERROR(L"Archive - Build", L"(" + archivePath + L") Couldn't create the archive");
+            return false;
+        }
+
+        // Start : Entry data
+        vector<Entry> entries;
+        wstring names;
+        vector<std::byte> content;
+        vector<std::byte> frame;
+        UINT64 offset = AlignUp(sizeof(Header), DATA_ALIGNMENT);
+
+        for (size_t index : order) {
+            const wstring& path = normalizedPaths[index];
+            if (!entries.empty() && std::wstring_view(names).substr(entries.back().nameOffset) == path) {
+                LOG_WARNING(L"Archive - Build", L"(" + path + L") Duplicated once normalized, skipped");
+                continue;
+            }
+
+            const UINT64 size = listing.GetEntry(index).size;
+            content.resize(size);
+            if (!FileManager::ReadFile(listing.GetFullPath(index), std::span<std::byte>(content))) {
+                LOG_ERROR(L"Archive - Build", L"(" + listing.GetFullPath(index) + L") Couldn't be read");
+                FileManager::InvalidateHandle(archivePath);
+                return false;
+            }
+
+            std::span<const std::byte> stored(content);
+            UINT32 flags = ENTRY_NONE;
+            if (compress) {
+                frame = Compression::Compress(content);
+                if (frame.size() < size) {
+                    stored = frame;
+                    flags = ENTRY_COMPRESSED;
+                }
+            }
+
+            if (!FileManager::WriteFile(archivePath, stored, offset)) {
+                LOG_ERROR(L"Archive - Build", L"(" + listing.GetFullPath(index) + L") Couldn't be packed");
+                FileManager::InvalidateHandle(archivePath);
+                return false;
+            }
+
+            entries.push_back({ HashPath(path), offset, stored.size(), size, static_cast<UINT32>(names.size()), static_cast<UINT32>(path.size()), flags, 0 });
+            names += path;
+            offset = AlignUp(offset + stored.size(), DATA_ALIGNMENT);
+        }
+        // End : Entry data
+
+        // Start : Tables
+        header.magic = MAGIC;
+        header.version = VERSION;
+        header.entryCount = static_cast<UINT32>(entries.size());
+        header.bucketCount = std::bit_ceil(std::max<UINT32>(header.entryCount * 2, 2));
+        header.entriesOffset = offset;
+        header.bucketsOffset = header.entriesOffset + entries.size() * sizeof(Entry);
+        header.namesOffset = header.bucketsOffset + header.bucketCount * sizeof(UINT32);
+        header.namesSize = names.size();
+
+        vector<UINT32> buckets(header.bucketCount, 0);
+        const UINT32 mask = header.bucketCount - 1;
+        for (UINT32 i = 0; i < header.entryCount; i++) {
+            UINT32 bucket = UINT32(entries[i].pathHash) & mask;
+            while (buckets[bucket] != 0) {
+                bucket = (bucket + 1) & mask;
+            }
+            buckets[bucket] = i + 1;
+        }
+
+        const std::span<const std::byte> tables[] = {
+            std::as_bytes(std::span(entries)),
+            std::as_bytes(std::span(buckets)),
+            std::as_bytes(std::span(names.data(), names.size())),
+        };
+        // End : Tables
+
+        bool success = FileManager::WriteGather(archivePath, header.entriesOffset, tables) &&
+            FileManager::WriteFile(archivePath, std::as_bytes(std::span(&header, 1)), 0);
+
+        FileManager::InvalidateHandle(archivePath);
+
+        if (!success) {
+            LOG_ERROR(L"Archive - Build", L"(" + archivePath + L") Couldn't write the tables");
+            return false;
+        }
+
+        LOG_INFO(L"Archive - Build", L"(" + archivePath + L") " + to_wstring(header.entryCount) + L" files packed");
+        return true;
+    }
+
+}
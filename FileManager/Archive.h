@@ -0,0 +1,95 @@
+#pragma once
+#include "include.h"
+
+namespace FileManager {
+
+	// Packed asset archive (.pak), read through a mapped view.
+	//	Header | entry data, each on its own page | Entry table | hash buckets | names
+	// Paths are normalized (lower case, '\' separators, no leading '\') and hashed once,
+	//	a lookup is one probe in a power of 2 open addressing table.
+	class Archive {
+	public:
+		static constexpr UINT32 MAGIC = 0x4B41504D;	// "MPAK"
+		static constexpr UINT32 VERSION = 1;
+		static constexpr UINT64 DATA_ALIGNMENT = 4096;
+
+		enum EntryFlags : UINT32 {
+			ENTRY_NONE = 0,
+			ENTRY_COMPRESSED = 1 << 0,
+		};
+
+		struct Header {
+			UINT32 magic;
+			UINT32 version;
+			UINT32 entryCount;
+			UINT32 bucketCount;		// Power of 2
+			UINT64 entriesOffset;
+			UINT64 bucketsOffset;
+			UINT64 namesOffset;
+			UINT64 namesSize;		// In WCHAR
+		};
+		struct Entry {
+			UINT64 pathHash;
+			UINT64 offset;			// DATA_ALIGNMENT aligned
+			UINT64 storedSize;		// Size in the archive (a Compression frame if ENTRY_COMPRESSED)
+			UINT64 size;			// Size once decompressed (== storedSize if not compressed)
+			UINT32 nameOffset;		// In WCHAR, inside names
+			UINT32 nameLength;
+			UINT32 flags;
+			UINT32 reserved;
+		};
+
+		Archive() = default;
+		Archive(const Archive&) = delete;
+		Archive& operator=(const Archive&) = delete;
+		~Archive() { Close(); }
+
+		// Maps the archive and validates every table and entry bound once
+		bool Open(const wstring& archivePath);
+		void Close();
+		bool IsOpen() const { return view != nullptr; }
+		const wstring& GetPath() const { return archivePath; }
+
+		// Entry of path (any case or separator), nullptr if missing
+		const Entry* Find(std::wstring_view path) const;
+		// Same with a path already passed through NormalizePath
+		const Entry* FindNormalized(std::wstring_view normalizedPath) const;
+		bool Contains(std::wstring_view path) const { return Find(path) != nullptr; }
+
+		// Zero-copy view on an uncompressed entry, valid as long as the archive is open
+		bool GetView(std::wstring_view path, std::span<const std::byte>& data) const;
+		// Copies (decompressing if needed) exactly destination.size() bytes of the entry from offset
+		bool Read(const Entry& entry, std::span<std::byte> destination, UINT64 offset = 0) const;
+		// Starts paging the stored bytes of the entry in (PrefetchVirtualMemory) without waiting for them
+		bool Prefetch(const Entry& entry) const;
+
+		UINT32 GetEntryCount() const { return header ? header->entryCount : 0; }
+		const Entry& GetEntry(UINT32 index) const { return entries[index]; }
+		std::wstring_view GetEntryPath(UINT32 index) const { return { names + entries[index].nameOffset, entries[index].nameLength }; }
+
+		// Packs every file under dirPath (recursively) into archivePath.
+		// compress stores each file as a Compression frame, unless it doesn't get smaller.
+		static bool Build(const wstring& dirPath, const wstring& archivePath, bool compress = false);
+
+		// Lowercase, '\\' separators, no leading ".\\" nor leading or doubled separator (but a UNC prefix)
+		static wstring NormalizePath(std::wstring_view path);
+		// Same, without allocating : destination must hold path.size() characters, returns the normalized size
+		static size_t NormalizePath(std::wstring_view path, std::span<WCHAR> destination);
+		static UINT64 HashPath(std::wstring_view normalizedPath);
+
+	private:
+		bool Validate();
+
+		wstring archivePath;
+		HANDLE hFile = INVALID_HANDLE_VALUE;
+		HANDLE hMapping = nullptr;
+		const std::byte* view = nullptr;
+		UINT64 viewSize = 0;
+
+		const Header* header = nullptr;
+		const Entry* entries = nullptr;
+		const UINT32* buckets = nullptr;	// Entry index + 1, 0 is empty
+		const WCHAR* names = nullptr;
+	};
+
+}
@@ -0,0 +1,251 @@
+#include "Blob.h"
+#include "FileManager.h"
+
+namespace FileManager {
+
+    static_assert(sizeof(Blob::Header) == 32, "Blob::Header is part of the file format");
+
+    // Start : BlobBuilder
+    bool BlobBuilder::Open(const wstring& path, UINT32 id, UINT32 version) {
+        if (IsOpen()) [[unlikely]] {
+            LOG_WARNING(L"BlobBuilder - Open", L"Already building (" + filePath + L"), call Finish or Cancel first");
+            return false;
+        }
+
+        filePath = path;
+        schemaId = id;
+        schemaVersion = version;
+        failed = false;
+
+        if (!writer.Open(filePath, true)) [[unlikely]] {
+            return false;
+        }
+
+        // Placeholder (magic 0) until Finish knows the size and the root
+        Blob::Header header = {};
+        if (!writer.Append(std::as_bytes(std::span(&header, 1)))) [[unlikely]] {
+            Cancel();
+            return false;
+        }
+
+        return true;
+    }
+
+    BlobSpanRef<wchar_t> BlobBuilder::AddString(std::wstring_view string) {
+        if (string.empty()) {
+            return {};
+        }
+
+        const UINT64 offset = Write(string.data(), string.size() * sizeof(wchar_t), alignof(wchar_t));
+        const wchar_t terminator = L'\0';
+        if (offset == 0 || !writer.Append(std::as_bytes(std::span(&terminator, 1)))) [[unlikely]] {
+            failed = true;
+            return {};
+        }
+
+        return { offset, string.size() };
+    }
+
+    UINT64 BlobBuilder::Write(const void* data, size_t size, size_t alignment) {
+        if (!IsOpen() || failed) [[unlikely]] {
+            return 0;
+        }
+
+        // Start : Padding
+        static constexpr std::byte ZEROS[64] = {};
+        UINT64 padding = AlignedTail(alignment) - writer.GetTail();
+        while (padding > 0) {
+            const size_t count = static_cast<size_t>(std::min<UINT64>(padding, sizeof(ZEROS)));
+            if (!writer.Append(std::span(ZEROS, count))) [[unlikely]] {
+                failed = true;
+                return 0;
+            }
+            padding -= count;
+        }
+        // End : Padding
+
+        const UINT64 offset = writer.GetTail();
+        if (!writer.Append(std::span(static_cast<const std::byte*>(data), size))) [[unlikely]] {
+            failed = true;
+            return 0;
+        }
+
+        return offset;
+    }
+
+    bool BlobBuilder::Finish(UINT64 rootOffset) {
+        if (!IsOpen()) [[unlikely]] {
+            LOG_WARNING(L"BlobBuilder - Finish", L"Nothing is being built");
+            return false;
+        }
+        if (failed || rootOffset == 0) [[unlikely]] {
+            LOG_ERROR(L"BlobBuilder - Finish", L"(" + filePath + L") " + (failed ? L"A write failed" : L"No root"));
+            Cancel();
+            return false;
+        }
+
+        Blob::Header header = {};
+        header.magic = Blob::MAGIC;
+        header.version = Blob::VERSION;
+        header.schemaId = schemaId;
+        header.schemaVersion = schemaVersion;
+        header.size = writer.GetTail();
+        header.rootOffset = rootOffset;
+
+        if (!writer.Close()) [[unlikely]] {
+            return false;
+        }
+
+        bool success = FileManager::WriteFile(filePath, std::as_bytes(std::span(&header, 1)), 0);
+        // So Blob::Open can map it (no cached write handle left)
+        FileManager::InvalidateHandle(filePath);
+
+        return success;
+    }
+    void BlobBuilder::Cancel() {
+        writer.Close();
+        failed = false;
+    }
+    // End : BlobBuilder
+
+    // Start : BlobVerifier
+    bool BlobVerifier::Verify(const RelString& field) {
+        if (field.count == 0) {
+            return true;
+        }
+
+        // count + 1 mustn't wrap around (CheckRange does the exact check)
+        if (field.count >= blob.size() / sizeof(wchar_t)) {
+            return false;
+        }
+        const std::byte* target = nullptr;
+        if (!CheckRange(&field, field.offset, field.count + 1, sizeof(wchar_t), alignof(wchar_t), target)) {
+            return false;
+        }
+        return reinterpret_cast<const wchar_t*>(target)[field.count] == L'\0';
+    }
+
+    bool BlobVerifier::CheckRange(const void* field, INT64 offset, UINT64 count, size_t size, size_t alignment, const std::byte*& target) const {
+        // Positions in the blob, never pointers outside of it (offset can be anything in a corrupted blob)
+        const UINT64 fieldPosition = UINT64(static_cast<const std::byte*>(field) - blob.data());
+        assert(fieldPosition < blob.size() && "Only fields of verified objects are checked");
+
+        UINT64 position = 0;
+        if (offset >= 0) {
+            if (UINT64(offset) > blob.size() - fieldPosition) {
+                return false;
+            }
+            position = fieldPosition + UINT64(offset);
+        }
+        else {
+            const UINT64 distance = UINT64(0) - UINT64(offset);
+            if (distance > fieldPosition) {
+                return false;
+            }
+            position = fieldPosition - distance;
+        }
+        if (position < start || count > (blob.size() - position) / size) {
+            return false;
+        }
+
+        target = blob.data() + position;
+        return reinterpret_cast<uintptr_t>(target) % alignment == 0;
+    }
+    // End : BlobVerifier
+
+    // Start : Blob
+    bool Blob::Map(const wstring& filePath) {
+        Close();
+
+        hFile = CreateFileW(
+            filePath.c_str(),
+            GENERIC_READ,
+            FILE_SHARE_DELETE | FILE_SHARE_READ,
+            nullptr,
+            OPEN_EXISTING,
+            FILE_FLAG_RANDOM_ACCESS,
+            nullptr
+        );
+
+        if (hFile == INVALID_HANDLE_VALUE) [[unlikely]] {
+            LOG_WARNING(L"Blob - Open", L"(" + filePath + L") Couldn't open the blob");
+            return false;
+        }
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(hFile, &fileSize) || UINT64(fileSize.QuadPart) < sizeof(Header)) [[unlikely]] {
+            LOG_WARNING(L"Blob - Open", L"(" + filePath + L") Too small to be a blob");
+            Close();
+            return false;
+        }
+
+        hMapping = CreateFileMappingW(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!hMapping) [[unlikely]] {
+            LOG_ERROR(L"Blob - Open", L"(" + filePath + L") CreateFileMappingW failed");
+            Close();
+            return false;
+        }
+
+        view = static_cast<const std::byte*>(MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0));
+        if (!view) [[unlikely]] {
+            LOG_ERROR(L"Blob - Open", L"(" + filePath + L") MapViewOfFile failed");
+            Close();
+            return false;
+        }
+
+        data = std::span(view, static_cast<size_t>(fileSize.QuadPart));
+        return true;
+    }
+    void Blob::Close() {
+        if (view) {
+            UnmapViewOfFile(view);
+            view = nullptr;
+        }
+        if (hMapping) {
+            CloseHandle(hMapping);
+            hMapping = nullptr;
+        }
+        if (hFile != INVALID_HANDLE_VALUE) {
+            CloseHandle(hFile);
+            hFile = INVALID_HANDLE_VALUE;
+        }
+
+        data = {};
+        header = nullptr;
+    }
+
+    bool Blob::CheckHeader(const wstring& source, UINT32 schemaId, UINT32 schemaVersion, size_t rootSize, size_t rootAlignment) {
+        if (data.size() < sizeof(Header) || reinterpret_cast<uintptr_t>(data.data()) % alignof(Header) != 0) [[unlikely]] {
+            LOG_WARNING(L"Blob - Open", L"(" + source + L") Too small or misaligned to be a blob");
+            return false;
+        }
+
+        const Header* checked = reinterpret_cast<const Header*>(data.data());
+        if (checked->magic != MAGIC || checked->version != VERSION) [[unlikely]] {
+            LOG_WARNING(L"Blob - Open", L"(" + source + L") Not a blob, an unfinished one or another format version");
+            return false;
+        }
+        if (checked->schemaId != schemaId) [[unlikely]] {
+            LOG_WARNING(L"Blob - Open", L"(" + source + L") Schema " + to_wstring(checked->schemaId) + L" instead of " + to_wstring(schemaId));
+            return false;
+        }
+        // Verified against the current layout only : an older version could be read out of bounds
+        if (checked->schemaVersion != schemaVersion) [[unlikely]] {
+            LOG_WARNING(L"Blob - Open", L"(" + source + L") Schema version " + to_wstring(checked->schemaVersion) + L" instead of " + to_wstring(schemaVersion));
+            return false;
+        }
+        if (checked->size < sizeof(Header) || checked->size > data.size()) [[unlikely]] {
+            LOG_WARNING(L"Blob - Open", L"(" + source + L") Truncated blob");
+            return false;
+        }
+        if (checked->rootOffset < sizeof(Header) || checked->rootOffset % rootAlignment != 0 ||
+            rootSize > checked->size || checked->rootOffset > checked->size - rootSize) [[unlikely]] {
+            LOG_WARNING(L"Blob - Open", L"(" + source + L") Invalid root");
+            return false;
+        }
+
+        return true;
+    }
+    // End : Blob
+
+}
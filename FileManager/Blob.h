@@ -0,0 +1,323 @@
+#pragma once
+#include "include.h"
+#include "AppendWriter.h"
+#include <type_traits>
+
+namespace FileManager {
+
+	// Zero-copy structured data (.blob) : plain structs laid out in the file exactly as in memory,
+	//	linked by offsets relative to the field holding them, so a mapped blob is used in place without parsing.
+	//	Header | objects, each aligned on its type
+	// A blob is written bottom-up by BlobBuilder (children before the objects pointing at them, the root last)
+	//	and checked once by BlobVerifier when it is opened : reading it afterwards is never bounds checked.
+	// Structs must be trivially copyable and standard layout, with RelPtr / RelSpan / RelString instead of pointers.
+	// A struct holding any of them gives it a bool Verify(BlobVerifier&) const member that verifies each one.
+
+	// Offset of a T from the address of this field, 0 is null
+	template<typename T>
+	struct RelPtr {
+		INT64 offset = 0;
+
+		const T* Get() const { return offset ? reinterpret_cast<const T*>(reinterpret_cast<const std::byte*>(this) + offset) : nullptr; }
+		const T* operator->() const { return Get(); }
+		const T& operator*() const { return *Get(); }
+		explicit operator bool() const { return offset != 0; }
+	};
+
+	// count consecutive T at an offset from the address of this field
+	template<typename T>
+	struct RelSpan {
+		INT64 offset = 0;
+		UINT64 count = 0;
+
+		std::span<const T> Get() const {
+			if (count == 0) {
+				return {};
+			}
+			return { reinterpret_cast<const T*>(reinterpret_cast<const std::byte*>(this) + offset), static_cast<size_t>(count) };
+		}
+		const T& operator[](size_t index) const { return Get()[index]; }
+		size_t size() const { return static_cast<size_t>(count); }
+		bool empty() const { return count == 0; }
+	};
+
+	// Null terminated in the blob, count doesn't include the terminator
+	struct RelString : RelSpan<wchar_t> {
+		std::wstring_view GetView() const { return count ? std::wstring_view(Get().data(), size()) : std::wstring_view(); }
+	};
+
+	template<typename T>
+	concept BlobType = std::is_trivially_copyable_v<T> && std::is_standard_layout_v<T>;
+
+	// Start : Builder side
+	// Absolute offsets of written objects, to link them from the objects written after them
+	template<typename T>
+	struct BlobRef {
+		UINT64 offset = 0;	// 0 : nothing written (the header is there)
+		explicit operator bool() const { return offset != 0; }
+	};
+	template<typename T>
+	struct BlobSpanRef {
+		UINT64 offset = 0;
+		UINT64 count = 0;
+		explicit operator bool() const { return offset != 0 || count == 0; }
+	};
+
+	class BlobBuilder;
+
+	// Objects filled in memory before being written, at the offset they were given by BlobBuilder::Make.
+	// Nothing else may be added to the builder between Make and Add.
+	template<BlobType T>
+	class BlobStaged {
+	public:
+		T* operator->() { return &values[0]; }
+		T& operator*() { return values[0]; }
+		T& operator[](size_t index) { return values[index]; }
+		size_t GetCount() const { return values.size(); }
+
+		// field is a member of one of the staged objects
+		template<typename U>
+		void Link(RelPtr<U>& field, BlobRef<U> target) {
+			field.offset = target ? INT64(target.offset) - INT64(OffsetOf(&field)) : 0;
+		}
+		template<typename U>
+		void Link(RelSpan<U>& field, BlobSpanRef<U> target) {
+			field.offset = target.count ? INT64(target.offset) - INT64(OffsetOf(&field)) : 0;
+			field.count = target.count;
+		}
+
+	private:
+		friend class BlobBuilder;
+
+		BlobStaged(UINT64 offset, size_t count) : offset(offset), values(count) {}
+
+		// Offset of a staged field in the blob
+		UINT64 OffsetOf(const void* field) const {
+			const ptrdiff_t distance = static_cast<const std::byte*>(field) - reinterpret_cast<const std::byte*>(values.data());
+			assert(distance >= 0 && size_t(distance) < values.size() * sizeof(T) && "The field isn't part of the staged objects");
+			return offset + distance;
+		}
+
+		UINT64 offset;
+		vector<T> values;	// Value initialized : the padding is written as zeros
+	};
+
+	// Writes a blob through an AppendWriter (the file is streamed, never held in memory),
+	//	the header is written last by Finish : a blob that wasn't finished doesn't open.
+	class BlobBuilder {
+	public:
+		BlobBuilder() = default;
+		BlobBuilder(const BlobBuilder&) = delete;
+		BlobBuilder& operator=(const BlobBuilder&) = delete;
+		~BlobBuilder() { writer.Close(); }
+
+		// Creates or replaces filePath. schemaId / schemaVersion identify the layout of the structs for Blob::Open.
+		bool Open(const wstring& filePath, UINT32 schemaId, UINT32 schemaVersion);
+
+		// Objects without links (or linked to nothing)
+		template<BlobType T>
+		BlobRef<T> Add(const T& value) {
+			return { Write(&value, sizeof(T), alignof(T)) };
+		}
+		template<BlobType T>
+		BlobSpanRef<T> AddArray(std::span<const T> values) {
+			if (values.empty()) {
+				return {};
+			}
+			return { Write(values.data(), values.size_bytes(), alignof(T)), values.size() };
+		}
+		BlobSpanRef<wchar_t> AddString(std::wstring_view string);
+
+		// Objects with links : Make, fill and Link their fields, then Add
+		template<BlobType T>
+		BlobStaged<T> Make(size_t count = 1) {
+			return BlobStaged<T>(AlignedTail(alignof(T)), count);
+		}
+		template<BlobType T>
+		BlobRef<T> Add(const BlobStaged<T>& staged) {
+			return { WriteStaged(staged) };
+		}
+		template<BlobType T>
+		BlobSpanRef<T> AddArray(const BlobStaged<T>& staged) {
+			return { WriteStaged(staged), staged.values.size() };
+		}
+
+		// Writes the header pointing at root and closes the file, false if anything failed since Open
+		template<BlobType Root>
+		bool Finish(BlobRef<Root> root) { return Finish(root.offset); }
+		// Closes the file without a header (it won't open)
+		void Cancel();
+
+		bool IsOpen() const { return writer.IsOpen(); }
+		UINT64 GetSize() const { return writer.GetTail(); }
+
+	private:
+		// Pads to alignment, appends and returns the offset of data (0 on failure)
+		UINT64 Write(const void* data, size_t size, size_t alignment);
+		template<BlobType T>
+		UINT64 WriteStaged(const BlobStaged<T>& staged) {
+			if (staged.offset != AlignedTail(alignof(T))) [[unlikely]] {
+				LOG_ERROR(L"BlobBuilder - Add", L"(" + filePath + L") Something was added between Make and Add");
+				failed = true;
+				return 0;
+			}
+			return Write(staged.values.data(), staged.values.size() * sizeof(T), alignof(T));
+		}
+		UINT64 AlignedTail(size_t alignment) const { return (writer.GetTail() + alignment - 1) & ~UINT64(alignment - 1); }
+		bool Finish(UINT64 rootOffset);
+
+		wstring filePath;
+		AppendWriter writer;
+		UINT32 schemaId = 0;
+		UINT32 schemaVersion = 0;
+		bool failed = false;
+	};
+	// End : Builder side
+
+	// Start : Reader side
+	// Checks that every link reachable from the root stays inside the blob, is aligned and doesn't go deeper
+	//	than maxDepth (a cycle can't loop forever) nor visit more than maxObjects objects (shared children are visited each time).
+	class BlobVerifier {
+	public:
+		static constexpr UINT32 DEFAULT_MAX_DEPTH = 64;
+		static constexpr UINT64 DEFAULT_MAX_OBJECTS = 1 << 24;
+
+		// Links may only target [start, blob.size()) : start skips a header
+		BlobVerifier(std::span<const std::byte> blob, UINT64 start = 0, UINT32 maxDepth = DEFAULT_MAX_DEPTH, UINT64 maxObjects = DEFAULT_MAX_OBJECTS)
+			: blob(blob), start(start), maxDepth(maxDepth), maxObjects(maxObjects) {}
+
+		// A null pointer is valid unless required
+		template<BlobType T>
+		bool Verify(const RelPtr<T>& field, bool required = false) {
+			if (!field) {
+				return !required;
+			}
+			const std::byte* target = nullptr;
+			return CheckRange(&field, field.offset, 1, sizeof(T), alignof(T), target) &&
+				VerifyObjects(reinterpret_cast<const T*>(target), 1);
+		}
+		template<BlobType T>
+		bool Verify(const RelSpan<T>& field) {
+			if (field.count == 0) {
+				return true;
+			}
+			const std::byte* target = nullptr;
+			return CheckRange(&field, field.offset, field.count, sizeof(T), alignof(T), target) &&
+				VerifyObjects(reinterpret_cast<const T*>(target), static_cast<size_t>(field.count));
+		}
+		bool Verify(const RelString& field);
+
+		// The object at an absolute offset (the root)
+		template<BlobType T>
+		bool VerifyAt(UINT64 offset) {
+			if (offset < start || offset > blob.size() || sizeof(T) > blob.size() - offset) {
+				return false;
+			}
+			const std::byte* target = blob.data() + offset;
+			if (reinterpret_cast<uintptr_t>(target) % alignof(T) != 0) {
+				return false;
+			}
+			return VerifyObjects(reinterpret_cast<const T*>(target), 1);
+		}
+
+	private:
+		// Nested links of count objects, if T has any
+		template<BlobType T>
+		bool VerifyObjects(const T* objects, size_t count) {
+			if constexpr (requires(const T& object, BlobVerifier& verifier) { { object.Verify(verifier) } -> std::same_as<bool>; }) {
+				if (depth >= maxDepth) [[unlikely]] {
+					return false;
+				}
+				depth++;
+				for (size_t i = 0; i < count; i++) {
+					if (++objectCount > maxObjects || !objects[i].Verify(*this)) [[unlikely]] {
+						depth--;
+						return false;
+					}
+				}
+				depth--;
+			}
+			return true;
+		}
+		// target = field + offset, count * size bytes inside [start, blob.size()) and aligned
+		bool CheckRange(const void* field, INT64 offset, UINT64 count, size_t size, size_t alignment, const std::byte*& target) const;
+
+		std::span<const std::byte> blob;
+		UINT64 start;
+		UINT32 maxDepth;
+		UINT64 maxObjects;
+		UINT32 depth = 0;
+		UINT64 objectCount = 0;
+	};
+
+	// A blob mapped read-only (or bytes owned elsewhere), verified once when it is opened
+	class Blob {
+	public:
+		static constexpr UINT32 MAGIC = 0x424C424D;	// "MBLB"
+		static constexpr UINT32 VERSION = 1;
+
+		struct Header {
+			UINT32 magic;
+			UINT32 version;			// Of the blob format
+			UINT32 schemaId;
+			UINT32 schemaVersion;	// Of the structs
+			UINT64 size;			// Header included
+			UINT64 rootOffset;
+		};
+
+		Blob() = default;
+		Blob(const Blob&) = delete;
+		Blob& operator=(const Blob&) = delete;
+		~Blob() { Close(); }
+
+		// Maps filePath, rejects another schema or schemaVersion than the caller's, then verifies it
+		template<BlobType Root>
+		bool Open(const wstring& filePath, UINT32 schemaId, UINT32 schemaVersion) {
+			return Map(filePath) && Load<Root>(filePath, schemaId, schemaVersion);
+		}
+		// Same over bytes owned elsewhere (ContentCache, Archive::GetView, ...) that outlive the Blob
+		template<BlobType Root>
+		bool Open(std::span<const std::byte> bytes, UINT32 schemaId, UINT32 schemaVersion) {
+			Close();
+			data = bytes;
+			return Load<Root>(L"memory", schemaId, schemaVersion);
+		}
+		void Close();
+		bool IsOpen() const { return header != nullptr; }
+
+		template<BlobType Root>
+		const Root* GetRoot() const { return header ? reinterpret_cast<const Root*>(data.data() + header->rootOffset) : nullptr; }
+		UINT32 GetSchemaVersion() const { return header ? header->schemaVersion : 0; }
+		std::span<const std::byte> GetData() const { return data; }
+
+	private:
+		bool Map(const wstring& filePath);
+		bool CheckHeader(const wstring& source, UINT32 schemaId, UINT32 schemaVersion, size_t rootSize, size_t rootAlignment);
+		template<BlobType Root>
+		bool Load(const wstring& source, UINT32 schemaId, UINT32 schemaVersion) {
+			if (!CheckHeader(source, schemaId, schemaVersion, sizeof(Root), alignof(Root))) [[unlikely]] {
+				Close();
+				return false;
+			}
+
+			const Header* checked = reinterpret_cast<const Header*>(data.data());
+			BlobVerifier verifier(data.first(static_cast<size_t>(checked->size)), sizeof(Header));
+			if (!verifier.VerifyAt<Root>(checked->rootOffset)) [[unlikely]] {
+				LOG_WARNING(L"Blob - Open", L"(" + source + L") A link goes out of the blob, corrupted blob");
+				Close();
+				return false;
+			}
+
+			header = checked;
+			return true;
+		}
+
+		HANDLE hFile = INVALID_HANDLE_VALUE;
+		HANDLE hMapping = nullptr;
+		const std::byte* view = nullptr;	// Only when mapped here
+		std::span<const std::byte> data;
+		const Header* header = nullptr;	// Set once verified
+	};
+	// End : Reader side
+
+}
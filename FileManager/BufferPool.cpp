@@ -0,0 +1,102 @@
+#include "BufferPool.h"
+#include <bit>
+#include <utility>
+
+namespace FileManager {
+
+    namespace {
+        struct ThreadCache {
+            ThreadCache() {
+                // Reserved once : giving a buffer back never allocates
+                for (vector<std::unique_ptr<std::byte[]>>& buffers : free) {
+                    buffers.reserve(BufferPool::MAX_CACHED_PER_CLASS);
+                }
+            }
+
+            vector<std::unique_ptr<std::byte[]>> free[BufferPool::CLASS_COUNT];
+            BufferPool::Stats stats;
+        };
+
+        ThreadCache& LocalCache() {
+            thread_local ThreadCache cache;
+            return cache;
+        }
+    }
+
+    BufferLease& BufferLease::operator=(BufferLease&& other) noexcept {
+        if (this != &other) {
+            Release();
+            buffer = move(other.buffer);
+            bufferSize = std::exchange(other.bufferSize, 0);
+            capacity = std::exchange(other.capacity, 0);
+        }
+        return *this;
+    }
+    void BufferLease::Release() {
+        if (buffer) {
+            BufferPool::Return(move(buffer), capacity);
+        }
+        bufferSize = 0;
+        capacity = 0;
+    }
+
+    UINT32 BufferPool::GetClass(size_t size) {
+        if (size > MAX_CLASS_SIZE) {
+            return CLASS_COUNT;
+        }
+        const size_t classSize = std::bit_ceil(std::max(size, MIN_CLASS_SIZE));
+        return static_cast<UINT32>(std::countr_zero(classSize) - std::countr_zero(MIN_CLASS_SIZE));
+    }
+
+    BufferLease BufferPool::Acquire(size_t size) {
+        BufferLease lease;
+        if (size == 0) {
+            return lease;
+        }
+
+        ThreadCache& cache = LocalCache();
+        const UINT32 sizeClass = GetClass(size);
+
+        if (sizeClass < CLASS_COUNT && !cache.free[sizeClass].empty()) [[likely]] {
+            lease.buffer = move(cache.free[sizeClass].back());
+            cache.free[sizeClass].pop_back();
+            lease.capacity = MIN_CLASS_SIZE << sizeClass;
+            cache.stats.cachedBytes -= lease.capacity;
+            cache.stats.hits++;
+        }
+        else {
+            lease.capacity = sizeClass < CLASS_COUNT ? MIN_CLASS_SIZE << sizeClass : size;
+            lease.buffer = std::make_unique_for_overwrite<std::byte[]>(lease.capacity);
+            cache.stats.misses++;
+        }
+
+        lease.bufferSize = size;
+        return lease;
+    }
+    void BufferPool::Return(std::unique_ptr<std::byte[]> buffer, size_t capacity) {
+        const UINT32 sizeClass = GetClass(capacity);
+        if (sizeClass == CLASS_COUNT || capacity != MIN_CLASS_SIZE << sizeClass) {
+            return;
+        }
+
+        ThreadCache& cache = LocalCache();
+        if (cache.free[sizeClass].size() == MAX_CACHED_PER_CLASS || cache.stats.cachedBytes + capacity > THREAD_CACHE_SIZE) {
+            return;
+        }
+
+        cache.free[sizeClass].push_back(move(buffer));
+        cache.stats.cachedBytes += capacity;
+    }
+
+    void BufferPool::Trim() {
+        ThreadCache& cache = LocalCache();
+        for (vector<std::unique_ptr<std::byte[]>>& buffers : cache.free) {
+            buffers.clear();
+        }
+        cache.stats.cachedBytes = 0;
+    }
+    BufferPool::Stats BufferPool::GetStats() {
+        return LocalCache().stats;
+    }
+
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include "include.h"
+
+namespace FileManager {
+
+	// A buffer borrowed from BufferPool, given back (to the pool of the releasing thread) when the lease ends
+	class BufferLease {
+	public:
+		BufferLease() = default;
+		BufferLease(const BufferLease&) = delete;
+		BufferLease& operator=(const BufferLease&) = delete;
+		BufferLease(BufferLease&& other) noexcept { *this = move(other); }
+		BufferLease& operator=(BufferLease&& other) noexcept;
+		~BufferLease() { Release(); }
+
+		void Release();
+
+		std::byte* GetData() { return buffer.get(); }
+		const std::byte* GetData() const { return buffer.get(); }
+		size_t GetSize() const { return bufferSize; }
+		size_t GetCapacity() const { return capacity; }
+
+		std::span<std::byte> GetSpan() { return { buffer.get(), bufferSize }; }
+		std::span<const std::byte> GetSpan() const { return { buffer.get(), bufferSize }; }
+
+	private:
+		friend class BufferPool;
+
+		std::unique_ptr<std::byte[]> buffer;
+		size_t bufferSize = 0;
+		size_t capacity = 0;
+	};
+
+	// Per-thread caches of reusable buffers in power of 2 size classes (4 KB to 64 MB), without any lock.
+	// Once a thread has seen its working sizes, loading through leases doesn't touch the heap anymore.
+	// Bigger requests are plain allocations, freed on release. Each thread keeps at most THREAD_CACHE_SIZE bytes.
+	class BufferPool {
+	public:
+		static constexpr size_t MIN_CLASS_SIZE = 4096;
+		static constexpr UINT32 CLASS_COUNT = 15;
+		static constexpr size_t MAX_CLASS_SIZE = MIN_CLASS_SIZE << (CLASS_COUNT - 1);
+		static constexpr size_t MAX_CACHED_PER_CLASS = 8;
+		static constexpr size_t THREAD_CACHE_SIZE = 128 * 1024 * 1024;
+
+		struct Stats {
+			UINT64 hits = 0;		// Served from the cache
+			UINT64 misses = 0;		// Allocated
+			size_t cachedBytes = 0;
+		};
+
+		// A buffer of at least size bytes (the content is undefined), an empty lease if size is 0
+		static BufferLease Acquire(size_t size);
+		// Frees the buffers cached by the calling thread
+		static void Trim();
+		// Of the calling thread
+		static Stats GetStats();
+
+	private:
+		friend class BufferLease;
+
+		static void Return(std::unique_ptr<std::byte[]> buffer, size_t capacity);
+		// Size class of size, CLASS_COUNT if too big to be pooled
+		static UINT32 GetClass(size_t size);
+	};
+
+}
@@ -0,0 +1,148 @@
+#include "ChangeCache.h"
+#include "FileManager.h"
+#include <cstring>
+
+namespace FileManager {
+
+    namespace {
+        // On disk : Header, then per record : Record, UINT32 path length (in WCHAR), path
+        struct Header {
+            UINT32 magic;
+            UINT32 version;
+            UINT64 count;
+        };
+
+        template<typename T>
+        void Append(vector<std::byte>& out, const T& value) {
+            const std::byte* bytes = reinterpret_cast<const std::byte*>(&value);
+            out.insert(out.end(), bytes, bytes + sizeof(T));
+        }
+
+        template<typename T>
+        bool Extract(std::span<const std::byte>& in, T& value) {
+            if (in.size() < sizeof(T)) {
+                return false;
+            }
+            std::memcpy(&value, in.data(), sizeof(T));
+            in = in.subspan(sizeof(T));
+            return true;
+        }
+    }
+
+    bool ChangeCache::Load(const wstring& cachePath) {
+        if (!FileManager::FileExists(cachePath)) {
+            return true;
+        }
+
+        UINT64 fileSize = 0;
+        if (!FileManager::GetFileSize(cachePath, fileSize)) {
+            return false;
+        }
+
+        vector<std::byte> content(fileSize);
+        if (!FileManager::ReadFile(cachePath, std::span<std::byte>(content))) {
+            return false;
+        }
+
+        std::span<const std::byte> in(content);
+        Header header;
+        if (!Extract(in, header) || header.magic != MAGIC || header.version != VERSION) {
+            LOG_WARNING(L"ChangeCache - Load", L"(" + cachePath + L") isn't a change cache or has an old version, keeping the current records");
+            return false;
+        }
+
+        // The count can't be trusted before the records are read : no more than the bytes left can hold
+        constexpr size_t MIN_RECORD_SIZE = sizeof(Record) + sizeof(UINT32);
+        std::unordered_map<wstring, Record> loaded;
+        loaded.reserve(static_cast<size_t>(std::min<UINT64>(header.count, in.size() / MIN_RECORD_SIZE)));
+
+        for (UINT64 i = 0; i < header.count; i++) {
+            Record record;
+            UINT32 pathLength = 0;
+            if (!Extract(in, record) || !Extract(in, pathLength) || in.size() < pathLength * sizeof(WCHAR)) {
+                LOG_WARNING(L"ChangeCache - Load", L"(" + cachePath + L") is truncated, keeping the current records");
+                return false;
+            }
+
+            wstring path(pathLength, L'\0');
+            std::memcpy(path.data(), in.data(), pathLength * sizeof(WCHAR));
+            in = in.subspan(pathLength * sizeof(WCHAR));
+
+            loaded.emplace(move(path), record);
+        }
+
+        std::lock_guard<std::mutex> lock(mtx);
+        records = move(loaded);
+        return true;
+    }
+
+    bool ChangeCache::Save(const wstring& cachePath) const {
+        vector<std::byte> out;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+
+            Append(out, Header{ MAGIC, VERSION, records.size() });
+            for (const auto& [path, record] : records) {
+                Append(out, record);
+                Append(out, static_cast<UINT32>(path.size()));
+
+                const std::byte* bytes = reinterpret_cast<const std::byte*>(path.data());
+                out.insert(out.end(), bytes, bytes + path.size() * sizeof(WCHAR));
+            }
+        }
+
+        return FileManager::SaveFile(cachePath, out);
+    }
+
+    bool ChangeCache::HasChanged(const wstring& filePath) {
+        WIN32_FILE_ATTRIBUTE_DATA attributes;
+        if (!GetFileAttributesExW(filePath.c_str(), GetFileExInfoStandard, &attributes)) {
+            // Gone (or unreachable) : changed if we knew it
+            return Remove(filePath);
+        }
+
+        Record current;
+        current.size = (UINT64(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+        current.lastWrite = (UINT64(attributes.ftLastWriteTime.dwHighDateTime) << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+
+        Record previous;
+        bool known = GetRecord(filePath, previous);
+
+        if (known && previous.size == current.size && previous.lastWrite == current.lastWrite) [[likely]] {
+            return false;
+        }
+
+        if (!FileManager::HashFile(filePath, current.hash)) [[unlikely]] {
+            Remove(filePath);
+            return true;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            records[filePath] = current;
+        }
+
+        // Touched (saved again, copied, ...) but same content
+        return !known || previous.hash != current.hash;
+    }
+
+    bool ChangeCache::GetRecord(const wstring& filePath, Record& record) const {
+        std::lock_guard<std::mutex> lock(mtx);
+
+        auto it = records.find(filePath);
+        if (it == records.end()) {
+            return false;
+        }
+        record = it->second;
+        return true;
+    }
+    bool ChangeCache::Remove(const wstring& filePath) {
+        std::lock_guard<std::mutex> lock(mtx);
+        return records.erase(filePath) != 0;
+    }
+    void ChangeCache::Clear() {
+        std::lock_guard<std::mutex> lock(mtx);
+        records.clear();
+    }
+
+}
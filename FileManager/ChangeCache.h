@@ -0,0 +1,38 @@
+#pragma once
+#include "include.h"
+
+namespace FileManager {
+
+	// Remembers size, last write time and content hash per path so incremental pipelines
+	//	(shader / asset reloads, ...) can skip files that didn't change.
+	// The metadata is compared first (one GetFileAttributesExW), the file is only hashed if it differs.
+	class ChangeCache {
+	public:
+		struct Record {
+			UINT64 size = 0;
+			UINT64 lastWrite = 0;	// FILETIME as UINT64
+			UINT64 hash = 0;
+		};
+
+		// A missing cache file isn't an error. The records are only replaced by a cache read in full, kept as they were otherwise.
+		bool Load(const wstring& cachePath);
+		bool Save(const wstring& cachePath) const;
+
+		// True if filePath is new, was removed since it was recorded or has a different content than recorded.
+		//	The record is updated (a missing file that wasn't recorded hasn't changed).
+		bool HasChanged(const wstring& filePath);
+
+		bool GetRecord(const wstring& filePath, Record& record) const;
+		// False if filePath wasn't recorded
+		bool Remove(const wstring& filePath);
+		void Clear();
+
+	private:
+		static constexpr UINT32 MAGIC = 0x4343464D;	// "MFCC"
+		static constexpr UINT32 VERSION = 1;
+
+		mutable std::mutex mtx;
+		std::unordered_map<wstring, Record> records;
+	};
+
+}
@@ -0,0 +1,566 @@
+#include "Compression.h"
+#include "FileManager.h"
+#include <bit>
+#include <cstring>
+
+namespace FileManager {
+
+    namespace {
+        constexpr size_t MIN_MATCH = 4;
+        constexpr size_t LAST_LITERALS = 5;         // The block always ends with literals
+        constexpr size_t MF_LIMIT = 12;             // No match starts in the last 12 bytes
+        constexpr size_t MAX_DISTANCE = 65535;      // 16-bit offsets
+        constexpr UINT32 HASH_LOG = 12;             // 16 KB table, stays in L1
+        constexpr UINT32 SKIP_TRIGGER = 6;          // Longer jumps through incompressible data
+        constexpr UINT32 RUN_MASK = 15;
+        constexpr UINT32 ML_MASK = 15;
+        constexpr size_t WILD_COPY = 16;            // Decoder copies in fixed 16 byte steps when there is room
+
+        inline UINT32 Read32(const BYTE* p) {
+            UINT32 value;
+            std::memcpy(&value, p, sizeof(value));
+            return value;
+        }
+        inline UINT64 Read64(const BYTE* p) {
+            UINT64 value;
+            std::memcpy(&value, p, sizeof(value));
+            return value;
+        }
+        inline UINT32 HashSequence(UINT32 sequence) {
+            return (sequence * 2654435761U) >> (32 - HASH_LOG);
+        }
+
+        // Length of the common run of p and match, without reading past limit
+        inline size_t CountMatch(const BYTE* p, const BYTE* match, const BYTE* limit) {
+            const BYTE* start = p;
+            while (p + 8 <= limit) {
+                UINT64 diff = Read64(p) ^ Read64(match);
+                if (diff) {
+                    return (p - start) + (std::countr_zero(diff) >> 3);    // Little endian : first different byte
+                }
+                p += 8;
+                match += 8;
+            }
+            while (p < limit && *p == *match) {
+                p++;
+                match++;
+            }
+            return p - start;
+        }
+
+        // Lengths >= 15 continue in extra bytes : 255, 255, ..., remainder
+        // The block table ends the frame, not necessarily aligned
+        vector<UINT32> ReadBlockTable(std::span<const std::byte> frame, UINT32 blockCount) {
+            vector<UINT32> storedSizes(blockCount);
+            if (blockCount != 0) {
+                std::memcpy(storedSizes.data(), frame.data() + frame.size() - blockCount * sizeof(UINT32), blockCount * sizeof(UINT32));
+            }
+            return storedSizes;
+        }
+
+        inline BYTE* WriteLength(BYTE* op, size_t length) {
+            for (; length >= 255; length -= 255) {
+                *op++ = 255;
+            }
+            *op++ = static_cast<BYTE>(length);
+            return op;
+        }
+        inline bool ReadLength(const BYTE*& ip, const BYTE* end, size_t& length) {
+            BYTE value;
+            do {
+                if (ip >= end) [[unlikely]] {
+                    return false;
+                }
+                value = *ip++;
+                length += value;
+            } while (value == 255);
+            return true;
+        }
+    }
+
+    size_t Compression::CompressBlock(std::span<const std::byte> source, std::span<std::byte> destination) {
+        const BYTE* const base = reinterpret_cast<const BYTE*>(source.data());
+        const BYTE* const end = base + source.size();
+        const BYTE* ip = base;
+        const BYTE* anchor = base;
+
+        BYTE* const outBase = reinterpret_cast<BYTE*>(destination.data());
+        BYTE* const outEnd = outBase + destination.size();
+        BYTE* op = outBase;
+
+        // Start : Sequences
+        if (source.size() > MF_LIMIT) {
+            const BYTE* const matchStartLimit = end - MF_LIMIT;
+            const BYTE* const matchEndLimit = end - LAST_LITERALS;
+            UINT32 table[1 << HASH_LOG] = {};
+
+            while (ip <= matchStartLimit) {
+                const UINT32 hash = HashSequence(Read32(ip));
+                const BYTE* match = base + table[hash];
+                table[hash] = static_cast<UINT32>(ip - base);
+
+                if (match >= ip || size_t(ip - match) > MAX_DISTANCE || Read32(match) != Read32(ip)) {
+                    ip += 1 + ((ip - anchor) >> SKIP_TRIGGER);
+                    continue;
+                }
+
+                while (ip > anchor && match > base && ip[-1] == match[-1]) {
+                    ip--;
+                    match--;
+                }
+
+                const size_t literalLength = ip - anchor;
+                const size_t matchLength = MIN_MATCH + CountMatch(ip + MIN_MATCH, match + MIN_MATCH, matchEndLimit);
+
+                // token + literals + offset + both length extensions
+                if (size_t(outEnd - op) < 1 + literalLength + 2 + (literalLength + matchLength) / 255 + 2) [[unlikely]] {
+                    return 0;
+                }
+
+                BYTE* token = op++;
+                BYTE tokenValue;
+                if (literalLength >= RUN_MASK) {
+                    tokenValue = RUN_MASK << 4;
+                    op = WriteLength(op, literalLength - RUN_MASK);
+                }
+                else {
+                    tokenValue = static_cast<BYTE>(literalLength << 4);
+                }
+
+                std::memcpy(op, anchor, literalLength);
+                op += literalLength;
+
+                const UINT16 offset = static_cast<UINT16>(ip - match);
+                std::memcpy(op, &offset, sizeof(offset));
+                op += sizeof(offset);
+
+                if (matchLength - MIN_MATCH >= ML_MASK) {
+                    tokenValue |= ML_MASK;
+                    op = WriteLength(op, matchLength - MIN_MATCH - ML_MASK);
+                }
+                else {
+                    tokenValue |= static_cast<BYTE>(matchLength - MIN_MATCH);
+                }
+                *token = tokenValue;
+
+                ip += matchLength;
+                anchor = ip;
+
+                // The position just before the match end is a good candidate for the next repetition
+                if (ip <= matchStartLimit) {
+                    table[HashSequence(Read32(ip - 2))] = static_cast<UINT32>(ip - 2 - base);
+                }
+            }
+        }
+        // End : Sequences
+
+        // Start : Last literals
+        const size_t lastLength = end - anchor;
+        if (size_t(outEnd - op) < 1 + lastLength / 255 + 1 + lastLength) [[unlikely]] {
+            return 0;
+        }
+
+        if (lastLength >= RUN_MASK) {
+            *op++ = RUN_MASK << 4;
+            op = WriteLength(op, lastLength - RUN_MASK);
+        }
+        else {
+            *op++ = static_cast<BYTE>(lastLength << 4);
+        }
+        std::memcpy(op, anchor, lastLength);
+        op += lastLength;
+        // End : Last literals
+
+        return op - outBase;
+    }
+
+    bool Compression::DecompressBlock(std::span<const std::byte> source, std::span<std::byte> destination) {
+        const BYTE* ip = reinterpret_cast<const BYTE*>(source.data());
+        const BYTE* const end = ip + source.size();
+
+        BYTE* const outBase = reinterpret_cast<BYTE*>(destination.data());
+        BYTE* const outEnd = outBase + destination.size();
+        BYTE* op = outBase;
+
+        while (ip < end) {
+            const BYTE token = *ip++;
+
+            // Start : Literals
+            size_t literalLength = token >> 4;
+            if (literalLength == RUN_MASK && !ReadLength(ip, end, literalLength)) [[unlikely]] {
+                return false;
+            }
+            if (literalLength > size_t(end - ip) || literalLength > size_t(outEnd - op)) [[unlikely]] {
+                return false;
+            }
+
+            // Short runs : one fixed size copy when both sides have the room
+            if (literalLength <= WILD_COPY && size_t(end - ip) >= WILD_COPY && size_t(outEnd - op) >= WILD_COPY) [[likely]] {
+                std::memcpy(op, ip, WILD_COPY);
+            }
+            else {
+                std::memcpy(op, ip, literalLength);
+            }
+            ip += literalLength;
+            op += literalLength;
+            // End : Literals
+
+            if (ip == end) {
+                break;      // Last sequence : literals only
+            }
+
+            // Start : Match
+            if (end - ip < 2) [[unlikely]] {
+                return false;
+            }
+            UINT16 offset;
+            std::memcpy(&offset, ip, sizeof(offset));
+            ip += sizeof(offset);
+
+            size_t matchLength = token & ML_MASK;
+            if (matchLength == ML_MASK && !ReadLength(ip, end, matchLength)) [[unlikely]] {
+                return false;
+            }
+            matchLength += MIN_MATCH;
+
+            if (offset == 0 || offset > size_t(op - outBase) || matchLength > size_t(outEnd - op)) [[unlikely]] {
+                return false;
+            }
+
+            const BYTE* match = op - offset;
+            BYTE* const matchEnd = op + matchLength;
+
+            // Fixed size copies only while they stay inside the block
+            if (offset < WILD_COPY && size_t(outEnd - op) >= WILD_COPY) {
+                // Short repeated pattern : expand it byte by byte, then copy from a whole number of periods back
+                for (size_t i = 0; i < WILD_COPY; i++) {
+                    op[i] = match[i];
+                }
+                op += WILD_COPY;
+                match = op - offset * ((WILD_COPY + offset - 1) / offset);
+            }
+            // May write past matchEnd, the next sequence overwrites it
+            while (op < matchEnd && size_t(outEnd - op) >= WILD_COPY) {
+                std::memcpy(op, match, WILD_COPY);
+                op += WILD_COPY;
+                match += WILD_COPY;
+            }
+            // Close to the end of the block
+            while (op < matchEnd) {
+                *op++ = *match++;
+            }
+            op = matchEnd;
+            // End : Match
+        }
+
+        return op == outEnd;
+    }
+
+    vector<std::byte> Compression::Compress(std::span<const std::byte> source, UINT32 blockSize, UINT32 workerCount) {
+        blockSize = std::max<UINT32>(blockSize, 1);
+
+        FrameHeader header = {};
+        header.magic = MAGIC;
+        header.version = VERSION;
+        header.blockSize = blockSize;
+        header.blockCount = static_cast<UINT32>((source.size() + blockSize - 1) / blockSize);
+        header.size = source.size();
+
+        // Start : Blocks (each in its own worst case slot)
+        const size_t slotSize = CompressBound(blockSize);
+        std::unique_ptr<std::byte[]> scratch = std::make_unique_for_overwrite<std::byte[]>(slotSize * header.blockCount);
+        vector<UINT32> storedSizes(header.blockCount);
+
+        ParallelFor(header.blockCount, [&](size_t i) {
+            std::span<const std::byte> block = source.subspan(i * blockSize, GetBlockSize(header, static_cast<UINT32>(i)));
+            std::span<std::byte> slot(scratch.get() + i * slotSize, slotSize);
+
+            size_t compressedSize = CompressBlock(block, slot);
+            if (compressedSize == 0 || compressedSize >= block.size()) {
+                std::memcpy(slot.data(), block.data(), block.size());
+                compressedSize = block.size();
+            }
+            storedSizes[i] = static_cast<UINT32>(compressedSize);
+        }, workerCount);
+        // End : Blocks
+
+        UINT64 blocksSize = 0;
+        for (UINT32 storedSize : storedSizes) {
+            blocksSize += storedSize;
+        }
+
+        vector<std::byte> frame(sizeof(FrameHeader) + blocksSize + storedSizes.size() * sizeof(UINT32));
+        std::byte* out = frame.data();
+
+        std::memcpy(out, &header, sizeof(header));
+        out += sizeof(header);
+        for (UINT32 i = 0; i < header.blockCount; i++) {
+            std::memcpy(out, scratch.get() + i * slotSize, storedSizes[i]);
+            out += storedSizes[i];
+        }
+        if (!storedSizes.empty()) {
+            std::memcpy(out, storedSizes.data(), storedSizes.size() * sizeof(UINT32));
+        }
+
+        return frame;
+    }
+
+    bool Compression::GetBlockOffsets(const FrameHeader& header, std::span<const UINT32> storedSizes, UINT64 frameSize, vector<UINT64>& blockOffsets) {
+        if (header.magic != MAGIC || header.version != VERSION || header.blockSize == 0) {
+            return false;
+        }
+        // header.size + blockSize - 1 mustn't wrap around
+        if (header.size > UINT64_MAX - header.blockSize) {
+            return false;
+        }
+        if (header.blockCount != (header.size + header.blockSize - 1) / header.blockSize || storedSizes.size() != header.blockCount) {
+            return false;
+        }
+
+        blockOffsets.resize(UINT64(header.blockCount) + 1);
+        UINT64 offset = sizeof(FrameHeader);
+        for (UINT32 i = 0; i < header.blockCount; i++) {
+            // A block never grows, it is stored raw instead (stored size == raw size).
+            //	Compressed, it can't decode to more than MAX_LZ4_EXPANSION bytes per stored byte :
+            //	the raw sizes, and so header.size, are bounded by the stored bytes.
+            const UINT32 rawSize = GetBlockSize(header, i);
+            if (storedSizes[i] == 0 || storedSizes[i] > rawSize) {
+                return false;
+            }
+            if (storedSizes[i] < rawSize && rawSize > storedSizes[i] * MAX_LZ4_EXPANSION) {
+                return false;
+            }
+            blockOffsets[i] = offset;
+            offset += storedSizes[i];
+        }
+        blockOffsets[header.blockCount] = offset;
+
+        return offset + UINT64(header.blockCount) * sizeof(UINT32) == frameSize;
+    }
+
+    bool Compression::GetDecompressedSize(std::span<const std::byte> frame, UINT64& size) {
+        if (frame.size() < sizeof(FrameHeader)) [[unlikely]] {
+            return false;
+        }
+
+        FrameHeader header;
+        std::memcpy(&header, frame.data(), sizeof(header));
+        if (UINT64(header.blockCount) * sizeof(UINT32) > frame.size() - sizeof(FrameHeader)) [[unlikely]] {
+            return false;
+        }
+
+        vector<UINT32> storedSizes = ReadBlockTable(frame, header.blockCount);
+
+        vector<UINT64> blockOffsets;
+        if (!GetBlockOffsets(header, storedSizes, frame.size(), blockOffsets)) [[unlikely]] {
+            return false;
+        }
+
+        size = header.size;
+        return true;
+    }
+
+    bool Compression::Decompress(std::span<const std::byte> frame, std::span<std::byte> destination, UINT32 workerCount) {
+        // Start : Header + table
+        UINT64 size = 0;
+        if (!GetDecompressedSize(frame, size)) [[unlikely]] {
+            LOG_WARNING("Compression - Decompress", "Invalid frame");
+            return false;
+        }
+        if (size != destination.size()) [[unlikely]] {
+            LOG_WARNING("Compression - Decompress", "Destination size doesn't match : "
+                + to_string(destination.size()) + " != " + to_string(size));
+            return false;
+        }
+
+        FrameHeader header;
+        std::memcpy(&header, frame.data(), sizeof(header));
+
+        vector<UINT32> storedSizes = ReadBlockTable(frame, header.blockCount);
+
+        vector<UINT64> blockOffsets;
+        GetBlockOffsets(header, storedSizes, frame.size(), blockOffsets);
+        // End : Header + table
+
+        std::atomic<bool> success = true;
+
+        ParallelFor(header.blockCount, [&](size_t i) {
+            const UINT32 rawSize = GetBlockSize(header, static_cast<UINT32>(i));
+            std::span<const std::byte> stored = frame.subspan(blockOffsets[i], storedSizes[i]);
+            std::span<std::byte> block = destination.subspan(i * header.blockSize, rawSize);
+
+            if (storedSizes[i] == rawSize) {
+                std::memcpy(block.data(), stored.data(), rawSize);
+            }
+            else if (!DecompressBlock(stored, block)) [[unlikely]] {
+                success = false;
+            }
+        }, workerCount);
+
+        if (!success) [[unlikely]] {
+            LOG_WARNING("Compression - Decompress", "Corrupted block");
+        }
+        return success;
+    }
+
+
+    bool CompressedWriter::Open(const wstring& path, UINT32 blockSize) {
+        Close();
+
+        header = {};
+        header.magic = Compression::MAGIC;
+        header.version = Compression::VERSION;
+        header.blockSize = std::max<UINT32>(blockSize, 1);
+
+        // The header is rewritten once the sizes are known
+        if (!FileManager::SaveFile(path, std::as_bytes(std::span(&header, 1)))) [[unlikely]] {
+            return false;
+        }
+
+        filePath = path;
+        fileOffset = sizeof(header);
+        block.clear();
+        block.reserve(header.blockSize);
+        compressed.resize(Compression::CompressBound(header.blockSize));
+        storedSizes.clear();
+        failed = false;
+        return true;
+    }
+    bool CompressedWriter::Write(std::span<const std::byte> data) {
+        if (!IsOpen() || failed) [[unlikely]] {
+            return false;
+        }
+
+        while (!data.empty()) {
+            size_t count = std::min<size_t>(data.size(), header.blockSize - block.size());
+            block.insert(block.end(), data.begin(), data.begin() + count);
+            data = data.subspan(count);
+            header.size += count;
+
+            if (block.size() == header.blockSize && !FlushBlock()) [[unlikely]] {
+                return false;
+            }
+        }
+
+        return true;
+    }
+    bool CompressedWriter::FlushBlock() {
+        size_t compressedSize = Compression::CompressBlock(block, compressed);
+        std::span<const std::byte> stored = compressedSize == 0 || compressedSize >= block.size()
+            ? std::span<const std::byte>(block)
+            : std::span<const std::byte>(compressed.data(), compressedSize);
+
+        if (!FileManager::WriteFile(filePath, stored, fileOffset)) [[unlikely]] {
+            failed = true;
+            return false;
+        }
+
+        fileOffset += stored.size();
+        storedSizes.push_back(static_cast<UINT32>(stored.size()));
+        header.blockCount++;
+        block.clear();
+        return true;
+    }
+    bool CompressedWriter::Close() {
+        if (!IsOpen()) {
+            return false;
+        }
+
+        if (!failed && !block.empty()) {
+            FlushBlock();
+        }
+
+        bool success = !failed &&
+            FileManager::WriteFile(filePath, std::as_bytes(std::span(storedSizes)), fileOffset) &&
+            FileManager::WriteFile(filePath, std::as_bytes(std::span(&header, 1)), 0);
+
+        if (!success) [[unlikely]] {
+            LOG_ERROR(L"CompressedWriter - Close", L"(" + filePath + L") Couldn't write the frame");
+        }
+
+        FileManager::InvalidateHandle(filePath);
+        filePath.clear();
+        return success;
+    }
+
+
+    bool CompressedReader::Open(const wstring& path) {
+        Close();
+
+        UINT64 fileSize = 0;
+        if (!FileManager::GetFileSize(path, fileSize) || fileSize < sizeof(header) ||
+            !FileManager::ReadFile(path, std::as_writable_bytes(std::span(&header, 1)), 0)) [[unlikely]] {
+            return false;
+        }
+
+        if (UINT64(header.blockCount) * sizeof(UINT32) > fileSize - sizeof(header)) [[unlikely]] {
+            LOG_WARNING(L"CompressedReader - Open", L"(" + path + L") Invalid frame");
+            return false;
+        }
+
+        vector<UINT32> storedSizes(header.blockCount);
+        const UINT64 tableSize = storedSizes.size() * sizeof(UINT32);
+        if (!FileManager::ReadFile(path, std::as_writable_bytes(std::span(storedSizes)), fileSize - tableSize) ||
+            !Compression::GetBlockOffsets(header, storedSizes, fileSize, blockOffsets)) [[unlikely]] {
+            LOG_WARNING(L"CompressedReader - Open", L"(" + path + L") Invalid frame");
+            return false;
+        }
+
+        filePath = path;
+        blockIndex = 0;
+        blockPosition = 0;
+        loadedBlock = UINT32(-1);
+        return true;
+    }
+    void CompressedReader::Close() {
+        filePath.clear();
+        header = {};
+        blockOffsets.clear();
+        block.clear();
+        stored.clear();
+    }
+    bool CompressedReader::LoadBlock(UINT32 index) {
+        const UINT32 rawSize = Compression::GetBlockSize(header, index);
+        const UINT64 storedSize = blockOffsets[index + 1] - blockOffsets[index];
+
+        block.resize(rawSize);
+        if (storedSize == rawSize) {
+            if (!FileManager::ReadFile(filePath, std::span(block), blockOffsets[index])) [[unlikely]] {
+                return false;
+            }
+        }
+        else {
+            stored.resize(storedSize);
+            if (!FileManager::ReadFile(filePath, std::span(stored), blockOffsets[index]) ||
+                !Compression::DecompressBlock(stored, block)) [[unlikely]] {
+                LOG_WARNING(L"CompressedReader - Read", L"(" + filePath + L") Corrupted block " + to_wstring(index));
+                return false;
+            }
+        }
+
+        loadedBlock = index;
+        return true;
+    }
+    size_t CompressedReader::Read(std::span<std::byte> destination) {
+        size_t done = 0;
+
+        while (IsOpen() && done < destination.size() && blockIndex < header.blockCount) {
+            if (loadedBlock != blockIndex && !LoadBlock(blockIndex)) [[unlikely]] {
+                break;
+            }
+
+            size_t count = std::min(destination.size() - done, block.size() - blockPosition);
+            std::memcpy(destination.data() + done, block.data() + blockPosition, count);
+            done += count;
+            blockPosition += count;
+
+            if (blockPosition == block.size()) {
+                blockIndex++;
+                blockPosition = 0;
+            }
+        }
+
+        return done;
+    }
+
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include "include.h"
+
+namespace FileManager {
+
+	// LZ4-class byte oriented LZ77 codec (no entropy stage) : fast enough to be used on every save / log.
+	// Blocks use the LZ4 sequence layout (token, literals, 16-bit offset, match length) with a 64 KB window.
+	//
+	// Frame = Header | blocks | UINT32 stored size per block
+	//	Every block is independent (no match crosses a block), so a frame is compressed and decompressed
+	//	in parallel, one block per task. A block that doesn't shrink is stored raw (stored size == raw size).
+	//	The table is at the end so a frame can be written in one sequential pass (see CompressedWriter).
+	class Compression {
+	public:
+		static constexpr UINT32 MAGIC = 0x5A4C464D;	// "MFLZ"
+		static constexpr UINT32 VERSION = 1;
+		static constexpr UINT32 DEFAULT_BLOCK_SIZE = 256 * 1024;
+		// Most raw bytes one stored byte of a compressed block decodes to (a 255 match length byte),
+		//	so a frame can't claim more than its stored size allows
+		static constexpr UINT64 MAX_LZ4_EXPANSION = 255;
+
+		struct FrameHeader {
+			UINT32 magic;
+			UINT32 version;
+			UINT32 blockSize;		// Raw size of every block but the last
+			UINT32 blockCount;
+			UINT64 size;			// Raw size of the whole frame
+		};
+
+		// Worst case size of CompressBlock's output for inputSize bytes
+		static constexpr size_t CompressBound(size_t inputSize) { return inputSize + inputSize / 255 + 16; }
+
+		// Compresses one block, returns the compressed size or 0 if it doesn't fit in destination
+		static size_t CompressBlock(std::span<const std::byte> source, std::span<std::byte> destination);
+		// Decompresses one block, destination.size() must be its exact raw size. Malformed input returns false.
+		static bool DecompressBlock(std::span<const std::byte> source, std::span<std::byte> destination);
+
+		// workerCount = 0 -> DefaultWorkerCount()
+		static vector<std::byte> Compress(std::span<const std::byte> source, UINT32 blockSize = DEFAULT_BLOCK_SIZE, UINT32 workerCount = 0);
+		// Validates the header and block table, size is the raw size destination must have
+		static bool GetDecompressedSize(std::span<const std::byte> frame, UINT64& size);
+		static bool Decompress(std::span<const std::byte> frame, std::span<std::byte> destination, UINT32 workerCount = 0);
+
+		// Checks header + table against frameSize and computes the offset of every block in the frame
+		//	(blockCount + 1 entries, the last one is the table). False if the frame is malformed,
+		//	or if a block claims more raw bytes than its stored bytes can decode to (header.size is bounded by them).
+		static bool GetBlockOffsets(const FrameHeader& header, std::span<const UINT32> storedSizes, UINT64 frameSize, vector<UINT64>& blockOffsets);
+		static UINT32 GetBlockSize(const FrameHeader& header, UINT32 index) {
+			return index + 1 < header.blockCount ? header.blockSize : static_cast<UINT32>(header.size - UINT64(header.blockSize) * index);
+		}
+	};
+
+	// Compresses a stream into a frame file, block by block, without holding the whole content
+	class CompressedWriter {
+	public:
+		CompressedWriter() = default;
+		CompressedWriter(const CompressedWriter&) = delete;
+		CompressedWriter& operator=(const CompressedWriter&) = delete;
+		~CompressedWriter() { Close(); }
+
+		// Creates (or truncates) filePath
+		bool Open(const wstring& filePath, UINT32 blockSize = Compression::DEFAULT_BLOCK_SIZE);
+		bool Write(std::span<const std::byte> data);
+		// Flushes the last block and writes the block table + header
+		bool Close();
+		bool IsOpen() const { return !filePath.empty(); }
+
+	private:
+		bool FlushBlock();
+
+		wstring filePath;
+		Compression::FrameHeader header = {};
+		vector<std::byte> block;
+		vector<std::byte> compressed;
+		vector<UINT32> storedSizes;
+		UINT64 fileOffset = 0;
+		bool failed = false;
+	};
+
+	// Reads a frame file sequentially, one block in memory at a time
+	class CompressedReader {
+	public:
+		bool Open(const wstring& filePath);
+		void Close();
+		bool IsOpen() const { return !filePath.empty(); }
+
+		// Raw size of the whole stream
+		UINT64 GetSize() const { return header.size; }
+		// Fills destination, returns the byte count read (less than destination.size() at the end or on error)
+		size_t Read(std::span<std::byte> destination);
+
+	private:
+		bool LoadBlock(UINT32 index);
+
+		wstring filePath;
+		Compression::FrameHeader header = {};
+		vector<UINT64> blockOffsets;	// Block index -> offset in the file, blockCount + 1 entries
+		vector<std::byte> stored;
+		vector<std::byte> block;
+		UINT32 blockIndex = 0;
+		size_t blockPosition = 0;
+		UINT32 loadedBlock = UINT32(-1);
+	};
+
+}
@@ -0,0 +1,318 @@
+#include "ContentCache.h"
+#include "FileManager.h"
+#include <cstring>
+
+namespace FileManager {
+
+    namespace {
+        // false if filePath isn't on the disk (missing, or only in a mounted archive)
+        bool GetLastWrite(const wstring& filePath, UINT64& lastWrite) {
+            WIN32_FILE_ATTRIBUTE_DATA attributes;
+            if (!GetFileAttributesExW(filePath.c_str(), GetFileExInfoStandard, &attributes)) {
+                return false;
+            }
+            lastWrite = (UINT64(attributes.ftLastWriteTime.dwHighDateTime) << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+            return true;
+        }
+    }
+
+    ContentCache::~ContentCache() {
+        // Stopped first : their callbacks use the cache
+        vector<std::unique_ptr<Watcher>> stopped;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopped.swap(watchers);
+        }
+    }
+
+    ContentCache::Content ContentCache::Read(const wstring& filePath) {
+        if (Content content = Find(filePath)) [[likely]] {
+            return content;
+        }
+
+        const wstring key = Archive::NormalizePath(filePath);
+        const UINT64 generation = BeginLoad(key);
+        return EndLoad(key, generation, Load(filePath));
+    }
+    std::shared_ptr<CachedFile> ContentCache::Load(const wstring& filePath) {
+        // Not through a cached handle : it could still be on the file from before a save (replaced with a rename)
+        FileManager::InvalidateHandle(filePath);
+
+        // The last write time is taken before reading : a change made meanwhile is seen by the next hit
+        UINT64 lastWrite = 0;
+        const bool onDisk = GetLastWrite(filePath, lastWrite);
+
+        UINT64 fileSize = 0;
+        if (!FileManager::GetFileSize(filePath, fileSize)) [[unlikely]] {
+            return nullptr;
+        }
+
+        std::shared_ptr<CachedFile> file = std::make_shared<CachedFile>();
+        file->data = std::make_unique_for_overwrite<std::byte[]>(fileSize);
+        file->size = static_cast<size_t>(fileSize);
+        file->lastWrite = onDisk ? lastWrite : 0;
+
+        if (!FileManager::ReadFile(filePath, std::span<std::byte>(file->data.get(), file->size))) [[unlikely]] {
+            return nullptr;
+        }
+        return file;
+    }
+    UINT64 ContentCache::BeginLoad(const wstring& key) {
+        std::lock_guard<std::mutex> lock(mtx);
+        PendingLoad& pending = loading[key];
+        pending.readers++;
+        return pending.generation;
+    }
+    ContentCache::Content ContentCache::EndLoad(const wstring& key, UINT64 generation, std::shared_ptr<CachedFile> file) {
+        LruList evicted;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+
+            auto pending = loading.find(key);
+            const bool current = pending->second.generation == generation;
+            if (--pending->second.readers == 0) {
+                loading.erase(pending);
+            }
+
+            // Invalidated while it was read (the Watcher saw a change) : maybe already stale, only given to this reader
+            if (!file || !current) [[unlikely]] {
+                return file;
+            }
+
+            Insert(key, file, evicted);
+        }
+        // evicted contents are freed here, outside the lock (or later by their last reader)
+
+        return file;
+    }
+
+    ContentCache::Content ContentCache::Find(const wstring& filePath) {
+        const wstring key = Archive::NormalizePath(filePath);
+
+        // Start : Watched hit
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            auto it = index.find(key);
+            if (it == index.end()) {
+                stats.misses++;
+                return nullptr;
+            }
+            if (it->second->second->watched) [[likely]] {
+                lru.splice(lru.begin(), lru, it->second);
+                stats.hits++;
+                return it->second->second;
+            }
+        }
+        // End : Watched hit
+
+        // Start : Check the last write time (outside the lock, it is a file system call)
+        UINT64 lastWrite = 0;
+        const bool onDisk = GetLastWrite(filePath, lastWrite);
+
+        LruList stale;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            auto it = index.find(key);
+            if (it == index.end()) {
+                stats.misses++;
+                return nullptr;
+            }
+
+            const Content& cached = it->second->second;
+            if (onDisk ? cached->lastWrite == lastWrite : cached->lastWrite == 0) [[likely]] {
+                lru.splice(lru.begin(), lru, it->second);
+                stats.hits++;
+                return cached;
+            }
+
+            stats.bytes -= cached->size;
+            stats.invalidations++;
+            stats.misses++;
+            stale.splice(stale.end(), lru, it->second);
+            index.erase(it);
+        }
+        // End : Check the last write time
+
+        // The cached handle holds the old size
+        FileManager::InvalidateHandle(filePath);
+        return nullptr;
+    }
+
+    ContentCache::PendingInsert ContentCache::BeginInsert(const wstring& filePath) {
+        // Same as Load : the read mustn't go through a handle from before a save
+        FileManager::InvalidateHandle(filePath);
+
+        PendingInsert pending;
+        pending.key = Archive::NormalizePath(filePath);
+        pending.generation = BeginLoad(pending.key);
+        if (!GetLastWrite(filePath, pending.lastWrite)) {
+            pending.lastWrite = 0;
+        }
+        return pending;
+    }
+    ContentCache::Content ContentCache::EndInsert(const PendingInsert& pending, std::span<const std::byte> data) {
+        std::shared_ptr<CachedFile> file = std::make_shared<CachedFile>();
+        file->data = std::make_unique_for_overwrite<std::byte[]>(data.size());
+        file->size = data.size();
+        file->lastWrite = pending.lastWrite;
+        if (!data.empty()) {
+            std::memcpy(file->data.get(), data.data(), data.size());
+        }
+
+        return EndLoad(pending.key, pending.generation, move(file));
+    }
+    void ContentCache::CancelInsert(const PendingInsert& pending) {
+        EndLoad(pending.key, pending.generation, nullptr);
+    }
+    void ContentCache::Insert(const wstring& key, const std::shared_ptr<CachedFile>& file, LruList& evicted) {
+        file->watched = IsWatched(key);
+
+        auto it = index.find(key);
+        if (it != index.end()) {
+            // Another thread loaded it too, keep ours (the newest)
+            stats.bytes -= it->second->second->size;
+            evicted.splice(evicted.end(), lru, it->second);
+            index.erase(it);
+        }
+
+        if (file->size > budget) [[unlikely]] {
+            return;
+        }
+
+        stats.bytes += file->size;
+        lru.emplace_front(key, file);
+        index[key] = lru.begin();
+
+        EvictOverflow(evicted);
+    }
+
+    void ContentCache::EvictOverflow(LruList& evicted) {
+        while (stats.bytes > budget && !lru.empty()) {
+            stats.bytes -= lru.back().second->size;
+            stats.evictions++;
+            index.erase(lru.back().first);
+            evicted.splice(evicted.end(), lru, std::prev(lru.end()));
+        }
+    }
+
+    void ContentCache::Invalidate(const wstring& filePath) {
+        const wstring key = Archive::NormalizePath(filePath);
+
+        LruList invalidated;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+
+            // Being read : what is read may be from before the change, it won't be cached
+            if (auto pending = loading.find(key); pending != loading.end()) {
+                pending->second.generation++;
+            }
+
+            auto it = index.find(key);
+            if (it == index.end()) {
+                return;
+            }
+            stats.bytes -= it->second->second->size;
+            stats.invalidations++;
+            invalidated.splice(invalidated.end(), lru, it->second);
+            index.erase(it);
+        }
+    }
+    void ContentCache::InvalidateDirectory(const wstring& dirPath) {
+        wstring prefix = Archive::NormalizePath(dirPath);
+        if (!prefix.empty() && prefix.back() != L'\\') {
+            prefix += L'\\';
+        }
+
+        LruList invalidated;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+
+            for (auto& [key, pending] : loading) {
+                if (key.starts_with(prefix)) {
+                    pending.generation++;
+                }
+            }
+
+            for (auto it = lru.begin(); it != lru.end();) {
+                auto next = std::next(it);
+                if (it->first.starts_with(prefix)) {
+                    stats.bytes -= it->second->size;
+                    stats.invalidations++;
+                    index.erase(it->first);
+                    invalidated.splice(invalidated.end(), lru, it);
+                }
+                it = next;
+            }
+        }
+    }
+    void ContentCache::Clear() {
+        LruList cleared;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            for (auto& [key, pending] : loading) {
+                pending.generation++;
+            }
+            cleared.swap(lru);
+            index.clear();
+            stats.bytes = 0;
+        }
+    }
+    void ContentCache::SetBudget(UINT64 newBudget) {
+        LruList evicted;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            budget = newBudget;
+
+            EvictOverflow(evicted);
+        }
+    }
+
+    bool ContentCache::Watch(const wstring& dirPath) {
+        wstring prefix = Archive::NormalizePath(dirPath);
+        if (!prefix.empty() && prefix.back() != L'\\') {
+            prefix += L'\\';
+        }
+
+        std::unique_ptr<Watcher> watcher = std::make_unique<Watcher>();
+        const bool started = watcher->Start(dirPath, [this, root = dirPath](const vector<ChangeEvent>& events) {
+            for (const ChangeEvent& event : events) {
+                if (event.action == ChangeAction::Rescan) {
+                    InvalidateDirectory(root);
+                    return;
+                }
+
+                const wstring path = root + L"\\" + event.path;
+                Invalidate(path);
+                // A removed (or renamed) directory takes its files with it
+                if (event.action == ChangeAction::Removed) {
+                    InvalidateDirectory(path);
+                }
+            }
+        });
+
+        if (!started) [[unlikely]] {
+            LOG_WARNING(L"ContentCache - Watch", L"(" + dirPath + L") Couldn't be watched, its files are checked on every hit");
+            return false;
+        }
+
+        // Cached before the watch started : checked once more, then trusted
+        InvalidateDirectory(dirPath);
+
+        std::lock_guard<std::mutex> lock(mtx);
+        watchedDirectories.push_back(move(prefix));
+        watchers.push_back(move(watcher));
+        return true;
+    }
+    bool ContentCache::IsWatched(const wstring& key) const {
+        return std::any_of(watchedDirectories.begin(), watchedDirectories.end(),
+            [&](const wstring& prefix) { return key.starts_with(prefix); });
+    }
+
+    ContentCache::Stats ContentCache::GetStats() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        Stats current = stats;
+        current.fileCount = index.size();
+        return current;
+    }
+
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include "include.h"
+#include "Watcher.h"
+#include "Archive.h"
+
+namespace FileManager {
+
+	// Read-only bytes of a cached file, shared by every reader : an evicted file lives until its last reader lets it go
+	class CachedFile {
+	public:
+		std::span<const std::byte> GetSpan() const { return { data.get(), size }; }
+		const std::byte* GetData() const { return data.get(); }
+		size_t GetSize() const { return size; }
+
+	private:
+		friend class ContentCache;
+
+		std::unique_ptr<std::byte[]> data;
+		size_t size = 0;
+		UINT64 lastWrite = 0;	// FILETIME as UINT64, 0 if not on the disk (mounted archive)
+		bool watched = false;
+	};
+
+	// Budgeted LRU of whole file contents (shaders, configs, lookup tables, ...), shared by every FileManager.
+	// A hit compares the last write time on the disk (one GetFileAttributesExW) and reloads the file if it changed,
+	//	except for files under a watched directory : the Watcher invalidates them as soon as they change.
+	// Files bigger than the budget are read but not kept.
+	class ContentCache {
+	public:
+		static constexpr UINT64 DEFAULT_BUDGET = 256 * 1024 * 1024;
+
+		using Content = std::shared_ptr<const CachedFile>;
+
+		struct Stats {
+			UINT64 hits = 0;
+			UINT64 misses = 0;
+			UINT64 evictions = 0;
+			UINT64 invalidations = 0;	// Changed on the disk, or invalidated
+			UINT64 bytes = 0;
+			size_t fileCount = 0;
+		};
+
+		explicit ContentCache(UINT64 budget = DEFAULT_BUDGET) : budget(budget) {}
+		ContentCache(const ContentCache&) = delete;
+		ContentCache& operator=(const ContentCache&) = delete;
+		~ContentCache();
+
+		// Content of filePath, read if it isn't cached or changed. nullptr if it couldn't be read.
+		Content Read(const wstring& filePath);
+		// Content of filePath if it is cached and up to date, nullptr otherwise (counted as a miss)
+		Content Find(const wstring& filePath);
+		// A read done elsewhere (LoadBatch, ...) : BeginInsert before reading filePath, then EndInsert with the bytes
+		//	(or CancelInsert if the read failed). They are only cached if filePath wasn't invalidated meanwhile.
+		struct PendingInsert {
+			wstring key;
+			UINT64 generation = 0;
+			UINT64 lastWrite = 0;	// Taken before the read, 0 if not on the disk
+		};
+		PendingInsert BeginInsert(const wstring& filePath);
+		Content EndInsert(const PendingInsert& pending, std::span<const std::byte> data);
+		void CancelInsert(const PendingInsert& pending);
+
+		void Invalidate(const wstring& filePath);
+		// Every cached file under dirPath
+		void InvalidateDirectory(const wstring& dirPath);
+		void Clear();
+		void SetBudget(UINT64 newBudget);
+
+		// Watches dirPath (recursively) : its cached files are invalidated when they change and hits skip the check
+		bool Watch(const wstring& dirPath);
+
+		Stats GetStats() const;
+
+	private:
+		using LruList = std::list<std::pair<wstring, Content>>;
+
+		// Reads the whole file, nullptr if it couldn't be read
+		static std::shared_ptr<CachedFile> Load(const wstring& filePath);
+		// A Read (or a PendingInsert) loading key : BeginLoad gives the generation of key, EndLoad only caches file if it is still the same
+		//	(no invalidation of key meanwhile), then gives file back
+		UINT64 BeginLoad(const wstring& key);
+		Content EndLoad(const wstring& key, UINT64 generation, std::shared_ptr<CachedFile> file);
+		// Caches file under key, replacing what was there (mtx must be held)
+		void Insert(const wstring& key, const std::shared_ptr<CachedFile>& file, LruList& evicted);
+		// Moves the least recently used files over budget into evicted (mtx must be held)
+		void EvictOverflow(LruList& evicted);
+		bool IsWatched(const wstring& key) const;
+
+		mutable std::mutex mtx;
+		UINT64 budget;
+		LruList lru;	// Front is the most recently used, keyed by normalized path
+		std::unordered_map<wstring, LruList::iterator> index;
+		Stats stats;
+
+		struct PendingLoad {
+			UINT32 readers = 0;
+			UINT64 generation = 0;		// Moves on with each invalidation of the key
+		};
+		std::unordered_map<wstring, PendingLoad> loading;	// Keys being read by Read
+
+		vector<wstring> watchedDirectories;		// Normalized, with a trailing '\'
+		vector<std::unique_ptr<Watcher>> watchers;
+	};
+
+}
@@ -0,0 +1,39 @@
+#include "DirectoryListing.h"
+
+namespace FileManager {
+
+    void DirectoryListing::Add(std::wstring_view directory, std::wstring_view name, UINT64 size, UINT64 lastWrite, DWORD attributes) {
+        Entry entry;
+        entry.pathOffset = static_cast<UINT32>(paths.size());
+        entry.attributes = attributes;
+        entry.size = size;
+        entry.lastWrite = lastWrite;
+
+        if (!directory.empty()) {
+            paths.insert(paths.end(), directory.begin(), directory.end());
+            paths.push_back(L'\\');
+        }
+        paths.insert(paths.end(), name.begin(), name.end());
+
+        entry.pathLength = static_cast<UINT32>(paths.size() - entry.pathOffset);
+        entries.push_back(entry);
+    }
+
+    void DirectoryListing::Append(const DirectoryListing& other) {
+        const UINT32 base = static_cast<UINT32>(paths.size());
+
+        paths.insert(paths.end(), other.paths.begin(), other.paths.end());
+
+        entries.reserve(entries.size() + other.entries.size());
+        for (Entry entry : other.entries) {
+            entry.pathOffset += base;
+            entries.push_back(entry);
+        }
+    }
+
+    void DirectoryListing::Reserve(size_t entryCount, size_t pathLength) {
+        entries.reserve(entryCount);
+        paths.reserve(pathLength);
+    }
+
+}
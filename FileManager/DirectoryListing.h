@@ -0,0 +1,47 @@
+#pragma once
+#include "include.h"
+
+namespace FileManager {
+
+	// Files found by FileManager::Enumerate. Every path is stored once, back to back, in a single buffer
+	//	and entries only keep their slice of it, so a 500k files listing is a few allocations.
+	// Order isn't specified (subdirectories are scanned in parallel).
+	class DirectoryListing {
+	public:
+		struct Entry {
+			UINT32 pathOffset = 0;	// In WCHAR, inside the path buffer
+			UINT32 pathLength = 0;
+			DWORD attributes = 0;
+			UINT64 size = 0;
+			UINT64 lastWrite = 0;	// FILETIME as UINT64
+		};
+
+		DirectoryListing() = default;
+		explicit DirectoryListing(const wstring& root) : root(root) {}
+
+		const wstring& GetRoot() const { return root; }
+		size_t GetCount() const { return entries.size(); }
+		bool IsEmpty() const { return entries.empty(); }
+
+		const vector<Entry>& GetEntries() const { return entries; }
+		const Entry& GetEntry(size_t index) const { return entries[index]; }
+
+		// Relative to the root, with '\' separators
+		std::wstring_view GetPath(size_t index) const {
+			return { paths.data() + entries[index].pathOffset, entries[index].pathLength };
+		}
+		wstring GetFullPath(size_t index) const {
+			return root + L"\\" + wstring(GetPath(index));
+		}
+
+		void Add(std::wstring_view directory, std::wstring_view name, UINT64 size, UINT64 lastWrite, DWORD attributes);
+		void Append(const DirectoryListing& other);
+		void Reserve(size_t entryCount, size_t pathLength);
+
+	private:
+		wstring root;
+		vector<WCHAR> paths;
+		vector<Entry> entries;
+	};
+
+}
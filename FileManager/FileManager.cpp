@@ -1,56 +1,129 @@
 #include "FileManager.h"
+#include <winioctl.h>
+#include <cstring>
 #include "..\..\myLib\LogManager\LogManager.h"
 
 namespace FileManager {
 
+    namespace {
+        OVERLAPPED MakeOverlapped(UINT64 offset) {
+            OVERLAPPED overlapped = { 0 };
+            overlapped.Offset = (DWORD)(offset & 0xFFFFFFFF);        // For 4  firsts bytes of the UINT64 offset
+            overlapped.OffsetHigh = (DWORD)(offset >> 32);           // For 4 lastest bytes of the UINT64 offset
+            return overlapped;
+        }
+        bool ReadAt(HANDLE hFile, void* buffer, DWORD size, UINT64 offset) {
+            OVERLAPPED overlapped = MakeOverlapped(offset);
+            DWORD bytesRead = 0;
+            return ::ReadFile(hFile, buffer, size, &bytesRead, &overlapped) && bytesRead == size;
+        }
+        bool WriteAt(HANDLE hFile, const void* buffer, DWORD size, UINT64 offset) {
+            OVERLAPPED overlapped = MakeOverlapped(offset);
+            DWORD bytesWritten = 0;
+            return ::WriteFile(hFile, buffer, size, &bytesWritten, &overlapped) && bytesWritten == size;
+        }
+        DWORD PageSize() {
+            static const DWORD pageSize = [] {
+                SYSTEM_INFO info;
+                GetSystemInfo(&info);
+                return info.dwPageSize;
+            }();
+            return pageSize;
+        }
+        DWORD AllocationGranularity() {
+            static const DWORD granularity = [] {
+                SYSTEM_INFO info;
+                GetSystemInfo(&info);
+                return info.dwAllocationGranularity;
+            }();
+            return granularity;
+        }
+        void LogOpenFailure(const wstring& filePath, DWORD lastError, const wchar_t* source) {
+            if (lastError == ERROR_FILE_NOT_FOUND || lastError == ERROR_PATH_NOT_FOUND) {
+                LOG_WARNING(source, L"(" + filePath + L") File doesn't exist");
+            }
+            else {
+                LOG_ERROR(source, L"(" + filePath + L") CreateFile failed with error " + to_wstring(lastError));
+            }
+        }
+    }
+
+    HandleCache FileManager::handleCache;
+    ContentCache FileManager::contentCache;
+    VirtualFileSystem FileManager::archiveMounts;
+    std::atomic<size_t> FileManager::mountCount = 0;
+    std::mutex FileManager::recorderMtx;
+    std::atomic<PrefetchRecorder*> FileManager::prefetchRecorder = nullptr;
+
+    HandleCache::Lease FileManager::AcquireHandle(const wstring& filePath, DWORD access, const wchar_t* source, bool cacheOnMiss, bool verify) {
+        DWORD lastError = ERROR_SUCCESS;
+        HandleCache::Lease file = handleCache.Acquire(filePath, access, lastError, cacheOnMiss, verify);
+
+        if (!file) [[unlikely]] {
+            LogOpenFailure(filePath, lastError, source);
+        }
+        return file;
+    }
+
+    VirtualFileSystem::MountId FileManager::MountArchive(const wstring& mountPoint, std::shared_ptr<const Archive> archive) {
+        const VirtualFileSystem::MountId id = archiveMounts.MountArchive(mountPoint, move(archive));
+        if (id != VirtualFileSystem::INVALID_MOUNT) {
+            mountCount++;
+        }
+        return id;
+    }
+    void FileManager::UnmountArchive(VirtualFileSystem::MountId id) {
+        if (archiveMounts.Unmount(id)) {
+            mountCount--;
+        }
+    }
+    std::shared_ptr<const Archive> FileManager::FindMounted(const wstring& filePath, const Archive::Entry*& entry) {
+        if (mountCount.load(std::memory_order_relaxed) == 0) [[likely]] {
+            return nullptr;
+        }
+
+        // Normalized on the stack, a read doesn't allocate for the lookup (only an unusually long path does)
+        std::array<WCHAR, MAX_PATH> buffer;
+        wstring longPath;
+        std::wstring_view normalized;
+        if (filePath.size() <= buffer.size()) [[likely]] {
+            normalized = std::wstring_view(buffer.data(), Archive::NormalizePath(filePath, buffer));
+        }
+        else {
+            longPath = Archive::NormalizePath(filePath);
+            normalized = longPath;
+        }
+
+        return archiveMounts.FindArchiveEntry(VirtualPath::View(normalized), entry);
+    }
+
     bool FileManager::ReadFile(const string& filePath, UINT64 offset, UINT64 offsetEnd) {
         wstring path = wstring(filePath.begin(), filePath.end());
         return ReadFile(path, offset, offsetEnd);
     }
-    bool FileManager::ReadFile(const wstring& filePath, UINT64 offset, UINT64 offsetEnd) {
-        if (!FileExists(filePath)) [[unlikely]] {
-            LOG_WARNING(L"FileManager - ReadFile", L"(" + filePath + L") File doesn't exist");
-            return false;
-        }
+    bool FileManager::OpenRange(const wstring& filePath, UINT64 offset, UINT64& offsetEnd, RangeSource& source) {
+        // Start : Get HANDLE (or archive entry)
+        source.archive = FindMounted(filePath, source.packed);
 
-        // Start : Get HANDLE 
-        HANDLE hFile = CreateFileW(
-            filePath.c_str(),
-            GENERIC_READ,
-            FILE_SHARE_DELETE | FILE_SHARE_READ | FILE_SHARE_WRITE,
-            nullptr,
-            OPEN_EXISTING,
-            FILE_FLAG_SEQUENTIAL_SCAN,
-            nullptr
-        );
-
-        if (hFile == INVALID_HANDLE_VALUE) [[unlikely]] {
-            LOG_ERROR("FileManager - ReadFile", "CreateFile");
-            return false;
+        if (!source.archive) {
+            source.file = AcquireHandle(filePath, GENERIC_READ, L"FileManager - ReadFile");
+            if (!source.file) [[unlikely]] {
+                return false;
+            }
         }
         // End : Get HANDLE
 
         // Start : Get Size + Checking
-        LARGE_INTEGER fileSizeStruct;
-        if (!GetFileSizeEx(hFile, &fileSizeStruct)) [[unlikely]] {
-            LOG_ERROR("FileManager - ReadFile", "Error with GetFileSizeEx");
-            CloseHandle(hFile);
-            return false;
-        }
-
-
-        UINT64 fileSize = fileSizeStruct.QuadPart;
+        UINT64 fileSize = source.archive ? source.packed->size : source.file->size.load();
 
         if (fileSize < offset) [[unlikely]] {
             LOG_WARNING("FileManager - ReadFile", "Starting offset is bigger than the file size : "
                 + to_string(fileSize) + " < " + to_string(offset));
-            CloseHandle(hFile);
             return false;
         }
         if (fileSize < offsetEnd) [[unlikely]] {
             LOG_WARNING("FileManager - ReadFile", "Ending offset is bigger than the file size : "
                 + to_string(fileSize) + " < " + to_string(offsetEnd));
-            CloseHandle(hFile);
             return false;
         }
 
@@ -59,202 +132,781 @@ namespace FileManager {
         if (offset > offsetEnd) [[unlikely]] {
             LOG_WARNING("FileManager - ReadFile", "Ending offset is bigger than the starting offset : "
                 + to_string(offset) + " > " + to_string(offsetEnd));
-            CloseHandle(hFile);
             return false;
         }
+        // End : Get Size + Checking
 
-        UINT64 bytesToRead = offsetEnd - offset;
-
-        if (bytesToRead > MAXDWORD) [[unlikely]] {
-            LOG_WARNING("FileManager - ReadFile", "File to big (> 4GB)");
-            CloseHandle(hFile);
+        return true;
+    }
+    bool FileManager::ReadSource(const wstring& filePath, RangeSource& source, std::span<std::byte> buffer, UINT64 offset) {
+        const bool read = source.archive ? source.archive->Read(*source.packed, buffer, offset) : ReadRange(filePath, *source.file, buffer, offset);
+        if (read) [[likely]] {
+            RecordRead(filePath, offset, buffer.size());
+        }
+        return read;
+    }
+    bool FileManager::ReadFile(const wstring& filePath, UINT64 offset, UINT64 offsetEnd) {
+        RangeSource source;
+        if (!OpenRange(filePath, offset, offsetEnd, source)) [[unlikely]] {
             return false;
         }
-        // End : Get Size + Checking
-
 
         data.clear();
-        data.resize(bytesToRead);
+        data.resize(offsetEnd - offset);
 
-        DWORD bytesRead = 0;
+        return ReadSource(filePath, source, std::as_writable_bytes(std::span(data)), offset);
+    }
+    bool FileManager::ReadFile(const wstring& filePath, BufferLease& lease, UINT64 offset, UINT64 offsetEnd) {
+        RangeSource source;
+        if (!OpenRange(filePath, offset, offsetEnd, source)) [[unlikely]] {
+            return false;
+        }
 
-        OVERLAPPED overlapped = { 0 };
-        overlapped.Offset = (DWORD)(offset & 0xFFFFFFFF);        // For 4  firsts bytes of the UINT64 offset
-        overlapped.OffsetHigh = (DWORD)(offset >> 32);           // For 4 lastest bytes of the UINT64 offset
+        lease = BufferPool::Acquire(offsetEnd - offset);
 
-        BOOL success = ::ReadFile(
-            hFile,
-            data.data(),
-            static_cast<DWORD>(bytesToRead),
-            &bytesRead,
-            &overlapped
-        );
+        if (!ReadSource(filePath, source, lease.GetSpan(), offset)) [[unlikely]] {
+            lease.Release();
+            return false;
+        }
+        return true;
+    }
+    bool FileManager::ReadFile(const wstring& filePath, std::span<std::byte> buffer, UINT64 offset) {
+        // Only a read that succeeded is recorded : a failed one isn't worth prefetching
+        const Archive::Entry* packed = nullptr;
+        if (std::shared_ptr<const Archive> archive = FindMounted(filePath, packed)) {
+            if (!archive->Read(*packed, buffer, offset)) [[unlikely]] {
+                return false;
+            }
+            RecordRead(filePath, offset, buffer.size());
+            return true;
+        }
 
-        CloseHandle(hFile);
+        // Start : Get HANDLE 
+        HandleCache::Lease file = AcquireHandle(filePath, GENERIC_READ, L"FileManager - ReadFile");
+        if (!file) [[unlikely]] {
+            return false;
+        }
+        // End : Get HANDLE
 
-        if (!success || bytesRead != bytesToRead) [[unlikely]] {
-            LOG_ERROR("FileManager - ReadFile", "ReadFile - Readed: " + to_string(bytesRead) +
-                " / Should've been: " + to_string(bytesToRead));
+        UINT64 fileSize = file->size;
+        if (fileSize < offset || fileSize - offset < buffer.size()) [[unlikely]] {
+            LOG_WARNING("FileManager - ReadFile", "Reading past the end of the file : "
+                + to_string(offset) + " + " + to_string(buffer.size()) + " > " + to_string(fileSize));
             return false;
         }
 
+        if (!ReadRange(filePath, *file, buffer, offset)) [[unlikely]] {
+            return false;
+        }
+        RecordRead(filePath, offset, buffer.size());
+        return true;
+    }
+    bool FileManager::GetFileSize(const wstring& filePath, UINT64& fileSize) {
+        const Archive::Entry* packed = nullptr;
+        if (FindMounted(filePath, packed)) {
+            fileSize = packed->size;
+            return true;
+        }
+
+        HandleCache::Lease file = AcquireHandle(filePath, GENERIC_READ, L"FileManager - GetFileSize");
+        if (!file) [[unlikely]] {
+            return false;
+        }
 
+        fileSize = file->size;
         return true;
     }
-    bool FileManager::WriteFile(const wstring& filePath, const vector<UINT8>& dataToWrite, UINT64 offset) {
-        if (!FileExists(filePath)) {
-            LOG_WARNING(L"FileManager - WriteFile", L"(" + filePath + L") File doesn't exist");
+    bool FileManager::ReadRange(const wstring& filePath, HandleCache::Entry& file, std::span<std::byte> buffer, UINT64 offset) {
+        // ::ReadFile takes a DWORD size, bigger buffers are read in several calls
+        for (size_t done = 0; done < buffer.size();) {
+            DWORD bytesToRead = static_cast<DWORD>(std::min<size_t>(buffer.size() - done, MAX_IO_SIZE));
+            DWORD bytesRead = 0;
+            OVERLAPPED overlapped = MakeOverlapped(offset + done);
+
+            BOOL success = ::ReadFile(
+                file.handle,
+                buffer.data() + done,
+                bytesToRead,
+                &bytesRead,
+                &overlapped
+            );
+
+            if (!success || bytesRead != bytesToRead) [[unlikely]] {
+                // The file probably changed behind our back, the next call will reopen it
+                handleCache.Invalidate(filePath);
+                LOG_ERROR("FileManager - ReadFile", "ReadFile - Readed: " + to_string(bytesRead) +
+                    " / Should've been: " + to_string(bytesToRead));
+                return false;
+            }
+
+            done += bytesRead;
+        }
+
+        return true;
+    }
+    bool FileManager::ReadFileUnbuffered(const wstring& filePath, std::span<std::byte> buffer, UINT64 offset, UINT32 queueDepth) {
+        HANDLE hFile = OpenUnbuffered(filePath);
+        if (hFile == INVALID_HANDLE_VALUE) [[unlikely]] {
             return false;
         }
 
-        // Start : Get HANDLE 
+        bool success = ReadUnbuffered(filePath, hFile, buffer, 0, offset, queueDepth);
+        CloseHandle(hFile);
+        return success;
+    }
+    bool FileManager::ReadFileUnbuffered(const wstring& filePath, AlignedBuffer& buffer, UINT32 queueDepth) {
+        HANDLE hFile = OpenUnbuffered(filePath);
+        if (hFile == INVALID_HANDLE_VALUE) [[unlikely]] {
+            return false;
+        }
+
+        // Sized from the handle that is read, not by path (GetFileSize would look in the mounted archives)
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(hFile, &fileSize)) [[unlikely]] {
+            LOG_ERROR(L"FileManager - ReadFileUnbuffered", L"(" + filePath + L") GetFileSizeEx failed with error " + to_wstring(GetLastError()));
+            CloseHandle(hFile);
+            return false;
+        }
+
+        // The capacity is whole pages : the last sector is read in place too
+        bool success = buffer.Allocate(static_cast<size_t>(fileSize.QuadPart)) && ReadUnbuffered(filePath, hFile, buffer.GetSpan(), buffer.GetCapacity() - buffer.GetSize(), 0, queueDepth);
+        CloseHandle(hFile);
+        return success;
+    }
+    HANDLE FileManager::OpenUnbuffered(const wstring& filePath) {
         HANDLE hFile = CreateFileW(
             filePath.c_str(),
-            GENERIC_WRITE,
-            FILE_SHARE_DELETE | FILE_SHARE_WRITE | FILE_SHARE_READ,
+            GENERIC_READ,
+            FILE_SHARE_DELETE | FILE_SHARE_READ | FILE_SHARE_WRITE,
             nullptr,
             OPEN_EXISTING,
-            FILE_ATTRIBUTE_NORMAL,
+            FILE_FLAG_NO_BUFFERING | FILE_FLAG_OVERLAPPED,
             nullptr
         );
 
-        if (hFile == INVALID_HANDLE_VALUE) {
-            LOG_ERROR("FileManager - WriteFile", "CreateFile");
+        if (hFile == INVALID_HANDLE_VALUE) [[unlikely]] {
+            LOG_ERROR(L"FileManager - ReadFileUnbuffered", L"(" + filePath + L") CreateFile failed with error " + to_wstring(GetLastError()));
+        }
+        return hFile;
+    }
+    bool FileManager::ReadUnbuffered(const wstring& filePath, HANDLE hFile, std::span<std::byte> buffer, size_t slack, UINT64 offset, UINT32 queueDepth) {
+        // Start : Size + sector
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(hFile, &fileSize) || UINT64(fileSize.QuadPart) < offset || UINT64(fileSize.QuadPart) - offset < buffer.size()) [[unlikely]] {
+            LOG_WARNING("FileManager - ReadFileUnbuffered", "Reading past the end of the file : "
+                + to_string(offset) + " + " + to_string(buffer.size()) + " > " + to_string(fileSize.QuadPart));
             return false;
         }
-        // End : Get HANDLE 
+        if (buffer.empty()) {
+            return true;
+        }
+
+        // Offsets, sizes and addresses must all be multiples of it
+        FILE_STORAGE_INFO storage;
+        UINT64 sector = 4096;
+        if (GetFileInformationByHandleEx(hFile, FileStorageInfo, &storage, sizeof(storage))) [[likely]] {
+            sector = std::max<DWORD>(storage.FileSystemEffectivePhysicalBytesPerSectorForAtomicity, storage.LogicalBytesPerSector);
+        }
+        // End : Size + sector
+
+        // Start : Requests
+        struct Request {
+            UINT64 fileOffset;
+            DWORD size;
+            std::byte* target;      // nullptr : into the slot's bounce buffer, then the part inside [offset, end) is copied out
+        };
+        vector<Request> requests;
+
+        const UINT64 end = offset + buffer.size();
+        const UINT64 alignedStart = offset / sector * sector;
+        const UINT64 alignedEnd = (end + sector - 1) / sector * sector;
+        const bool inPlace = (reinterpret_cast<UINT_PTR>(buffer.data()) - offset) % sector == 0;
+        bool needsBounce = false;
+
+        auto addRange = [&](UINT64 start, UINT64 rangeEnd, bool direct) {
+            for (UINT64 at = start; at < rangeEnd; at += UNBUFFERED_CHUNK_SIZE) {
+                const DWORD size = static_cast<DWORD>(std::min<UINT64>(UNBUFFERED_CHUNK_SIZE, rangeEnd - at));
+                requests.push_back({ at, size, direct ? buffer.data() + (at - offset) : nullptr });
+            }
+            needsBounce |= !direct && start < rangeEnd;
+        };
 
+        const UINT64 bodyStart = (offset + sector - 1) / sector * sector;
+        const UINT64 bodyEnd = alignedEnd - end <= slack ? alignedEnd : end / sector * sector;
 
-        // Start : Get Size
-        LARGE_INTEGER fileSizeStruct;
-        if (!GetFileSizeEx(hFile, &fileSizeStruct)) {
-            LOG_ERROR("FileManager - WriteFile", "Error with GetFileSizeEx");
-            CloseHandle(hFile);
+        if (!inPlace || bodyStart > bodyEnd) {
+            addRange(alignedStart, alignedEnd, false);
+        }
+        else {
+            addRange(alignedStart, bodyStart, false);    // Head sector
+            addRange(bodyStart, bodyEnd, true);
+            addRange(bodyEnd, alignedEnd, false);        // Tail sector
+        }
+        // End : Requests
+
+        // Start : Queue
+        // Slot i handles requests i, i + queueDepth, ... and they complete in order
+        queueDepth = std::clamp<UINT32>(queueDepth, 1, static_cast<UINT32>(std::max<size_t>(requests.size(), 1)));
+
+        AlignedBuffer bounce;
+        if (needsBounce && !bounce.Allocate(size_t(queueDepth) * UNBUFFERED_CHUNK_SIZE)) [[unlikely]] {
             return false;
         }
 
-        UINT64 fileSize = fileSizeStruct.QuadPart;
+        vector<OVERLAPPED> slots(queueDepth);
+        for (OVERLAPPED& slot : slots) {
+            slot.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        }
 
-        OVERLAPPED overlapped = { 0 };
-        overlapped.Offset = (DWORD)(offset & 0xFFFFFFFF);        // For 4  firsts bytes of the UINT64 offset
-        overlapped.OffsetHigh = (DWORD)(offset >> 32);           // For 4 lastest bytes of the UINT64 offset
+        bool success = true;
+        size_t issued = 0;
 
-        if (dataToWrite.size() > MAXDWORD) {
-            LOG_WARNING("FileManager - WriteFile", "Data to big (> 4GB)");
-            CloseHandle(hFile);
+        auto issue = [&](size_t index) {
+            const Request& request = requests[index];
+            OVERLAPPED& slot = slots[index % queueDepth];
+            HANDLE hEvent = slot.hEvent;
+            slot = MakeOverlapped(request.fileOffset);
+            slot.hEvent = hEvent;
+
+            std::byte* target = request.target ? request.target : bounce.GetData() + (index % queueDepth) * UNBUFFERED_CHUNK_SIZE;
+            return ::ReadFile(hFile, target, request.size, nullptr, &slot) || GetLastError() == ERROR_IO_PENDING;
+        };
+
+        for (; issued < std::min<size_t>(queueDepth, requests.size()); issued++) {
+            if (!issue(issued)) [[unlikely]] {
+                success = false;
+                break;
+            }
+        }
+
+        for (size_t completed = 0; completed < issued; completed++) {
+            const Request& request = requests[completed];
+            OVERLAPPED& slot = slots[completed % queueDepth];
+
+            // The read may stop at the end of the file, only the part up to end is needed
+            const UINT64 needed = std::min<UINT64>(request.fileOffset + request.size, end) - request.fileOffset;
+            DWORD bytesRead = 0;
+            if (!GetOverlappedResult(hFile, &slot, &bytesRead, TRUE) || bytesRead < needed) [[unlikely]] {
+                LOG_ERROR(L"FileManager - ReadFileUnbuffered", L"(" + filePath + L") Read failed at offset " + to_wstring(request.fileOffset));
+                success = false;
+            }
+
+            if (success && !request.target) {
+                const UINT64 from = std::max(request.fileOffset, offset);
+                const UINT64 to = request.fileOffset + needed;
+                const std::byte* source = bounce.GetData() + (completed % queueDepth) * UNBUFFERED_CHUNK_SIZE + (from - request.fileOffset);
+                std::memcpy(buffer.data() + (from - offset), source, to - from);
+            }
+
+            // Refill the slot, unless something failed : then only drain what is in flight
+            if (success && issued < requests.size()) {
+                if (!issue(issued)) [[unlikely]] {
+                    success = false;
+                }
+                else {
+                    issued++;
+                }
+            }
+        }
+        // End : Queue
+
+        for (OVERLAPPED& slot : slots) {
+            CloseHandle(slot.hEvent);
+        }
+
+        if (success) [[likely]] {
+            RecordRead(filePath, offset, buffer.size());
+        }
+        return success;
+    }
+    BatchResult FileManager::LoadBatch(std::span<const wstring> filePaths, UINT32 workerCount) {
+        BatchResult result;
+        result.files.resize(filePaths.size());
+
+        // Start : Open + Size
+        vector<HandleCache::Lease> handles(filePaths.size());
+        vector<std::shared_ptr<const Archive>> archives(filePaths.size());
+        vector<const Archive::Entry*> packed(filePaths.size(), nullptr);
+
+        ParallelFor(filePaths.size(), [&](size_t i) {
+            archives[i] = FindMounted(filePaths[i], packed[i]);
+            if (archives[i]) {
+                result.files[i].size = packed[i]->size;
+                return;
+            }
+
+            // Hot handles are reused, the others aren't cached to not evict the working set
+            handles[i] = handleCache.Acquire(filePaths[i], GENERIC_READ, result.files[i].error, false);
+            if (handles[i]) [[likely]] {
+                result.files[i].size = handles[i]->size;
+            }
+        }, workerCount);
+        // End : Open + Size
+
+        // Start : Arena layout
+        UINT64 arenaSize = 0;
+        for (BatchResult::File& file : result.files) {
+            if (file.error != ERROR_SUCCESS) [[unlikely]] {
+                continue;
+            }
+            file.offset = arenaSize;
+            arenaSize += (file.size + BatchResult::ALIGNMENT - 1) & ~(BatchResult::ALIGNMENT - 1);
+        }
+
+        result.arena = std::make_unique_for_overwrite<std::byte[]>(arenaSize);
+        result.arenaSize = arenaSize;
+        // End : Arena layout
+
+        ParallelFor(filePaths.size(), [&](size_t i) {
+            if (archives[i]) {
+                if (!archives[i]->Read(*packed[i], result.Get(i))) [[unlikely]] {
+                    result.files[i].error = ERROR_READ_FAULT;
+                }
+                return;
+            }
+            if (!handles[i]) [[unlikely]] {
+                return;
+            }
+            if (!ReadRange(filePaths[i], *handles[i], result.Get(i), 0)) [[unlikely]] {
+                result.files[i].error = ERROR_READ_FAULT;
+            }
+            handles[i].reset();
+        }, workerCount);
+
+        result.failedCount = std::count_if(result.files.begin(), result.files.end(),
+            [](const BatchResult::File& file) { return file.error != ERROR_SUCCESS; });
+
+        // In the requested order, once read
+        for (size_t i = 0; i < filePaths.size(); i++) {
+            if (result.files[i].error == ERROR_SUCCESS) [[likely]] {
+                RecordRead(filePaths[i], 0, result.files[i].size);
+            }
+        }
+
+        if (result.failedCount != 0) [[unlikely]] {
+            LOG_WARNING("FileManager - LoadBatch", to_string(result.failedCount) + " / " + to_string(filePaths.size()) + " files couldn't be loaded");
+        }
+
+        return result;
+    }
+    bool FileManager::Prefetch(const wstring& filePath, UINT64 offset, UINT64 offsetEnd, bool cacheHandle) {
+        const Archive::Entry* packed = nullptr;
+        if (std::shared_ptr<const Archive> archive = FindMounted(filePath, packed)) {
+            return archive->Prefetch(*packed);
+        }
+
+        // Cached (unless speculative) : the read that follows reuses the handle
+        HandleCache::Lease file = AcquireHandle(filePath, GENERIC_READ, L"FileManager - Prefetch", cacheHandle);
+        if (!file) [[unlikely]] {
             return false;
         }
 
-        DWORD bytesToWrite = static_cast<DWORD>(dataToWrite.size());
-        // End : Get Size
+        const UINT64 fileSize = file->size;
+        offsetEnd = offsetEnd == 0 ? fileSize : std::min(offsetEnd, fileSize);
+        if (offset >= offsetEnd) {
+            // Nothing to read (an empty file can't be mapped anyway)
+            return true;
+        }
 
-        DWORD bytesWritten = 0;
+        // Start : Map the range
+        HANDLE hMapping = CreateFileMappingW(file->handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!hMapping) [[unlikely]] {
+            LOG_ERROR(L"FileManager - Prefetch", L"(" + filePath + L") CreateFileMappingW failed with error " + to_wstring(GetLastError()));
+            return false;
+        }
 
-        bool success = ::WriteFile(
-            hFile,
-            dataToWrite.data(),
-            bytesToWrite,
-            &bytesWritten,
-            &overlapped
-        );
+        // A view starts on the allocation granularity
+        const UINT64 viewOffset = offset - offset % AllocationGranularity();
+        void* view = MapViewOfFile(hMapping, FILE_MAP_READ, (DWORD)(viewOffset >> 32), (DWORD)(viewOffset & 0xFFFFFFFF),
+            static_cast<SIZE_T>(offsetEnd - viewOffset));
+        CloseHandle(hMapping);
 
-        CloseHandle(hFile);
+        if (!view) [[unlikely]] {
+            LOG_ERROR(L"FileManager - Prefetch", L"(" + filePath + L") MapViewOfFile failed with error " + to_wstring(GetLastError()));
+            return false;
+        }
+        // End : Map the range
+
+        // The pages are read into the system cache (not our working set), the view isn't needed once they are queued
+        WIN32_MEMORY_RANGE_ENTRY range = { static_cast<std::byte*>(view) + (offset - viewOffset), static_cast<SIZE_T>(offsetEnd - offset) };
+        BOOL success = PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+        UnmapViewOfFile(view);
 
-        if (!success || bytesWritten != bytesToWrite) {
-            LOG_WARNING("FileManager - WriteFile", "Error with WriteFile - Written: " + to_string(bytesWritten) +
-                " / Should've been: " + to_string(bytesToWrite));
+        if (!success) [[unlikely]] {
+            LOG_WARNING(L"FileManager - Prefetch", L"(" + filePath + L") PrefetchVirtualMemory failed with error " + to_wstring(GetLastError()));
+            return false;
+        }
+        return true;
+    }
+    void FileManager::SetPrefetchRecorder(PrefetchRecorder* recorder) {
+        std::lock_guard<std::mutex> lock(recorderMtx);
+        prefetchRecorder.store(recorder, std::memory_order_relaxed);
+    }
+    void FileManager::ResetPrefetchRecorder(PrefetchRecorder* recorder) {
+        // Waits for the read being reported (to recorder or to the one that replaced it)
+        std::lock_guard<std::mutex> lock(recorderMtx);
+        prefetchRecorder.compare_exchange_strong(recorder, nullptr, std::memory_order_relaxed);
+    }
+
+    bool FileManager::WriteFile(const wstring& filePath, const vector<UINT8>& dataToWrite, UINT64 offset) {
+        return WriteFile(filePath, std::as_bytes(std::span(dataToWrite)), offset);
+    }
+    bool FileManager::WriteFile(const wstring& filePath, std::span<const std::byte> dataToWrite, UINT64 offset) {
+        // Start : Get HANDLE 
+        HandleCache::Lease file = AcquireHandle(filePath, GENERIC_READ | GENERIC_WRITE, L"FileManager - WriteFile");
+        if (!file) {
             return false;
         }
+        // End : Get HANDLE 
+
+        bool success = WriteRange(*file, dataToWrite, offset);
+
+        if (!HandleCache::Refresh(*file)) {
+            handleCache.Invalidate(filePath);
+        }
+
+        return success;
+    }
+    bool FileManager::WriteRange(HandleCache::Entry& file, std::span<const std::byte> buffer, UINT64 offset) {
+        // ::WriteFile takes a DWORD size, bigger spans are written in several calls
+        for (size_t done = 0; done < buffer.size();) {
+            DWORD bytesToWrite = static_cast<DWORD>(std::min<size_t>(buffer.size() - done, MAX_IO_SIZE));
+            DWORD bytesWritten = 0;
+            OVERLAPPED overlapped = MakeOverlapped(offset + done);
+
+            BOOL success = ::WriteFile(
+                file.handle,
+                buffer.data() + done,
+                bytesToWrite,
+                &bytesWritten,
+                &overlapped
+            );
+
+            if (!success || bytesWritten != bytesToWrite) {
+                LOG_WARNING("FileManager - WriteFile", "Error with WriteFile - Written: " + to_string(bytesWritten) +
+                    " / Should've been: " + to_string(bytesToWrite));
+                return false;
+            }
+
+            done += bytesWritten;
+        }
 
         return true;
     }
-    bool FileManager::EraseSection(const wstring& filePath, UINT64 offset, UINT64 offsetEnd) {
-        if (!FileExists(filePath)) {
-            LOG_WARNING(L"FileManager - EraseSection", L"(" + filePath + L") File doesn't exist");
+    bool FileManager::WriteGather(const wstring& filePath, UINT64 offset, std::span<const std::span<const std::byte>> pieces) {
+        bool success = false;
+        if (TransferPages(filePath, offset, pieces, true, success)) {
+            return success;
+        }
+
+        // Start : Get HANDLE 
+        HandleCache::Lease file = AcquireHandle(filePath, GENERIC_READ | GENERIC_WRITE, L"FileManager - WriteGather");
+        if (!file) [[unlikely]] {
             return false;
         }
+        // End : Get HANDLE 
 
-        vector<UINT8> someData;
+        success = true;
+        for (std::span<const std::byte> piece : pieces) {
+            if (!WriteRange(*file, piece, offset)) [[unlikely]] {
+                success = false;
+                break;
+            }
+            offset += piece.size();
+        }
+
+        if (!HandleCache::Refresh(*file)) {
+            handleCache.Invalidate(filePath);
+        }
+
+        return success;
+    }
+    bool FileManager::ReadScatter(const wstring& filePath, UINT64 offset, std::span<const std::span<std::byte>> pieces) {
         // Start : Get HANDLE 
+        HandleCache::Lease file = AcquireHandle(filePath, GENERIC_READ, L"FileManager - ReadScatter");
+        if (!file) [[unlikely]] {
+            return false;
+        }
+        // End : Get HANDLE
+
+        UINT64 totalSize = 0;
+        for (std::span<std::byte> piece : pieces) {
+            totalSize += piece.size();
+        }
+
+        UINT64 fileSize = file->size;
+        if (fileSize < offset || fileSize - offset < totalSize) [[unlikely]] {
+            LOG_WARNING("FileManager - ReadScatter", "Reading past the end of the file : "
+                + to_string(offset) + " + " + to_string(totalSize) + " > " + to_string(fileSize));
+            return false;
+        }
+
+        bool success = false;
+        if (!TransferPages(filePath, offset, pieces, false, success)) {
+            success = true;
+            for (UINT64 pieceOffset = offset; std::span<std::byte> piece : pieces) {
+                if (!ReadRange(filePath, *file, piece, pieceOffset)) [[unlikely]] {
+                    success = false;
+                    break;
+                }
+                pieceOffset += piece.size();
+            }
+        }
+
+        if (success) [[likely]] {
+            RecordRead(filePath, offset, totalSize);
+        }
+        return success;
+    }
+    template<typename Piece>
+    bool FileManager::TransferPages(const wstring& filePath, UINT64 offset, std::span<const Piece> pieces, bool write, bool& success) {
+        const DWORD pageSize = PageSize();
+
+        // Start : Whole pages only
+        if (offset % pageSize != 0) {
+            return false;
+        }
+
+        UINT64 totalSize = 0;
+        for (const Piece& piece : pieces) {
+            if (reinterpret_cast<UINT_PTR>(piece.data()) % pageSize != 0 || piece.size() % pageSize != 0) {
+                return false;
+            }
+            totalSize += piece.size();
+        }
+        if (totalSize == 0 || totalSize > MAX_IO_SIZE) {
+            return false;
+        }
+        // End : Whole pages only
+
+        // One element per page, null terminated
+        vector<FILE_SEGMENT_ELEMENT> segments;
+        segments.reserve(totalSize / pageSize + 1);
+        for (const Piece& piece : pieces) {
+            for (size_t page = 0; page < piece.size(); page += pageSize) {
+                FILE_SEGMENT_ELEMENT segment = {};
+                segment.Buffer = PtrToPtr64(piece.data() + page);
+                segments.push_back(segment);
+            }
+        }
+        segments.push_back({});
+
+        // Scatter / gather needs an unbuffered overlapped handle, not the cached one
         HANDLE hFile = CreateFileW(
             filePath.c_str(),
-            GENERIC_WRITE,
-            FILE_SHARE_DELETE | FILE_SHARE_WRITE | FILE_SHARE_READ,
+            write ? GENERIC_WRITE : GENERIC_READ,
+            FILE_SHARE_DELETE | FILE_SHARE_READ | FILE_SHARE_WRITE,
             nullptr,
             OPEN_EXISTING,
+            FILE_FLAG_NO_BUFFERING | FILE_FLAG_OVERLAPPED,
+            nullptr
+        );
+
+        if (hFile == INVALID_HANDLE_VALUE) [[unlikely]] {
+            return false;       // The per piece path reports why
+        }
+
+        OVERLAPPED overlapped = MakeOverlapped(offset);
+        overlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+
+        const DWORD size = static_cast<DWORD>(totalSize);
+        DWORD bytesTransferred = 0;
+        BOOL issued = write
+            ? WriteFileGather(hFile, segments.data(), size, nullptr, &overlapped)
+            : ReadFileScatter(hFile, segments.data(), size, nullptr, &overlapped);
+
+        success = (issued || GetLastError() == ERROR_IO_PENDING) &&
+            GetOverlappedResult(hFile, &overlapped, &bytesTransferred, TRUE) && bytesTransferred == size;
+
+        if (!success) [[unlikely]] {
+            LOG_ERROR(L"FileManager - " + wstring(write ? L"WriteGather" : L"ReadScatter"),
+                L"(" + filePath + L") " + to_wstring(bytesTransferred) + L" / " + to_wstring(size) + L" bytes transferred");
+        }
+
+        CloseHandle(overlapped.hEvent);
+        CloseHandle(hFile);
+
+        // The cached handle holds the size from before the write
+        if (write) {
+            handleCache.Invalidate(filePath);
+        }
+        return true;
+    }
+    bool FileManager::SaveFile(const wstring& filePath, std::span<const std::byte> dataToWrite) {
+        handleCache.Invalidate(filePath);
+
+        HANDLE hFile = CreateFileW(
+            filePath.c_str(),
+            GENERIC_WRITE,
+            FILE_SHARE_DELETE | FILE_SHARE_READ | FILE_SHARE_WRITE,
+            nullptr,
+            CREATE_ALWAYS,
             FILE_ATTRIBUTE_NORMAL,
             nullptr
         );
 
         if (hFile == INVALID_HANDLE_VALUE) {
-            LOG_ERROR("FileManager - EraseSection", "CreateFile");
+            LOG_ERROR(L"FileManager - SaveFile", L"(" + filePath + L") CreateFileW failed");
             return false;
         }
-        // End : Get HANDLE 
 
-        // Start : Get Size + Checking
-        LARGE_INTEGER fileSizeStruct;
-        if (!GetFileSizeEx(hFile, &fileSizeStruct)) {
-            LOG_ERROR("FileManager - EraseSection", "Error with GetFileSizeEx");
-            CloseHandle(hFile);
+        bool success = true;
+        for (size_t done = 0; done < dataToWrite.size();) {
+            DWORD bytesToWrite = static_cast<DWORD>(std::min<size_t>(dataToWrite.size() - done, MAX_IO_SIZE));
+
+            if (!WriteAt(hFile, dataToWrite.data() + done, bytesToWrite, done)) {
+                LOG_ERROR(L"FileManager - SaveFile", L"(" + filePath + L") WriteFile failed at offset " + to_wstring(done));
+                success = false;
+                break;
+            }
+
+            done += bytesToWrite;
+        }
+
+        CloseHandle(hFile);
+        return success;
+    }
+    bool FileManager::WriteFileCompressed(const wstring& filePath, std::span<const std::byte> dataToWrite, UINT32 workerCount) {
+        vector<std::byte> frame = Compression::Compress(dataToWrite, Compression::DEFAULT_BLOCK_SIZE, workerCount);
+        return SaveFile(filePath, frame);
+    }
+    bool FileManager::ReadFileCompressed(const wstring& filePath, vector<std::byte>& data, UINT32 workerCount) {
+        UINT64 frameSize = 0;
+        if (!GetFileSize(filePath, frameSize)) [[unlikely]] {
             return false;
         }
 
+        BufferLease frame = BufferPool::Acquire(frameSize);
+        std::span<const std::byte> frameView = frame.GetSpan();
+        if (!ReadFile(filePath, frame.GetSpan())) [[unlikely]] {
+            return false;
+        }
 
-        UINT64 fileSize = fileSizeStruct.QuadPart;
+        UINT64 size = 0;
+        if (!Compression::GetDecompressedSize(frameView, size)) [[unlikely]] {
+            LOG_WARNING(L"FileManager - ReadFileCompressed", L"(" + filePath + L") Isn't a compressed frame");
+            return false;
+        }
+
+        data.resize(size);
+        return Compression::Decompress(frameView, data, workerCount);
+    }
+    bool FileManager::HashFile(const wstring& filePath, UINT64& hash) {
+        // Verified against the disk : we are hashing because the file changed, and a cached handle
+        //	still points at the old file when it was replaced (saved with a rename)
+        HandleCache::Lease file = AcquireHandle(filePath, GENERIC_READ, L"FileManager - HashFile", false, true);
+        if (!file) [[unlikely]] {
+            return false;
+        }
+
+        const UINT64 fileSize = file->size;
+        const UINT64 chunkSize = std::min(fileSize, HASH_CHUNK_SIZE);
+        std::unique_ptr<std::byte[]> chunk = std::make_unique_for_overwrite<std::byte[]>(chunkSize);
+
+        Hasher hasher;
+        for (UINT64 offset = 0; offset < fileSize; offset += chunkSize) {
+            std::span<std::byte> view(chunk.get(), static_cast<size_t>(std::min(chunkSize, fileSize - offset)));
+
+            if (!ReadRange(filePath, *file, view, offset)) [[unlikely]] {
+                return false;
+            }
+            hasher.Update(view);
+        }
+
+        hash = hasher.Finalize();
+        return true;
+    }
+    bool FileManager::EraseSection(const wstring& filePath, UINT64 offset, UINT64 offsetEnd, EraseMode mode) {
+        // Start : Get HANDLE 
+        HandleCache::Lease file = AcquireHandle(filePath, GENERIC_READ | GENERIC_WRITE, L"FileManager - EraseSection");
+        if (!file) {
+            return false;
+        }
+        // End : Get HANDLE 
+
+        // Start : Get Size + Checking
+        UINT64 fileSize = file->size;
 
         if (fileSize < offset) {
             LOG_WARNING("FileManager - EraseSection", "Starting offset is bigger than the file size : "
                 + to_string(fileSize) + " < " + to_string(offset));
-            CloseHandle(hFile);
             return false;
         }
         if (fileSize < offsetEnd) {
             LOG_WARNING("FileManager - EraseSection", "Ending offset is bigger than the file size : "
                 + to_string(fileSize) + " < " + to_string(offsetEnd));
-            CloseHandle(hFile);
             return false;
         }
 
-        bool shouldCopy = offsetEnd == 0 ? false : true;
-
         if (offset > offsetEnd && offsetEnd != 0) {
             LOG_WARNING("FileManager - EraseSection", "Ending offset is bigger than the starting offset : "
                 + to_string(offset) + " > " + to_string(offsetEnd));
-            CloseHandle(hFile);
             return false;
         }
 
         offsetEnd = offsetEnd == 0 ? fileSize : offsetEnd;
-
         // End : Get Size
 
-        if (shouldCopy) {
-            FileManager fm;
+        bool success = mode == EraseMode::Compact
+            ? CompactSection(file->handle, offset, offsetEnd, fileSize)
+            : ZeroSection(file->handle, offset, offsetEnd, mode == EraseMode::PunchHole);
 
-            if (!fm.ReadFile(filePath, offsetEnd)) {
-                LOG_ERROR("FileManager - EraseSection", "FileManager::ReadFile failed");
-                return false;
+        if (!HandleCache::Refresh(*file)) {
+            handleCache.Invalidate(filePath);
+        }
+
+        return success;
+    }
+    bool FileManager::CompactSection(HANDLE hFile, UINT64 offset, UINT64 offsetEnd, UINT64 fileSize) {
+        // Slide the tail down chunk by chunk, the destination is always behind the source so one buffer is enough
+        if (offsetEnd < fileSize) {
+            const UINT64 bufferSize = std::min(fileSize - offsetEnd, ERASE_BUFFER_SIZE);
+            std::unique_ptr<UINT8[]> buffer(new UINT8[bufferSize]);
+
+            UINT64 readOffset = offsetEnd;
+            UINT64 writeOffset = offset;
+
+            while (readOffset < fileSize) {
+                DWORD chunkSize = static_cast<DWORD>(std::min(fileSize - readOffset, bufferSize));
+
+                if (!ReadAt(hFile, buffer.get(), chunkSize, readOffset)) [[unlikely]] {
+                    LOG_ERROR(L"FileManager - EraseSection", L"ReadFile failed at offset " + to_wstring(readOffset));
+                    return false;
+                }
+                if (!WriteAt(hFile, buffer.get(), chunkSize, writeOffset)) [[unlikely]] {
+                    LOG_ERROR(L"FileManager - EraseSection", L"WriteFile failed at offset " + to_wstring(writeOffset));
+                    return false;
+                }
+
+                readOffset += chunkSize;
+                writeOffset += chunkSize;
             }
-            someData = fm.MoveData();
         }
 
-        LARGE_INTEGER offsetStruct;
-        offsetStruct.QuadPart = offset;
-        bool success = SetFilePointerEx(hFile, offsetStruct, nullptr, FILE_BEGIN);
-        if (!success) LOG_ERROR(L"FileManager - EraseSection", L"SetFilePointerEx failed at offset " + to_wstring(offset));
+        FILE_END_OF_FILE_INFO endOfFile;
+        endOfFile.EndOfFile.QuadPart = fileSize - (offsetEnd - offset);
+        if (!SetFileInformationByHandle(hFile, FileEndOfFileInfo, &endOfFile, sizeof(endOfFile))) [[unlikely]] {
+            LOG_ERROR(L"FileManager - EraseSection", L"Couldn't truncate at offset " + to_wstring(endOfFile.EndOfFile.QuadPart));
+            return false;
+        }
 
-        success = SetEndOfFile(hFile);
-        if (!success) LOG_ERROR(L"FileManager - EraseSection", L"SetEndOfFile failed at offset " + to_wstring(offset) + L"with hFile " + to_wstring((DWORD)hFile));
+        return true;
+    }
+    bool FileManager::ZeroSection(HANDLE hFile, UINT64 offset, UINT64 offsetEnd, bool punchHole) {
+        DWORD bytesReturned = 0;
 
+        // Once sparse, zeroed ranges are deallocated instead of written
+        if (punchHole && !DeviceIoControl(hFile, FSCTL_SET_SPARSE, nullptr, 0, nullptr, 0, &bytesReturned, nullptr)) [[unlikely]] {
+            LOG_WARNING("FileManager - EraseSection", "FSCTL_SET_SPARSE failed (file system without sparse files?), the range will be zeroed");
+        }
 
-        if (shouldCopy) {
-            FileManager fm;
+        FILE_ZERO_DATA_INFORMATION zeroData;
+        zeroData.FileOffset.QuadPart = offset;
+        zeroData.BeyondFinalZero.QuadPart = offsetEnd;
 
-            if (!fm.WriteFile(filePath, someData, offset)) {
-                LOG_INFO("FileManager - EraseSection", "FileManager::WriteFile failed");
-                return false;
-            }
+        if (!DeviceIoControl(hFile, FSCTL_SET_ZERO_DATA, &zeroData, sizeof(zeroData), nullptr, 0, &bytesReturned, nullptr)) [[unlikely]] {
+            LOG_ERROR(L"FileManager - EraseSection", L"FSCTL_SET_ZERO_DATA failed from " + to_wstring(offset) + L" to " + to_wstring(offsetEnd));
+            return false;
         }
 
         return true;
@@ -282,11 +934,12 @@ namespace FileManager {
         }
         searchPath += L"*";
 
+        // Basic info : skips the 8.3 short name lookup
         WIN32_FIND_DATAW findData;
-        HANDLE hFind = FindFirstFileW(searchPath.c_str(), &findData);
+        HANDLE hFind = FindFirstFileExW(searchPath.c_str(), FindExInfoBasic, &findData, FindExSearchNameMatch, nullptr, 0);
 
         if (hFind == INVALID_HANDLE_VALUE) {
-            LOG_ERROR("FileManager - HasFiles", "FindFirstFileW");
+            LOG_ERROR("FileManager - HasFiles", "FindFirstFileExW");
             return false;
         }
 
@@ -308,6 +961,171 @@ namespace FileManager {
         return hasContent;
     }
 
+    DirectoryListing FileManager::Enumerate(const wstring& dirPath, bool recursive, const wstring& filter, UINT32 workerCount) {
+        wstring root = dirPath;
+        while (!root.empty() && root.back() == L'\\') {
+            root.pop_back();
+        }
+
+        DirectoryListing result(root);
+
+        if (!DirectoryExists(dirPath)) [[unlikely]] {
+            LOG_WARNING(L"FileManager - Enumerate", L"Directory (" + dirPath + L") doesn't exist");
+            return result;
+        }
+
+        if (!recursive) {
+            ScanDirectory(root, wstring(), filter, result, nullptr);
+            return result;
+        }
+
+        if (workerCount == 0) {
+            workerCount = DefaultWorkerCount();
+        }
+
+        // Start : Parallel fan out
+        // Directories waiting to be scanned are shared, each worker fills its own listing
+        std::mutex mtx;
+        std::condition_variable cv;
+        vector<wstring> pendingDirs = { wstring() };
+        UINT32 scanningCount = 0;
+
+        vector<DirectoryListing> listings(workerCount);
+
+        auto worker = [&](DirectoryListing& listing) {
+            vector<wstring> subDirs;
+            wstring relativeDir;
+
+            while (true) {
+                {
+                    std::unique_lock<std::mutex> lock(mtx);
+                    cv.wait(lock, [&] { return !pendingDirs.empty() || scanningCount == 0; });
+
+                    if (pendingDirs.empty()) {
+                        return;    // Nothing left and nobody can add more
+                    }
+
+                    relativeDir = move(pendingDirs.back());
+                    pendingDirs.pop_back();
+                    scanningCount++;
+                }
+
+                subDirs.clear();
+                ScanDirectory(root, relativeDir, filter, listing, &subDirs);
+
+                bool wakeOthers = false;
+                {
+                    std::lock_guard<std::mutex> lock(mtx);
+                    for (wstring& subDir : subDirs) {
+                        pendingDirs.push_back(move(subDir));
+                    }
+                    scanningCount--;
+                    wakeOthers = !subDirs.empty() || scanningCount == 0;
+                }
+
+                if (wakeOthers) {
+                    cv.notify_all();
+                }
+            }
+        };
+
+        {
+            vector<std::jthread> threads;
+            threads.reserve(workerCount - 1);
+            for (UINT32 i = 1; i < workerCount; i++) {
+                threads.emplace_back(worker, std::ref(listings[i]));
+            }
+            worker(listings[0]);
+        }
+        // End : Parallel fan out
+
+        size_t entryCount = 0;
+        size_t pathLength = 0;
+        for (const DirectoryListing& listing : listings) {
+            entryCount += listing.GetCount();
+            for (const DirectoryListing::Entry& entry : listing.GetEntries()) {
+                pathLength += entry.pathLength;
+            }
+        }
+
+        result.Reserve(entryCount, pathLength);
+        for (const DirectoryListing& listing : listings) {
+            result.Append(listing);
+        }
+
+        return result;
+    }
+    void FileManager::ScanDirectory(const wstring& root, const wstring& relativeDir, const wstring& filter,
+        DirectoryListing& listing, vector<wstring>* subDirs) {
+        wstring searchPath = root + L'\\';
+        if (!relativeDir.empty()) {
+            searchPath += relativeDir + L'\\';
+        }
+        searchPath += L'*';
+
+        // Basic info + large fetch : no short names and bigger directory reads (fewer kernel round trips)
+        WIN32_FIND_DATAW findData;
+        HANDLE hFind = FindFirstFileExW(searchPath.c_str(), FindExInfoBasic, &findData, FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH);
+
+        if (hFind == INVALID_HANDLE_VALUE) [[unlikely]] {
+            LOG_WARNING(L"FileManager - Enumerate", L"Couldn't scan (" + searchPath + L")");
+            return;
+        }
+
+        do {
+            std::wstring_view name = findData.cFileName;
+            if (name == L"." || name == L"..") {
+                continue;
+            }
+
+            if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+                if (subDirs && !(findData.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)) {
+                    subDirs->push_back(relativeDir.empty() ? wstring(name) : relativeDir + L'\\' + wstring(name));
+                }
+                continue;
+            }
+
+            if (!filter.empty() && !MatchWildcard(filter, name)) {
+                continue;
+            }
+
+            listing.Add(relativeDir, name,
+                (UINT64(findData.nFileSizeHigh) << 32) | findData.nFileSizeLow,
+                (UINT64(findData.ftLastWriteTime.dwHighDateTime) << 32) | findData.ftLastWriteTime.dwLowDateTime,
+                findData.dwFileAttributes);
+        } while (FindNextFileW(hFind, &findData) != 0);
+
+        FindClose(hFind);
+    }
+    bool FileManager::MatchWildcard(std::wstring_view pattern, std::wstring_view name) {
+        // Greedy match with a single backtrack point on the last '*'
+        size_t p = 0, n = 0;
+        size_t starPattern = std::wstring_view::npos, starName = 0;
+
+        while (n < name.size()) {
+            if (p < pattern.size() && (pattern[p] == L'?' || towlower(pattern[p]) == towlower(name[n]))) {
+                p++;
+                n++;
+            }
+            else if (p < pattern.size() && pattern[p] == L'*') {
+                starPattern = p++;
+                starName = n;
+            }
+            else if (starPattern != std::wstring_view::npos) {
+                p = starPattern + 1;
+                n = ++starName;
+            }
+            else {
+                return false;
+            }
+        }
+
+        while (p < pattern.size() && pattern[p] == L'*') {
+            p++;
+        }
+        return p == pattern.size();
+    }
+
 
     bool FileManager::CreateFile(wstring& dirPath, wstring& name) {
         if (dirPath.empty()) {
@@ -334,23 +1152,24 @@ namespace FileManager {
         }
         wstring filePath = dirPath + name;
 
-        if (FileExists(filePath)) {
-            LOG_WARNING(L"FileManager - CreateFile", L"File (" + filePath + L") already exist");
-            return false;
-        }
-
+        // CREATE_NEW fails if the file already exists, no need to check before
         HANDLE hFile = CreateFileW(
             filePath.c_str(),
             GENERIC_READ,
             FILE_SHARE_DELETE | FILE_SHARE_READ | FILE_SHARE_WRITE,
             nullptr,
-            CREATE_ALWAYS,
+            CREATE_NEW,
             FILE_ATTRIBUTE_NORMAL,
             nullptr
         );
 
         if (hFile == INVALID_HANDLE_VALUE) {
-            LOG_ERROR("FileManager - CreateFile", "CreateFileW");
+            if (GetLastError() == ERROR_FILE_EXISTS) {
+                LOG_WARNING(L"FileManager - CreateFile", L"File (" + filePath + L") already exist");
+            }
+            else {
+                LOG_ERROR("FileManager - CreateFile", "CreateFileW");
+            }
             return false;
         }
 
@@ -358,10 +1177,8 @@ namespace FileManager {
         return true;
     }
     bool FileManager::DeleteFile(const wstring& filePath) {
-        if (!FileExists(filePath)) {
-            LOG_WARNING(L"FileManager - DeleteFile", L"File (" + filePath + L") doesn't exist");
-            return false;
-        }
+        // A cached handle would keep the file alive (delete pending) until it is evicted
+        handleCache.Invalidate(filePath);
 
         HANDLE hFile = CreateFileW(
             filePath.c_str(),
@@ -374,7 +1191,13 @@ namespace FileManager {
         );
 
         if (hFile == INVALID_HANDLE_VALUE) {
-            LOG_ERROR("FileManager - DeleteFile", "CreateFileW");
+            DWORD lastError = GetLastError();
+            if (lastError == ERROR_FILE_NOT_FOUND || lastError == ERROR_PATH_NOT_FOUND) {
+                LOG_WARNING(L"FileManager - DeleteFile", L"File (" + filePath + L") doesn't exist");
+            }
+            else {
+                LOG_ERROR("FileManager - DeleteFile", "CreateFileW");
+            }
             return false;
         }
 
@@ -434,6 +1257,9 @@ namespace FileManager {
         }
         // Check if files inside
 
+        // Cached handles of files deleted under it would keep them (delete pending), and the directory, alive
+        handleCache.InvalidateUnder(dirPath);
+
         bool success = RemoveDirectoryW(dirPath.c_str());
 
         if (!success) {
@@ -1,36 +1,210 @@
 #pragma once
 #include "include.h"
 #include "..\LogManager\LogManager.h"
+#include "HandleCache.h"
+#include "Parallel.h"
+#include "DirectoryListing.h"
+#include "Hash.h"
+#include "ChangeCache.h"
+#include "Watcher.h"
+#include "Archive.h"
+#include "Compression.h"
+#include "AppendWriter.h"
+#include "AlignedBuffer.h"
+#include "BufferPool.h"
+#include "PrefetchRecorder.h"
+#include "VirtualFileSystem.h"
+#include "ContentCache.h"
+#include "Blob.h"
 
 namespace FileManager {
-    
+	// How EraseSection gets rid of [offset, offsetEnd)
+	enum class EraseMode {
+		Compact,	// Moves the tail down and shrinks the file
+		Zero,		// Overwrites the range with zeros, the size doesn't change
+		PunchHole,	// Same as Zero but deallocates the range (sparse file) when the file system allows it
+	};
+
+	// Result of FileManager::LoadBatch : every file lives in one arena, in the order of the requested paths
+	struct BatchResult {
+		static constexpr UINT64 ALIGNMENT = 16;
+
+		struct File {
+			UINT64 offset = 0;		// In arena, aligned on ALIGNMENT
+			UINT64 size = 0;
+			DWORD error = ERROR_SUCCESS;
+		};
+
+		std::unique_ptr<std::byte[]> arena;
+		UINT64 arenaSize = 0;
+		vector<File> files;
+		size_t failedCount = 0;
+
+		bool Succeeded(size_t index) const { return files[index].error == ERROR_SUCCESS; }
+		std::span<const std::byte> Get(size_t index) const { return { arena.get() + files[index].offset, files[index].size }; }
+		std::span<std::byte> Get(size_t index) { return { arena.get() + files[index].offset, files[index].size }; }
+	};
+
+	// The static functions are thread-safe and can be called from anywhere without an instance.
+	//	An instance only adds a member buffer (ReadFile / GetData / MoveData) and isn't meant to be shared.
 	class FileManager {
 	public:
+		static constexpr UINT32 DEFAULT_QUEUE_DEPTH = 8;
+		static constexpr DWORD UNBUFFERED_CHUNK_SIZE = 1 << 20;
+
+		// Reads into the member data (see GetData / MoveData)
 		bool ReadFile(const wstring& filePath, UINT64 offset = 0, UINT64 offsetEnd = 0);
 		bool ReadFile(const string& filePath, UINT64 offset = 0, UINT64 offsetEnd = 0);
 
-		bool WriteFile(const wstring& filePath, const vector<UINT8>& dataToWrite, UINT64 offset = 0);
-		bool EraseSection(const wstring& filePath, UINT64 offset, UINT64 offsetEnd = 0);
+		// No instance state : reads exactly buffer.size() bytes at offset into a caller owned buffer
+		//	(pool, upload heap mapping, arena, ...). Use GetFileSize to size it.
+		static bool ReadFile(const wstring& filePath, std::span<std::byte> buffer, UINT64 offset = 0);
+		// Reads [offset, offsetEnd) (0 = up to the end) into a buffer of the calling thread's BufferPool,
+		//	given back when the lease ends : no heap allocation once the pool is warm
+		static bool ReadFile(const wstring& filePath, BufferLease& lease, UINT64 offset = 0, UINT64 offsetEnd = 0);
+		static bool GetFileSize(const wstring& filePath, UINT64& fileSize);
+
+		// Unbuffered (FILE_FLAG_NO_BUFFERING) : bypasses the system cache so a one-shot bulk read doesn't evict
+		//	everyone else's pages, with queueDepth chunks of UNBUFFERED_CHUNK_SIZE in flight.
+		// Any offset / size works : the unaligned head and tail sectors go through a bounce buffer.
+		//	If buffer isn't aligned like offset (address % sector != offset % sector), everything is bounced (one more copy).
+		// Always reads the file on disk, mounted archives aren't looked up.
+		static bool ReadFileUnbuffered(const wstring& filePath, std::span<std::byte> buffer, UINT64 offset = 0, UINT32 queueDepth = DEFAULT_QUEUE_DEPTH);
+		// The whole file, read straight into buffer (resized to the file size)
+		static bool ReadFileUnbuffered(const wstring& filePath, AlignedBuffer& buffer, UINT32 queueDepth = DEFAULT_QUEUE_DEPTH);
+
+		// Opens, sizes and reads every file concurrently (workerCount = 0 -> DefaultWorkerCount()).
+		// A missing or unreadable file only sets its own error, the others are still loaded.
+		static BatchResult LoadBatch(std::span<const wstring> filePaths, UINT32 workerCount = 0);
+
+		// Read-ahead hint : starts reading [offset, offsetEnd) (0 = up to the end) into the system cache and returns
+		//	without waiting for it (PrefetchVirtualMemory on a mapped view), so the next read of the range doesn't stall.
+		// A file of a mounted archive prefetches its stored bytes in the archive mapping.
+		// cacheHandle = false for speculative hints (a replayed trace) : they don't evict the hot handles.
+		static bool Prefetch(const wstring& filePath, UINT64 offset = 0, UINT64 offsetEnd = 0, bool cacheHandle = true);
+		// Every read that succeeds (ReadFile, ReadFileUnbuffered, ReadScatter, LoadBatch) is reported to recorder while it is set.
+		//	PrefetchRecorder::Begin / End do it.
+		static void SetPrefetchRecorder(PrefetchRecorder* recorder);
+		// Unsets recorder only if it is still the one set, then returns once none of its Record calls is running
+		static void ResetPrefetchRecorder(PrefetchRecorder* recorder);
+
+		static bool WriteFile(const wstring& filePath, const vector<UINT8>& dataToWrite, UINT64 offset = 0);
+		static bool WriteFile(const wstring& filePath, std::span<const std::byte> dataToWrite, UINT64 offset = 0);
+		// Writes / reads consecutive pieces (header, tables, blobs, ...) from offset without concatenating them.
+		// Page aligned pieces of whole pages at a page aligned offset go through one WriteFileGather / ReadFileScatter
+		//	(unbuffered), anything else is one positioned call per piece on the cached handle. Never a staging copy.
+		static bool WriteGather(const wstring& filePath, UINT64 offset, std::span<const std::span<const std::byte>> pieces);
+		static bool ReadScatter(const wstring& filePath, UINT64 offset, std::span<const std::span<std::byte>> pieces);
+		static bool EraseSection(const wstring& filePath, UINT64 offset, UINT64 offsetEnd = 0, EraseMode mode = EraseMode::Compact);
+		// Creates the file or replaces its whole content
+		static bool SaveFile(const wstring& filePath, std::span<const std::byte> dataToWrite);
+
+		// The whole file is one Compression frame (see Compression.h), blocks are (de)compressed in parallel
+		static bool WriteFileCompressed(const wstring& filePath, std::span<const std::byte> dataToWrite, UINT32 workerCount = 0);
+		static bool ReadFileCompressed(const wstring& filePath, vector<std::byte>& data, UINT32 workerCount = 0);
 
-		bool FileExists(const wstring& filePath);
-		bool DirectoryExists(const wstring& filePath);
-		bool HasFiles(const wstring& dirPath);
+		// Streams the file through Hasher (see Hash.h), the handle metadata is refreshed first
+		static bool HashFile(const wstring& filePath, UINT64& hash);
 
+		static bool FileExists(const wstring& filePath);
+		static bool DirectoryExists(const wstring& filePath);
+		static bool HasFiles(const wstring& dirPath);
 
-		bool CreateFile(wstring& dirPath, wstring& name);
-		bool DeleteFile(const wstring& filePath);
+		// Lists the files of dirPath (and of its subdirectories, scanned in parallel, if recursive).
+		// filter is a wildcard on the file name ('*' and '?', case insensitive), empty keeps everything.
+		// Directories and reparse points (links) aren't returned nor followed.
+		static DirectoryListing Enumerate(const wstring& dirPath, bool recursive = false, const wstring& filter = wstring(), UINT32 workerCount = 0);
+		static bool MatchWildcard(std::wstring_view pattern, std::wstring_view name);
 
-		bool CreateDirectory(const wstring& dirPath, const wstring& dirName);
-		bool DeleteDirectory(const wstring& dirPath);
+
+		static bool CreateFile(wstring& dirPath, wstring& name);
+		static bool DeleteFile(const wstring& filePath);
+
+		static bool CreateDirectory(const wstring& dirPath, const wstring& dirName);
+		static bool DeleteDirectory(const wstring& dirPath);
 		// Create a safe method and an unsafe -> here I just have to create EnsureCreateDirectorry that will force 
 		//	it's execution even by deleting everything (with still a MessageBox asking if sure)
 
 		
 
-		vector<UINT8> GetData() { return data; }
+		// Every FileManager shares one cache of open handles (see HandleCache)
+		static void SetHandleCacheCapacity(size_t capacity) { handleCache.SetCapacity(capacity); }
+		static void InvalidateHandle(const wstring& filePath) { handleCache.Invalidate(filePath); }
+		static void InvalidateHandlesUnder(const wstring& dirPath) { handleCache.InvalidateUnder(dirPath); }
+		static void ClearHandleCache() { handleCache.Clear(); }
+
+		// Every FileManager shares one cache of whole file contents (see ContentCache)
+		// The content of filePath, from the cache if it is up to date. nullptr if it couldn't be read.
+		static ContentCache::Content ReadFileCached(const wstring& filePath) { return contentCache.Read(filePath); }
+		static ContentCache& GetContentCache() { return contentCache; }
+
+		// Files under mountPoint are read from archive (when it has them) instead of the disk,
+		//	by ReadFile, GetFileSize and LoadBatch. The last mounted archive is looked up first.
+		// Returns the id to unmount it with, VirtualFileSystem::INVALID_MOUNT on failure.
+		//	The mount indexes the entries of archive : it must stay open (not reopened) until it is unmounted.
+		static VirtualFileSystem::MountId MountArchive(const wstring& mountPoint, std::shared_ptr<const Archive> archive);
+		static void UnmountArchive(VirtualFileSystem::MountId id);
+
+		const vector<UINT8>& GetData() const { return data; }
 		constexpr vector<UINT8> MoveData() { return move(data); }
 	private:
 		vector<UINT8> data;
+
+		static constexpr UINT64 ERASE_BUFFER_SIZE = 1 << 20;
+		static constexpr DWORD MAX_IO_SIZE = 1 << 30;
+		static constexpr UINT64 HASH_CHUNK_SIZE = 256 * 1024;
+
+		// Where ReadFile gets its bytes from : a mounted archive entry or the cached handle
+		struct RangeSource {
+			std::shared_ptr<const Archive> archive;
+			const Archive::Entry* packed = nullptr;
+			HandleCache::Lease file;
+		};
+		// Opens filePath and checks [offset, offsetEnd), offsetEnd = 0 becomes the file size
+		static bool OpenRange(const wstring& filePath, UINT64 offset, UINT64& offsetEnd, RangeSource& source);
+		static bool ReadSource(const wstring& filePath, RangeSource& source, std::span<std::byte> buffer, UINT64 offset);
+		static bool ReadRange(const wstring& filePath, HandleCache::Entry& file, std::span<std::byte> buffer, UINT64 offset);
+		static bool WriteRange(HandleCache::Entry& file, std::span<const std::byte> buffer, UINT64 offset);
+		// FILE_FLAG_NO_BUFFERING | FILE_FLAG_OVERLAPPED, logs and returns INVALID_HANDLE_VALUE on failure
+		static HANDLE OpenUnbuffered(const wstring& filePath);
+		// slack : bytes past the end of buffer that may be overwritten (lets the tail sector be read in place).
+		//	hFile comes from OpenUnbuffered and stays open.
+		static bool ReadUnbuffered(const wstring& filePath, HANDLE hFile, std::span<std::byte> buffer, size_t slack, UINT64 offset, UINT32 queueDepth);
+		// One WriteFileGather / ReadFileScatter over whole pages (success is its result),
+		//	returns false without doing anything if the pieces aren't page aligned
+		template<typename Piece>
+		static bool TransferPages(const wstring& filePath, UINT64 offset, std::span<const Piece> pieces, bool write, bool& success);
+		static bool CompactSection(HANDLE hFile, UINT64 offset, UINT64 offsetEnd, UINT64 fileSize);
+		static bool ZeroSection(HANDLE hFile, UINT64 offset, UINT64 offsetEnd, bool punchHole);
+
+		static HandleCache handleCache;
+		static ContentCache contentCache;
+
+		// Archive mounts over disk paths, resolved like any VirtualFileSystem path
+		static VirtualFileSystem archiveMounts;
+		static std::atomic<size_t> mountCount;		// Skips the lookup (and the lock) when nothing is mounted
+
+		// Held while a read is reported, so the recorder can't go away meanwhile.
+		//	Record serializes on the recorder anyway, a shared lock wouldn't let more reads through.
+		static std::mutex recorderMtx;
+		static std::atomic<PrefetchRecorder*> prefetchRecorder;		// Only changed under recorderMtx, skips the lock when not recording
+		static void RecordRead(const wstring& filePath, UINT64 offset, UINT64 size) {
+			if (prefetchRecorder.load(std::memory_order_relaxed)) [[unlikely]] {
+				std::lock_guard<std::mutex> lock(recorderMtx);
+				if (PrefetchRecorder* recorder = prefetchRecorder.load(std::memory_order_relaxed)) {
+					recorder->Record(filePath, offset, size);
+				}
+			}
+		}
+
+		// Archive holding filePath (entry set), nullptr if it should be read from the disk
+		static std::shared_ptr<const Archive> FindMounted(const wstring& filePath, const Archive::Entry*& entry);
+
+		// Scans one directory of root into listing, subDirs (if not nullptr) receives its subdirectories
+		static void ScanDirectory(const wstring& root, const wstring& relativeDir, const wstring& filter,
+			DirectoryListing& listing, vector<wstring>* subDirs);
+		// Open-and-check : logs (with source) why the file couldn't be opened, nullptr if so
+		static HandleCache::Lease AcquireHandle(const wstring& filePath, DWORD access, const wchar_t* source, bool cacheOnMiss = true, bool verify = false);
 	};
 
 }
@@ -0,0 +1,194 @@
+#include "HandleCache.h"
+
+namespace FileManager {
+
+    namespace {
+        // Path characters compared the way the file system does (case-insensitive, both separators)
+        bool SamePathChar(WCHAR a, WCHAR b) {
+            if (a == L'/') {
+                a = L'\\';
+            }
+            if (b == L'/') {
+                b = L'\\';
+            }
+            return towlower(a) == towlower(b);
+        }
+    }
+
+    HandleCache::Lease HandleCache::Acquire(const wstring& filePath, DWORD access, DWORD& lastError, bool cacheOnMiss, bool verify) {
+        lastError = ERROR_SUCCESS;
+        DWORD openAccess = access;
+        Lease cached;
+
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+
+            auto it = index.find(filePath);
+            if (it != index.end()) [[likely]] {
+                if ((it->second->second->access & access) == access) [[likely]] {
+                    lru.splice(lru.begin(), lru, it->second);
+                    cached = it->second->second;
+                }
+                else {
+                    // Reopen with both the old and the new access so the next callers still hit
+                    openAccess |= it->second->second->access;
+                }
+            }
+        }
+
+        // Verified outside the lock, it's a file system query
+        if (cached) [[likely]] {
+            if (!verify || IsCurrent(filePath, *cached)) [[likely]] {
+                return cached;
+            }
+            // Changed or replaced by someone else : the reopened handle takes its place below
+            openAccess |= cached->access;
+        }
+
+        // Open outside the lock: CreateFileW can take a while on network or cold drives
+        Lease entry = Open(filePath, openAccess, lastError);
+        if (!entry) [[unlikely]] {
+            return nullptr;
+        }
+
+        // A stale entry is replaced even by a one-shot open
+        if (!cacheOnMiss && !cached) {
+            return entry;
+        }
+
+        LruList evicted;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+
+            auto it = index.find(filePath);
+            if (it != index.end()) {
+                // Another thread may have raced us, keep the newest (ours has at least the access we need)
+                evicted.splice(evicted.end(), lru, it->second);
+                index.erase(it);
+            }
+
+            lru.emplace_front(filePath, entry);
+            index[filePath] = lru.begin();
+
+            EvictOverflow(evicted);
+        }
+        // evicted handles are closed here, outside the lock (or later by their last lease)
+
+        return entry;
+    }
+
+    HandleCache::Lease HandleCache::Open(const wstring& filePath, DWORD access, DWORD& lastError) {
+        lastError = ERROR_SUCCESS;
+
+        HANDLE hFile = CreateFileW(
+            filePath.c_str(),
+            access,
+            FILE_SHARE_DELETE | FILE_SHARE_READ | FILE_SHARE_WRITE,
+            nullptr,
+            OPEN_EXISTING,
+            (access & GENERIC_WRITE) ? FILE_ATTRIBUTE_NORMAL : FILE_FLAG_SEQUENTIAL_SCAN,
+            nullptr
+        );
+
+        if (hFile == INVALID_HANDLE_VALUE) [[unlikely]] {
+            lastError = GetLastError();
+            return nullptr;
+        }
+
+        Lease entry = std::make_shared<Entry>();
+        entry->handle = hFile;
+        entry->access = access;
+
+        if (!Refresh(*entry)) [[unlikely]] {
+            lastError = GetLastError();
+            return nullptr;
+        }
+        return entry;
+    }
+
+    bool HandleCache::IsCurrent(const wstring& filePath, const Entry& entry) {
+        WIN32_FILE_ATTRIBUTE_DATA attributes;
+        if (!GetFileAttributesExW(filePath.c_str(), GetFileExInfoStandard, &attributes)) [[unlikely]] {
+            return false;
+        }
+
+        const UINT64 size = (UINT64(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+        const UINT64 lastWrite = (UINT64(attributes.ftLastWriteTime.dwHighDateTime) << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+        return size == entry.size && lastWrite == entry.lastWrite;
+    }
+
+    void HandleCache::EvictOverflow(LruList& evicted) {
+        while (lru.size() > capacity) {
+            index.erase(lru.back().first);
+            evicted.splice(evicted.end(), lru, std::prev(lru.end()));
+        }
+    }
+
+    bool HandleCache::Refresh(Entry& entry) {
+        BY_HANDLE_FILE_INFORMATION info;
+        if (!GetFileInformationByHandle(entry.handle, &info)) [[unlikely]] {
+            return false;
+        }
+
+        entry.size = (UINT64(info.nFileSizeHigh) << 32) | info.nFileSizeLow;
+        entry.lastWrite = (UINT64(info.ftLastWriteTime.dwHighDateTime) << 32) | info.ftLastWriteTime.dwLowDateTime;
+        return true;
+    }
+
+    void HandleCache::Invalidate(const wstring& filePath) {
+        LruList evicted;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+
+            auto it = index.find(filePath);
+            if (it == index.end()) {
+                return;
+            }
+            evicted.splice(evicted.end(), lru, it->second);
+            index.erase(it);
+        }
+    }
+    void HandleCache::InvalidateUnder(const wstring& dirPath) {
+        std::wstring_view prefix = dirPath;
+        while (!prefix.empty() && (prefix.back() == L'\\' || prefix.back() == L'/')) {
+            prefix.remove_suffix(1);
+        }
+
+        LruList evicted;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+
+            for (auto it = lru.begin(); it != lru.end();) {
+                const wstring& filePath = it->first;
+                const bool under = filePath.size() > prefix.size()
+                    && SamePathChar(filePath[prefix.size()], L'\\')
+                    && std::equal(prefix.begin(), prefix.end(), filePath.begin(), SamePathChar);
+
+                auto next = std::next(it);
+                if (under) {
+                    index.erase(filePath);
+                    evicted.splice(evicted.end(), lru, it);
+                }
+                it = next;
+            }
+        }
+    }
+    void HandleCache::Clear() {
+        LruList evicted;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            evicted.swap(lru);
+            index.clear();
+        }
+    }
+    void HandleCache::SetCapacity(size_t newCapacity) {
+        LruList evicted;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            capacity = std::max(newCapacity, size_t(1));
+
+            EvictOverflow(evicted);
+        }
+    }
+
+}
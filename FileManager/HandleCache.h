@@ -0,0 +1,66 @@
+#pragma once
+#include "include.h"
+
+namespace FileManager {
+
+	// Bounded LRU of open file handles, shared by every FileManager.
+	// The size and last write time are captured when the handle is opened and refreshed after our own writes.
+	// A hit costs no system call : entries are invalidated by the Watcher and by our own writes.
+	//	Acquire(..., verify = true) also checks a hit against the size and last write time on disk (GetFileAttributesExW, no open),
+	//	so a file changed or replaced (saved with a rename) by another process, outside any watched root, is reopened.
+	class HandleCache {
+	public:
+		static constexpr size_t DEFAULT_CAPACITY = 64;
+
+		struct Entry {
+			HANDLE handle = INVALID_HANDLE_VALUE;
+			DWORD access = 0;
+			std::atomic<UINT64> size = 0;
+			std::atomic<UINT64> lastWrite = 0;	// FILETIME as UINT64
+
+			Entry() = default;
+			Entry(const Entry&) = delete;
+			Entry& operator=(const Entry&) = delete;
+			~Entry() {
+				if (handle != INVALID_HANDLE_VALUE) {
+					CloseHandle(handle);
+				}
+			}
+		};
+		// An evicted entry stays open until its last lease is released
+		using Lease = std::shared_ptr<Entry>;
+
+		explicit HandleCache(size_t capacity = DEFAULT_CAPACITY) : capacity(capacity) {}
+
+		// Returns the cached handle of filePath, (re)opening it if missing or lacking access.
+		// On failure returns nullptr and lastError holds the GetLastError of CreateFileW.
+		// cacheOnMiss = false keeps one-shot opens (batches, scans) from evicting the hot handles.
+		// verify = true reopens a hit that no longer matches the file on disk (the stale entry is replaced).
+		Lease Acquire(const wstring& filePath, DWORD access, DWORD& lastError, bool cacheOnMiss = true, bool verify = false);
+		// A new handle of filePath, never the cached one and not added to the cache
+		static Lease Open(const wstring& filePath, DWORD access, DWORD& lastError);
+
+		// Reloads size and last write time from the handle (after a write, a truncation, ...)
+		static bool Refresh(Entry& entry);
+
+		void Invalidate(const wstring& filePath);
+		// Every file under dirPath, subdirectories included (the path is compared case-insensitively, '/' == '\\')
+		void InvalidateUnder(const wstring& dirPath);
+		void Clear();
+		void SetCapacity(size_t newCapacity);
+
+	private:
+		using LruList = std::list<std::pair<wstring, Lease>>;
+
+		// Whether the file on disk still has the size and last write time of entry
+		static bool IsCurrent(const wstring& filePath, const Entry& entry);
+		// Moves the least recently used entries over capacity into evicted (mtx must be held)
+		void EvictOverflow(LruList& evicted);
+
+		std::mutex mtx;
+		size_t capacity;
+		LruList lru;	// Front is the most recently used
+		std::unordered_map<wstring, LruList::iterator> index;
+	};
+
+}
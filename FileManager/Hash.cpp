@@ -0,0 +1,192 @@
+#include "Hash.h"
+#include <array>
+#include <cstring>
+#include <intrin.h>
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#endif
+
+namespace FileManager {
+
+    namespace {
+        constexpr UINT64 PRIME32_1 = 0x9E3779B1U;
+        constexpr UINT64 PRIME32_2 = 0x85EBCA77U;
+        constexpr UINT64 PRIME32_3 = 0xC2B2AE3DU;
+        constexpr UINT64 PRIME64_1 = 0x9E3779B185EBCA87ULL;
+        constexpr UINT64 PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+        constexpr UINT64 PRIME64_3 = 0x165667B19E3779F9ULL;
+        constexpr UINT64 PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+        constexpr UINT64 PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+        constexpr size_t SECRET_WORDS = 24;                 // 192 bytes, like XXH3's default secret
+        constexpr size_t SCRAMBLE_WORD = SECRET_WORDS - 8;  // Last 64 bytes
+        constexpr size_t LAST_STRIPE_WORD = 15;
+        constexpr size_t MERGE_WORD = 11;
+
+        // splitmix64 sequence, computed at compile time
+        constexpr std::array<UINT64, SECRET_WORDS> MakeSecret() {
+            std::array<UINT64, SECRET_WORDS> secret = {};
+            UINT64 state = PRIME64_1;
+            for (UINT64& word : secret) {
+                state += 0x9E3779B97F4A7C15ULL;
+                UINT64 z = state;
+                z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+                z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+                word = z ^ (z >> 31);
+            }
+            return secret;
+        }
+        alignas(32) constexpr std::array<UINT64, SECRET_WORDS> SECRET = MakeSecret();
+
+        inline UINT64 Read64(const std::byte* p) {
+            UINT64 value;
+            std::memcpy(&value, p, sizeof(value));
+            return value;
+        }
+
+        inline UINT64 Mul128Fold64(UINT64 lhs, UINT64 rhs) {
+#if defined(_MSC_VER)
+            UINT64 high;
+            UINT64 low = _umul128(lhs, rhs, &high);
+            return low ^ high;
+#else
+            unsigned __int128 product = (unsigned __int128)lhs * rhs;
+            return UINT64(product) ^ UINT64(product >> 64);
+#endif
+        }
+
+        // acc[i ^ 1] += data[i], acc[i] += low32(data[i] ^ key[i]) * high32(data[i] ^ key[i])
+        inline void Accumulate(UINT64* acc, const std::byte* stripe, const UINT64* key) {
+#if defined(__AVX2__)
+            for (size_t half = 0; half < 2; half++) {
+                __m256i accVec = _mm256_load_si256(reinterpret_cast<const __m256i*>(acc) + half);
+                __m256i dataVec = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(stripe) + half);
+                __m256i keyVec = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(key) + half);
+
+                __m256i dataKey = _mm256_xor_si256(dataVec, keyVec);
+                __m256i dataKeyHigh = _mm256_shuffle_epi32(dataKey, _MM_SHUFFLE(0, 3, 0, 1));
+                __m256i product = _mm256_mul_epu32(dataKey, dataKeyHigh);
+                __m256i dataSwap = _mm256_shuffle_epi32(dataVec, _MM_SHUFFLE(1, 0, 3, 2));
+
+                accVec = _mm256_add_epi64(accVec, dataSwap);
+                accVec = _mm256_add_epi64(accVec, product);
+                _mm256_store_si256(reinterpret_cast<__m256i*>(acc) + half, accVec);
+            }
+#else
+            for (size_t i = 0; i < 8; i++) {
+                UINT64 data = Read64(stripe + i * 8);
+                UINT64 dataKey = data ^ key[i];
+                acc[i ^ 1] += data;
+                acc[i] += (dataKey & 0xFFFFFFFF) * (dataKey >> 32);
+            }
+#endif
+        }
+
+        // acc[i] = (acc[i] ^ (acc[i] >> 47) ^ key[i]) * PRIME32_1
+        inline void Scramble(UINT64* acc) {
+            const UINT64* key = SECRET.data() + SCRAMBLE_WORD;
+#if defined(__AVX2__)
+            const __m256i prime = _mm256_set1_epi32(static_cast<int>(PRIME32_1));
+            for (size_t half = 0; half < 2; half++) {
+                __m256i accVec = _mm256_load_si256(reinterpret_cast<const __m256i*>(acc) + half);
+                __m256i keyVec = _mm256_load_si256(reinterpret_cast<const __m256i*>(key) + half);
+
+                accVec = _mm256_xor_si256(accVec, _mm256_srli_epi64(accVec, 47));
+                accVec = _mm256_xor_si256(accVec, keyVec);
+
+                __m256i productLow = _mm256_mul_epu32(accVec, prime);
+                __m256i productHigh = _mm256_mul_epu32(_mm256_srli_epi64(accVec, 32), prime);
+                accVec = _mm256_add_epi64(productLow, _mm256_slli_epi64(productHigh, 32));
+                _mm256_store_si256(reinterpret_cast<__m256i*>(acc) + half, accVec);
+            }
+#else
+            for (size_t i = 0; i < 8; i++) {
+                UINT64 value = acc[i];
+                value ^= value >> 47;
+                value ^= key[i];
+                acc[i] = value * PRIME32_1;
+            }
+#endif
+        }
+    }
+
+    void Hasher::Reset() {
+        acc[0] = PRIME32_3;
+        acc[1] = PRIME64_1;
+        acc[2] = PRIME64_2;
+        acc[3] = PRIME64_3;
+        acc[4] = PRIME64_4;
+        acc[5] = PRIME32_2;
+        acc[6] = PRIME64_5;
+        acc[7] = PRIME32_1;
+
+        bufferSize = 0;
+        stripesInBlock = 0;
+        totalLength = 0;
+    }
+
+    void Hasher::ConsumeStripes(const std::byte* input, size_t stripeCount) {
+        for (size_t i = 0; i < stripeCount; i++) {
+            Accumulate(acc, input + i * STRIPE_SIZE, SECRET.data() + stripesInBlock);
+
+            if (++stripesInBlock == STRIPES_PER_BLOCK) {
+                Scramble(acc);
+                stripesInBlock = 0;
+            }
+        }
+    }
+
+    void Hasher::Update(std::span<const std::byte> data) {
+        const std::byte* input = data.data();
+        size_t size = data.size();
+        totalLength += size;
+
+        // Start : Complete the pending stripe
+        if (bufferSize != 0) {
+            size_t toCopy = std::min(size, STRIPE_SIZE - bufferSize);
+            std::memcpy(buffer + bufferSize, input, toCopy);
+            bufferSize += toCopy;
+            input += toCopy;
+            size -= toCopy;
+
+            if (bufferSize < STRIPE_SIZE) {
+                return;
+            }
+            ConsumeStripes(buffer, 1);
+            bufferSize = 0;
+        }
+        // End : Complete the pending stripe
+
+        size_t stripeCount = size / STRIPE_SIZE;
+        ConsumeStripes(input, stripeCount);
+        input += stripeCount * STRIPE_SIZE;
+        size -= stripeCount * STRIPE_SIZE;
+
+        std::memcpy(buffer, input, size);
+        bufferSize = size;
+    }
+
+    UINT64 Hasher::Finalize() const {
+        alignas(32) UINT64 finalAcc[8];
+        std::memcpy(finalAcc, acc, sizeof(acc));
+
+        // The tail is zero padded into a last stripe with its own key, the length (merged below) tells paddings apart
+        if (bufferSize != 0) {
+            alignas(32) std::byte lastStripe[STRIPE_SIZE] = {};
+            std::memcpy(lastStripe, buffer, bufferSize);
+            Accumulate(finalAcc, lastStripe, SECRET.data() + LAST_STRIPE_WORD);
+        }
+
+        UINT64 result = totalLength * PRIME64_1;
+        for (size_t i = 0; i < 4; i++) {
+            result += Mul128Fold64(finalAcc[2 * i] ^ SECRET[MERGE_WORD + 2 * i], finalAcc[2 * i + 1] ^ SECRET[MERGE_WORD + 2 * i + 1]);
+        }
+
+        // Avalanche
+        result ^= result >> 37;
+        result *= 0x165667919E3779F9ULL;
+        result ^= result >> 32;
+        return result;
+    }
+
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include "include.h"
+
+namespace FileManager {
+
+	// Fast non-cryptographic 64-bit hash, built like XXH3's long input loop :
+	//	8 lanes of 64-bit accumulators fed 64 bytes (one stripe) at a time, scrambled every 16 stripes.
+	// The AVX2 path (/arch:AVX2) and the scalar one give the same result, so do any chunkings of the input.
+	// Not bit-compatible with xxHash.
+	class Hasher {
+	public:
+		static constexpr size_t STRIPE_SIZE = 64;
+		static constexpr size_t STRIPES_PER_BLOCK = 16;
+
+		Hasher() { Reset(); }
+
+		void Reset();
+		void Update(std::span<const std::byte> data);
+		UINT64 Finalize() const;
+
+		static UINT64 Hash(std::span<const std::byte> data) {
+			Hasher hasher;
+			hasher.Update(data);
+			return hasher.Finalize();
+		}
+
+	private:
+		void ConsumeStripes(const std::byte* input, size_t stripeCount);
+
+		alignas(32) UINT64 acc[8];
+		alignas(32) std::byte buffer[STRIPE_SIZE];
+		size_t bufferSize = 0;
+		size_t stripesInBlock = 0;
+		UINT64 totalLength = 0;
+	};
+
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include "include.h"
+
+namespace FileManager {
+
+	// Enough threads to keep several requests in flight per core, I/O bound tasks mostly wait
+	inline UINT32 DefaultWorkerCount() {
+		return std::max(std::thread::hardware_concurrency(), 4u);
+	}
+
+	// Runs task(i) for every i in [0, count) on up to workerCount threads (the calling thread is one of them).
+	// Indices are handed out one by one so a slow file doesn't hold back a whole slice.
+	template<typename Task>
+	void ParallelFor(size_t count, Task&& task, UINT32 workerCount = 0) {
+		if (count == 0) {
+			return;
+		}
+		if (workerCount == 0) {
+			workerCount = DefaultWorkerCount();
+		}
+
+		std::atomic<size_t> nextIndex = 0;
+		auto worker = [&]() {
+			for (size_t i = nextIndex++; i < count; i = nextIndex++) {
+				task(i);
+			}
+		};
+
+		const size_t threadCount = std::min<size_t>(workerCount, count);
+		std::vector<std::jthread> threads;
+		threads.reserve(threadCount - 1);
+		for (size_t i = 1; i < threadCount; i++) {
+			threads.emplace_back(worker);
+		}
+
+		worker();
+		// jthreads join when leaving the scope
+	}
+
+}
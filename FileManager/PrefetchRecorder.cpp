@@ -0,0 +1,208 @@
+#include "PrefetchRecorder.h"
+#include "FileManager.h"
+#include <cstring>
+
+namespace FileManager {
+
+    namespace {
+        // On disk : Header, then per scenario : UINT32 name length (in WCHAR), name, UINT32 access count,
+        //	then per access : AccessRecord, path
+        struct Header {
+            UINT32 magic;
+            UINT32 version;
+            UINT64 count;
+        };
+        struct AccessRecord {
+            UINT64 offset;
+            UINT64 offsetEnd;
+            UINT32 pathLength;
+            UINT32 reserved;
+        };
+
+        template<typename T>
+        void Append(vector<std::byte>& out, const T& value) {
+            const std::byte* bytes = reinterpret_cast<const std::byte*>(&value);
+            out.insert(out.end(), bytes, bytes + sizeof(T));
+        }
+        void AppendString(vector<std::byte>& out, const wstring& text) {
+            const std::byte* bytes = reinterpret_cast<const std::byte*>(text.data());
+            out.insert(out.end(), bytes, bytes + text.size() * sizeof(WCHAR));
+        }
+
+        template<typename T>
+        bool Extract(std::span<const std::byte>& in, T& value) {
+            if (in.size() < sizeof(T)) {
+                return false;
+            }
+            std::memcpy(&value, in.data(), sizeof(T));
+            in = in.subspan(sizeof(T));
+            return true;
+        }
+        bool ExtractString(std::span<const std::byte>& in, UINT32 length, wstring& text) {
+            if (in.size() / sizeof(WCHAR) < length) {
+                return false;
+            }
+            text.resize(length);
+            std::memcpy(text.data(), in.data(), length * sizeof(WCHAR));
+            in = in.subspan(length * sizeof(WCHAR));
+            return true;
+        }
+    }
+
+    void PrefetchRecorder::Begin(const wstring& name) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            recording = true;
+            scenario = name;
+            current.clear();
+            currentIndex.clear();
+        }
+        FileManager::SetPrefetchRecorder(this);
+    }
+    void PrefetchRecorder::End() {
+        // Before taking mtx : it waits for our Record calls in progress, and they take mtx
+        FileManager::ResetPrefetchRecorder(this);
+
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!recording) {
+            return;
+        }
+
+        recording = false;
+        traces[scenario] = move(current);
+        current.clear();
+        currentIndex.clear();
+    }
+    bool PrefetchRecorder::IsRecording() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return recording;
+    }
+
+    void PrefetchRecorder::Record(const wstring& filePath, UINT64 offset, UINT64 size) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!recording) [[unlikely]] {
+            return;
+        }
+
+        auto [it, inserted] = currentIndex.try_emplace(filePath, current.size());
+        if (inserted) {
+            current.push_back({ filePath, offset, offset + size });
+            return;
+        }
+
+        Access& access = current[it->second];
+        access.offset = std::min(access.offset, offset);
+        access.offsetEnd = std::max(access.offsetEnd, offset + size);
+    }
+
+    bool PrefetchRecorder::Replay(const wstring& name) {
+        vector<Access> trace;
+        if (!GetTrace(name, trace)) {
+            return false;
+        }
+
+        CancelReplay();
+        replayThread = std::jthread([trace = move(trace)](std::stop_token stop) {
+            for (const Access& access : trace) {
+                if (stop.stop_requested()) {
+                    return;
+                }
+                // A file gone since the recording is only a wasted hint.
+                //	Not cached : a whole trace of handles would evict the ones the game is using.
+                FileManager::Prefetch(access.path, access.offset, access.offsetEnd, false);
+            }
+        });
+        return true;
+    }
+    void PrefetchRecorder::CancelReplay() {
+        if (replayThread.joinable()) {
+            replayThread.request_stop();
+            replayThread.join();
+        }
+    }
+
+    bool PrefetchRecorder::GetTrace(const wstring& name, vector<Access>& trace) const {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = traces.find(name);
+        if (it == traces.end()) {
+            return false;
+        }
+        trace = it->second;
+        return true;
+    }
+
+    bool PrefetchRecorder::Load(const wstring& filePath) {
+        if (!FileManager::FileExists(filePath)) {
+            return true;
+        }
+
+        UINT64 fileSize = 0;
+        if (!FileManager::GetFileSize(filePath, fileSize)) {
+            return false;
+        }
+
+        vector<std::byte> content(fileSize);
+        if (!FileManager::ReadFile(filePath, std::span<std::byte>(content))) {
+            return false;
+        }
+
+        std::span<const std::byte> in(content);
+        Header header;
+        if (!Extract(in, header) || header.magic != MAGIC || header.version != VERSION) {
+            LOG_WARNING(L"PrefetchRecorder - Load", L"(" + filePath + L") isn't a prefetch trace or has an old version, ignored");
+            return false;
+        }
+
+        map<wstring, vector<Access>> loaded;
+        for (UINT64 i = 0; i < header.count; i++) {
+            UINT32 nameLength = 0;
+            wstring name;
+            UINT32 accessCount = 0;
+            if (!Extract(in, nameLength) || !ExtractString(in, nameLength, name) || !Extract(in, accessCount)) {
+                LOG_WARNING(L"PrefetchRecorder - Load", L"(" + filePath + L") is truncated, ignored");
+                return false;
+            }
+
+            vector<Access>& trace = loaded[name];
+            trace.reserve(std::min<size_t>(accessCount, in.size() / sizeof(AccessRecord)));
+            for (UINT32 j = 0; j < accessCount; j++) {
+                AccessRecord record;
+                Access access;
+                if (!Extract(in, record) || !ExtractString(in, record.pathLength, access.path)) {
+                    LOG_WARNING(L"PrefetchRecorder - Load", L"(" + filePath + L") is truncated, ignored");
+                    return false;
+                }
+                access.offset = record.offset;
+                access.offsetEnd = record.offsetEnd;
+                trace.push_back(move(access));
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mtx);
+        for (auto& [name, trace] : loaded) {
+            traces[name] = move(trace);
+        }
+        return true;
+    }
+    bool PrefetchRecorder::Save(const wstring& filePath) const {
+        vector<std::byte> out;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+
+            Append(out, Header{ MAGIC, VERSION, traces.size() });
+            for (const auto& [name, trace] : traces) {
+                Append(out, static_cast<UINT32>(name.size()));
+                AppendString(out, name);
+                Append(out, static_cast<UINT32>(trace.size()));
+
+                for (const Access& access : trace) {
+                    Append(out, AccessRecord{ access.offset, access.offsetEnd, static_cast<UINT32>(access.path.size()), 0 });
+                    AppendString(out, access.path);
+                }
+            }
+        }
+
+        return FileManager::SaveFile(filePath, out);
+    }
+
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include "include.h"
+
+namespace FileManager {
+
+	// Learns what a scenario (a level, the main menu, ...) loads and in which order, so the next run can
+	//	prefetch it (FileManager::Prefetch) ahead of the loads instead of stalling on cold reads.
+	// While recording, every FileManager read is reported here : a file is kept once, at its first access,
+	//	with the ranges read merged. A new recording of a scenario replaces the previous one.
+	// Typical startup : Load, Replay(scenario), Begin(scenario), load as usual, End, Save.
+	class PrefetchRecorder {
+	public:
+		struct Access {
+			wstring path;
+			UINT64 offset = 0;
+			UINT64 offsetEnd = 0;
+		};
+
+		PrefetchRecorder() = default;
+		PrefetchRecorder(const PrefetchRecorder&) = delete;
+		PrefetchRecorder& operator=(const PrefetchRecorder&) = delete;
+		~PrefetchRecorder() { End(); CancelReplay(); }
+
+		// Starts reporting FileManager reads to this recorder, only one recorder records at a time
+		//	(another one recording stops receiving them, its End still keeps what it got)
+		void Begin(const wstring& scenario);
+		// Stops recording and keeps the trace as the one of the scenario.
+		//	Returns once no read is being reported to this recorder anymore (so the destructor can run).
+		void End();
+		bool IsRecording() const;
+
+		// Called by FileManager for every read while recording
+		void Record(const wstring& filePath, UINT64 offset, UINT64 size);
+
+		// Prefetches the trace of scenario, in order, on a background thread. False if the scenario is unknown.
+		bool Replay(const wstring& scenario);
+		// Stops a running replay (the prefetches already issued still complete)
+		void CancelReplay();
+
+		bool GetTrace(const wstring& scenario, vector<Access>& trace) const;
+
+		// A missing file isn't an error, there is just nothing to replay yet
+		bool Load(const wstring& filePath);
+		bool Save(const wstring& filePath) const;
+
+	private:
+		static constexpr UINT32 MAGIC = 0x5246504D;	// "MPFR"
+		static constexpr UINT32 VERSION = 1;
+
+		mutable std::mutex mtx;
+		bool recording = false;
+		wstring scenario;
+		vector<Access> current;
+		std::unordered_map<wstring, size_t> currentIndex;	// Path -> index in current
+		map<wstring, vector<Access>> traces;
+
+		std::jthread replayThread;
+	};
+
+}
@@ -0,0 +1,400 @@
+#include "VirtualFileSystem.h"
+#include "FileManager.h"
+#include <cstring>
+
+namespace FileManager {
+
+    VirtualPath VirtualPath::operator/(std::wstring_view child) const {
+        if (normalized.empty()) {
+            return VirtualPath(child);
+        }
+        if (child.empty()) {
+            return *this;
+        }
+        return VirtualPath(normalized + L'\\' + wstring(child));
+    }
+
+    VirtualFileSystem::~VirtualFileSystem() {
+        // The watchers are stopped before the tables they update go away
+        vector<std::unique_ptr<Mount>> removed;
+        {
+            std::unique_lock<std::shared_mutex> lock(mtx);
+            removed = move(mounts);
+            index.clear();
+        }
+    }
+
+    // Start : Mounts
+    VirtualFileSystem::MountId VirtualFileSystem::AddMount(std::unique_ptr<Mount> mount) {
+        std::unique_lock<std::shared_mutex> lock(mtx);
+        mount->id = nextId++;
+        for (auto& [path, source] : mount->files) {
+            source.mount = mount->id;
+            index.insert_or_assign(path, source);
+        }
+        mounts.push_back(move(mount));
+        return mounts.back()->id;
+    }
+
+    VirtualFileSystem::MountId VirtualFileSystem::MountDirectory(const VirtualPath& mountPoint, const wstring& directory, bool watch) {
+        if (!FileManager::DirectoryExists(directory)) [[unlikely]] {
+            LOG_WARNING(L"VirtualFileSystem - MountDirectory", L"(" + directory + L") Directory doesn't exist");
+            return INVALID_MOUNT;
+        }
+
+        std::unique_ptr<Mount> mount = std::make_unique<Mount>();
+        mount->type = MountType::Directory;
+        mount->mountPoint = mountPoint;
+        mount->directory = directory;
+        mount->files = ScanDirectory(INVALID_MOUNT, mountPoint, directory);
+
+        const MountId id = AddMount(move(mount));
+        if (!watch) {
+            return id;
+        }
+
+        // Started once mounted : the first events may already need the tables
+        std::unique_ptr<Watcher> watcher = std::make_unique<Watcher>();
+        if (!watcher->Start(directory, [this, id](const vector<ChangeEvent>& events) { OnChanges(id, events); })) [[unlikely]] {
+            LOG_WARNING(L"VirtualFileSystem - MountDirectory", L"(" + directory + L") Couldn't be watched, Rescan to see its changes");
+            return id;
+        }
+
+        std::unique_lock<std::shared_mutex> lock(mtx);
+        const size_t mountIndex = FindMount(id);
+        if (mountIndex < mounts.size()) {
+            mounts[mountIndex]->watcher = move(watcher);
+        }
+        return id;
+    }
+    VirtualFileSystem::MountId VirtualFileSystem::MountArchive(const VirtualPath& mountPoint, std::shared_ptr<const Archive> archive) {
+        if (!archive || !archive->IsOpen()) [[unlikely]] {
+            LOG_WARNING(L"VirtualFileSystem - MountArchive", L"(" + mountPoint.Get() + L") The archive isn't open");
+            return INVALID_MOUNT;
+        }
+
+        std::unique_ptr<Mount> mount = std::make_unique<Mount>();
+        mount->type = MountType::Archive;
+        mount->mountPoint = mountPoint;
+        mount->archive = archive;
+        mount->files.reserve(archive->GetEntryCount());
+
+        for (UINT32 i = 0; i < archive->GetEntryCount(); i++) {
+            Source source;
+            source.archive = archive;
+            source.entry = &archive->GetEntry(i);
+            source.size = source.entry->size;
+            mount->files.insert_or_assign(mountPoint / archive->GetEntryPath(i), move(source));
+        }
+
+        return AddMount(move(mount));
+    }
+    VirtualFileSystem::MountId VirtualFileSystem::MountMemory(const VirtualPath& mountPoint) {
+        std::unique_ptr<Mount> mount = std::make_unique<Mount>();
+        mount->type = MountType::Memory;
+        mount->mountPoint = mountPoint;
+        return AddMount(move(mount));
+    }
+
+    bool VirtualFileSystem::Unmount(MountId id) {
+        std::unique_ptr<Mount> removed;
+        {
+            std::unique_lock<std::shared_mutex> lock(mtx);
+            const size_t mountIndex = FindMount(id);
+            if (mountIndex == mounts.size()) {
+                return false;
+            }
+
+            removed = move(mounts[mountIndex]);
+            mounts.erase(mounts.begin() + mountIndex);
+            RebuildIndex();
+        }
+        // The watcher is stopped outside the lock : its callback may be waiting for it
+        return true;
+    }
+
+    bool VirtualFileSystem::Rescan(MountId id) {
+        VirtualPath mountPoint;
+        wstring directory;
+        {
+            std::shared_lock<std::shared_mutex> lock(mtx);
+            const size_t mountIndex = FindMount(id);
+            if (mountIndex == mounts.size() || mounts[mountIndex]->type != MountType::Directory) {
+                return false;
+            }
+            mountPoint = mounts[mountIndex]->mountPoint;
+            directory = mounts[mountIndex]->directory;
+        }
+
+        // Enumerated without the lock, lookups go on meanwhile
+        FileTable files = ScanDirectory(id, mountPoint, directory);
+
+        std::unique_lock<std::shared_mutex> lock(mtx);
+        const size_t mountIndex = FindMount(id);
+        if (mountIndex == mounts.size()) {
+            return false;
+        }
+        mounts[mountIndex]->files = move(files);
+        RebuildIndex();
+        return true;
+    }
+
+    bool VirtualFileSystem::SetMemoryFile(MountId id, std::wstring_view relativePath, vector<std::byte> data) {
+        std::unique_lock<std::shared_mutex> lock(mtx);
+        const size_t mountIndex = FindMount(id);
+        if (mountIndex == mounts.size() || mounts[mountIndex]->type != MountType::Memory) [[unlikely]] {
+            LOG_WARNING("VirtualFileSystem - SetMemoryFile", "Mount " + to_string(id) + " isn't a memory mount");
+            return false;
+        }
+
+        Source source;
+        source.size = data.size();
+        source.data = std::make_shared<const vector<std::byte>>(move(data));
+        AddFile(mountIndex, mounts[mountIndex]->mountPoint / relativePath, move(source));
+        return true;
+    }
+    bool VirtualFileSystem::RemoveMemoryFile(MountId id, std::wstring_view relativePath) {
+        std::unique_lock<std::shared_mutex> lock(mtx);
+        const size_t mountIndex = FindMount(id);
+        if (mountIndex == mounts.size() || mounts[mountIndex]->type != MountType::Memory) [[unlikely]] {
+            return false;
+        }
+
+        RemoveFile(mountIndex, mounts[mountIndex]->mountPoint / relativePath);
+        return true;
+    }
+
+    size_t VirtualFileSystem::FindMount(MountId id) const {
+        for (size_t i = 0; i < mounts.size(); i++) {
+            if (mounts[i]->id == id) {
+                return i;
+            }
+        }
+        return mounts.size();
+    }
+    // End : Mounts
+
+    // Start : Index
+    void VirtualFileSystem::RebuildIndex() {
+        index.clear();
+        for (const std::unique_ptr<Mount>& mount : mounts) {
+            for (const auto& [path, source] : mount->files) {
+                index.insert_or_assign(path, source);
+            }
+        }
+    }
+    void VirtualFileSystem::AddFile(size_t mountIndex, const VirtualPath& path, Source source) {
+        Mount& mount = *mounts[mountIndex];
+        source.mount = mount.id;
+
+        // Only takes over if no later mount has the path
+        auto winner = index.find(path);
+        if (winner == index.end() || FindMount(winner->second.mount) <= mountIndex) {
+            index.insert_or_assign(path, source);
+        }
+        mount.files.insert_or_assign(path, move(source));
+    }
+    void VirtualFileSystem::RemoveFile(size_t mountIndex, const VirtualPath& path) {
+        Mount& mount = *mounts[mountIndex];
+        if (mount.files.erase(path) == 0) {
+            return;
+        }
+
+        auto winner = index.find(path);
+        if (winner == index.end() || winner->second.mount != mount.id) {
+            return;
+        }
+
+        // Falls back to the earlier mounts
+        for (size_t i = mountIndex; i-- > 0;) {
+            auto it = mounts[i]->files.find(path);
+            if (it != mounts[i]->files.end()) {
+                winner->second = it->second;
+                return;
+            }
+        }
+        index.erase(winner);
+    }
+    const VirtualFileSystem::Source* VirtualFileSystem::Find(const VirtualPath& path) const {
+        auto it = index.find(path);
+        return it != index.end() ? &it->second : nullptr;
+    }
+    // End : Index
+
+    // Start : Directory mounts
+    VirtualFileSystem::FileTable VirtualFileSystem::ScanDirectory(MountId id, const VirtualPath& mountPoint, const wstring& directory) const {
+        DirectoryListing listing = FileManager::Enumerate(directory, true);
+
+        FileTable files;
+        files.reserve(listing.GetCount());
+        for (size_t i = 0; i < listing.GetCount(); i++) {
+            Source source;
+            source.mount = id;
+            source.size = listing.GetEntry(i).size;
+            source.diskPath = listing.GetFullPath(i);
+            files.insert_or_assign(mountPoint / listing.GetPath(i), move(source));
+        }
+        return files;
+    }
+    void VirtualFileSystem::OnChanges(MountId id, const vector<ChangeEvent>& events) {
+        wstring directory;
+        VirtualPath mountPoint;
+        {
+            std::shared_lock<std::shared_mutex> lock(mtx);
+            const size_t mountIndex = FindMount(id);
+            if (mountIndex == mounts.size()) {
+                return;
+            }
+            directory = mounts[mountIndex]->directory;
+            mountPoint = mounts[mountIndex]->mountPoint;
+        }
+
+        for (const ChangeEvent& event : events) {
+            // A directory appearing or a lost notification : its content is unknown, everything is listed again
+            if (event.action == ChangeAction::Rescan) {
+                Rescan(id);
+                return;
+            }
+
+            const VirtualPath path = mountPoint / event.path;
+            const wstring diskPath = directory + L"\\" + event.path;
+
+            if (event.action == ChangeAction::Removed) {
+                std::unique_lock<std::shared_mutex> lock(mtx);
+                const size_t mountIndex = FindMount(id);
+                if (mountIndex == mounts.size()) {
+                    return;
+                }
+                if (mounts[mountIndex]->files.contains(path)) {
+                    RemoveFile(mountIndex, path);
+                    continue;
+                }
+
+                // Not a file : a removed directory takes its files with it
+                const wstring prefix = path.Get() + L'\\';
+                vector<VirtualPath> removed;
+                for (const auto& [filePath, source] : mounts[mountIndex]->files) {
+                    if (filePath.Get().starts_with(prefix)) {
+                        removed.push_back(filePath);
+                    }
+                }
+                for (const VirtualPath& filePath : removed) {
+                    RemoveFile(mountIndex, filePath);
+                }
+                continue;
+            }
+
+            WIN32_FILE_ATTRIBUTE_DATA attributes;
+            if (!GetFileAttributesExW(diskPath.c_str(), GetFileExInfoStandard, &attributes)) {
+                continue;
+            }
+            if (attributes.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+                Rescan(id);
+                return;
+            }
+            if (attributes.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) {
+                // Not followed, like Enumerate
+                continue;
+            }
+
+            Source source;
+            source.size = (UINT64(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+            source.diskPath = diskPath;
+
+            std::unique_lock<std::shared_mutex> lock(mtx);
+            const size_t mountIndex = FindMount(id);
+            if (mountIndex == mounts.size()) {
+                return;
+            }
+            AddFile(mountIndex, path, move(source));
+        }
+    }
+    // End : Directory mounts
+
+    // Start : Lookups + Reads
+    bool VirtualFileSystem::Exists(const VirtualPath& path) const {
+        std::shared_lock<std::shared_mutex> lock(mtx);
+        return Find(path) != nullptr;
+    }
+    bool VirtualFileSystem::GetFileSize(const VirtualPath& path, UINT64& fileSize) const {
+        std::shared_lock<std::shared_mutex> lock(mtx);
+        const Source* source = Find(path);
+        if (!source) {
+            return false;
+        }
+        fileSize = source->size;
+        return true;
+    }
+    bool VirtualFileSystem::GetDiskPath(const VirtualPath& path, wstring& diskPath) const {
+        std::shared_lock<std::shared_mutex> lock(mtx);
+        const Source* source = Find(path);
+        if (!source || source->diskPath.empty()) {
+            return false;
+        }
+        diskPath = source->diskPath;
+        return true;
+    }
+    std::shared_ptr<const Archive> VirtualFileSystem::FindArchiveEntry(VirtualPath::View path, const Archive::Entry*& entry) const {
+        std::shared_lock<std::shared_mutex> lock(mtx);
+        auto it = index.find(path);
+        if (it == index.end() || !it->second.archive) {
+            return nullptr;
+        }
+        entry = it->second.entry;
+        return it->second.archive;
+    }
+    size_t VirtualFileSystem::GetFileCount() const {
+        std::shared_lock<std::shared_mutex> lock(mtx);
+        return index.size();
+    }
+
+    bool VirtualFileSystem::ReadFile(const VirtualPath& path, std::span<std::byte> buffer, UINT64 offset) const {
+        std::shared_lock<std::shared_mutex> lock(mtx);
+        const Source* source = Find(path);
+        if (!source) [[unlikely]] {
+            LOG_WARNING(L"VirtualFileSystem - ReadFile", L"(" + path.Get() + L") File doesn't exist");
+            return false;
+        }
+
+        if (source->archive) {
+            return source->archive->Read(*source->entry, buffer, offset);
+        }
+        if (!source->data) {
+            // The disk is the reference for the size, the index may be behind it
+            return FileManager::ReadFile(source->diskPath, buffer, offset);
+        }
+
+        if (offset > source->size || buffer.size() > source->size - offset) [[unlikely]] {
+            LOG_WARNING("VirtualFileSystem - ReadFile", "Reading past the end of the file : "
+                + to_string(offset) + " + " + to_string(buffer.size()) + " > " + to_string(source->size));
+            return false;
+        }
+        if (!buffer.empty()) {
+            std::memcpy(buffer.data(), source->data->data() + offset, buffer.size());
+        }
+        return true;
+    }
+    bool VirtualFileSystem::ReadFile(const VirtualPath& path, BufferLease& lease) const {
+        std::shared_lock<std::shared_mutex> lock(mtx);
+        const Source* source = Find(path);
+        if (!source) [[unlikely]] {
+            LOG_WARNING(L"VirtualFileSystem - ReadFile", L"(" + path.Get() + L") File doesn't exist");
+            return false;
+        }
+
+        if (!source->data && !source->archive) {
+            return FileManager::ReadFile(source->diskPath, lease);
+        }
+
+        lease = BufferPool::Acquire(static_cast<size_t>(source->size));
+        if (source->archive) {
+            return source->archive->Read(*source->entry, lease.GetSpan());
+        }
+        if (source->size != 0) {
+            std::memcpy(lease.GetData(), source->data->data(), static_cast<size_t>(source->size));
+        }
+        return true;
+    }
+    // End : Lookups + Reads
+
+}
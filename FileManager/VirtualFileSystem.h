@@ -0,0 +1,135 @@
+#pragma once
+#include "include.h"
+#include "Archive.h"
+#include "BufferPool.h"
+#include "Watcher.h"
+#include <shared_mutex>
+
+namespace FileManager {
+
+	// A path normalized (Archive::NormalizePath) and hashed once, to be kept and reused for lookups
+	class VirtualPath {
+	public:
+		// A normalized path that isn't owned (a stack buffer, ...) : looked up without building a VirtualPath
+		struct View {
+			std::wstring_view normalized;
+			UINT64 hash = 0;
+
+			explicit View(std::wstring_view normalizedPath) : normalized(normalizedPath), hash(Archive::HashPath(normalizedPath)) {}
+		};
+		struct Hash {
+			using is_transparent = void;
+			size_t operator()(const VirtualPath& path) const { return static_cast<size_t>(path.hash); }
+			size_t operator()(const View& path) const { return static_cast<size_t>(path.hash); }
+		};
+
+		VirtualPath() = default;
+		VirtualPath(std::wstring_view path) : normalized(Archive::NormalizePath(path)), hash(Archive::HashPath(normalized)) {}
+		VirtualPath(const wstring& path) : VirtualPath(std::wstring_view(path)) {}
+		VirtualPath(const wchar_t* path) : VirtualPath(std::wstring_view(path)) {}
+
+		// Child path, instead of concatenating separators by hand
+		VirtualPath operator/(std::wstring_view child) const;
+
+		const wstring& Get() const { return normalized; }
+		UINT64 GetHash() const { return hash; }
+		bool IsEmpty() const { return normalized.empty(); }
+
+		bool operator==(const VirtualPath& other) const { return hash == other.hash && normalized == other.normalized; }
+		bool operator==(const View& other) const { return hash == other.hash && normalized == other.normalized; }
+
+	private:
+		wstring normalized;
+		UINT64 hash = 0;
+	};
+
+	// Virtual paths over ordered mount points : disk directories, packed archives and in-memory overlays.
+	// Every mount is indexed when it is mounted (a directory is enumerated once), the winning source of each path
+	//	is kept in one hash table : resolving a path is a lookup, never a chain of OS probes.
+	// A later mount overlays the earlier ones, so a patch (directory, archive or memory) replaces files without copying them.
+	// A directory mount only sees the changes made after it was mounted if it is watched (see Watcher) or rescanned.
+	class VirtualFileSystem {
+	public:
+		using MountId = UINT32;
+		static constexpr MountId INVALID_MOUNT = 0;
+
+		VirtualFileSystem() = default;
+		VirtualFileSystem(const VirtualFileSystem&) = delete;
+		VirtualFileSystem& operator=(const VirtualFileSystem&) = delete;
+		~VirtualFileSystem();
+
+		// INVALID_MOUNT on failure
+		MountId MountDirectory(const VirtualPath& mountPoint, const wstring& directory, bool watch = false);
+		MountId MountArchive(const VirtualPath& mountPoint, std::shared_ptr<const Archive> archive);
+		MountId MountMemory(const VirtualPath& mountPoint);
+		bool Unmount(MountId id);
+
+		// Enumerates a directory mount again
+		bool Rescan(MountId id);
+		// Adds or replaces a file of a memory mount (relativePath is relative to its mount point)
+		bool SetMemoryFile(MountId id, std::wstring_view relativePath, vector<std::byte> data);
+		bool RemoveMemoryFile(MountId id, std::wstring_view relativePath);
+
+		bool Exists(const VirtualPath& path) const;
+		bool GetFileSize(const VirtualPath& path, UINT64& fileSize) const;
+		// Disk path behind path, false if it isn't a file of a directory mount
+		bool GetDiskPath(const VirtualPath& path, wstring& diskPath) const;
+		// Archive holding path (entry set), nullptr if it isn't a file of an archive mount
+		std::shared_ptr<const Archive> FindArchiveEntry(VirtualPath::View path, const Archive::Entry*& entry) const;
+		size_t GetFileCount() const;
+
+		// Reads run under the shared lock (the source isn't copied) : a mount change waits for the reads in flight.
+		// Exactly buffer.size() bytes at offset
+		bool ReadFile(const VirtualPath& path, std::span<std::byte> buffer, UINT64 offset = 0) const;
+		// The whole file, in a pooled buffer (see BufferPool)
+		bool ReadFile(const VirtualPath& path, BufferLease& lease) const;
+
+	private:
+		enum class MountType {
+			Directory,
+			Archive,
+			Memory,
+		};
+
+		// Where the bytes of a path are
+		struct Source {
+			MountId mount = INVALID_MOUNT;
+			UINT64 size = 0;
+			wstring diskPath;								// Directory
+			std::shared_ptr<const Archive> archive;			// Archive
+			const Archive::Entry* entry = nullptr;
+			std::shared_ptr<const vector<std::byte>> data;	// Memory
+		};
+		using FileTable = std::unordered_map<VirtualPath, Source, VirtualPath::Hash, std::equal_to<>>;
+
+		struct Mount {
+			MountId id = INVALID_MOUNT;
+			MountType type = MountType::Directory;
+			VirtualPath mountPoint;
+			wstring directory;
+			std::shared_ptr<const Archive> archive;
+			FileTable files;
+			std::unique_ptr<Watcher> watcher;
+		};
+
+		MountId AddMount(std::unique_ptr<Mount> mount);
+		// Index in mounts (its priority), mounts.size() if unmounted (mtx must be held)
+		size_t FindMount(MountId id) const;
+		// Start : mtx must be held
+		void RebuildIndex();
+		void AddFile(size_t mountIndex, const VirtualPath& path, Source source);
+		void RemoveFile(size_t mountIndex, const VirtualPath& path);
+		// Winning source of path, nullptr if none
+		const Source* Find(const VirtualPath& path) const;
+		// End : mtx must be held
+
+		FileTable ScanDirectory(MountId id, const VirtualPath& mountPoint, const wstring& directory) const;
+		void OnChanges(MountId id, const vector<ChangeEvent>& events);
+
+		mutable std::shared_mutex mtx;
+		vector<std::unique_ptr<Mount>> mounts;	// Searched from the back
+		FileTable index;						// Winning source of every path
+		MountId nextId = 1;
+	};
+
+}
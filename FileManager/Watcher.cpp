@@ -0,0 +1,229 @@
+#include "Watcher.h"
+#include "FileManager.h"
+#include <climits>
+
+namespace FileManager {
+
+    bool Watcher::Start(const wstring& dirPath, Callback newCallback, bool watchSubtree, DWORD debounce) {
+        if (IsRunning()) {
+            LOG_WARNING(L"Watcher - Start", L"Already watching (" + root + L"), call Stop first");
+            return false;
+        }
+        if (!newCallback) {
+            LOG_WARNING("Watcher - Start", "The callback is empty");
+            return false;
+        }
+
+        root = dirPath;
+        while (!root.empty() && root.back() == L'\\') {
+            root.pop_back();
+        }
+        callback = move(newCallback);
+        recursive = watchSubtree;
+        debounceMs = debounce;
+
+        // Start : Get HANDLE
+        hDirectory = CreateFileW(
+            root.c_str(),
+            FILE_LIST_DIRECTORY,
+            FILE_SHARE_DELETE | FILE_SHARE_READ | FILE_SHARE_WRITE,
+            nullptr,
+            OPEN_EXISTING,
+            FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
+            nullptr
+        );
+
+        if (hDirectory == INVALID_HANDLE_VALUE) {
+            LOG_ERROR(L"Watcher - Start", L"Couldn't open the directory (" + root + L")");
+            return false;
+        }
+        // End : Get HANDLE
+
+        hChangeEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        hStopEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        buffer = std::make_unique<DWORD[]>(BUFFER_SIZE / sizeof(DWORD));
+
+        if (!hChangeEvent || !hStopEvent || !IssueRead()) {
+            LOG_ERROR(L"Watcher - Start", L"Couldn't start watching (" + root + L")");
+            Stop();
+            return false;
+        }
+
+        thread = std::jthread(&Watcher::Worker, this);
+        return true;
+    }
+    void Watcher::Stop() {
+        if (hStopEvent) {
+            SetEvent(hStopEvent);
+        }
+        if (thread.joinable()) {
+            thread.join();
+        }
+
+        if (hDirectory != INVALID_HANDLE_VALUE) {
+            // Wait for the pending read to be cancelled, it writes into buffer and overlapped
+            if (CancelIoEx(hDirectory, &overlapped) || GetLastError() != ERROR_NOT_FOUND) {
+                DWORD bytes = 0;
+                GetOverlappedResult(hDirectory, &overlapped, &bytes, TRUE);
+            }
+            CloseHandle(hDirectory);
+            hDirectory = INVALID_HANDLE_VALUE;
+        }
+        if (hChangeEvent) {
+            CloseHandle(hChangeEvent);
+            hChangeEvent = nullptr;
+        }
+        if (hStopEvent) {
+            CloseHandle(hStopEvent);
+            hStopEvent = nullptr;
+        }
+
+        pending.clear();
+        ready.clear();
+    }
+
+    bool Watcher::IssueRead() {
+        overlapped = {};
+        overlapped.hEvent = hChangeEvent;
+        ResetEvent(hChangeEvent);
+
+        return ReadDirectoryChangesW(hDirectory, buffer.get(), BUFFER_SIZE, recursive, NOTIFY_FILTER, nullptr, &overlapped, nullptr);
+    }
+
+    void Watcher::Worker() {
+        const HANDLE handles[2] = { hStopEvent, hChangeEvent };
+        DWORD timeout = INFINITE;
+
+        while (true) {
+            DWORD wait = WaitForMultipleObjects(2, handles, FALSE, timeout);
+            ULONGLONG now = GetTickCount64();
+
+            if (wait == WAIT_OBJECT_0) {
+                return;
+            }
+            if (wait == WAIT_OBJECT_0 + 1) {
+                DWORD bytes = 0;
+                if (GetOverlappedResult(hDirectory, &overlapped, &bytes, FALSE)) [[likely]] {
+                    // 0 bytes : the notifications didn't fit in the buffer
+                    if (bytes == 0) {
+                        Coalesce(wstring(), ChangeAction::Rescan, now);
+                    }
+                    else {
+                        Parse(bytes, now);
+                    }
+                }
+                else if (GetLastError() == ERROR_NOTIFY_ENUM_DIR) {
+                    Coalesce(wstring(), ChangeAction::Rescan, now);
+                }
+                else [[unlikely]] {
+                    LOG_ERROR(L"Watcher - Worker", L"Watching (" + root + L") failed, the directory was probably removed");
+                    return;
+                }
+
+                if (!IssueRead()) [[unlikely]] {
+                    LOG_ERROR(L"Watcher - Worker", L"Couldn't keep watching (" + root + L")");
+                    return;
+                }
+            }
+            else if (wait != WAIT_TIMEOUT) [[unlikely]] {
+                LOG_ERROR("Watcher - Worker", "WaitForMultipleObjects failed");
+                return;
+            }
+
+            timeout = Flush(now);
+        }
+    }
+
+    void Watcher::Parse(DWORD bytes, ULONGLONG now) {
+        const BYTE* cursor = reinterpret_cast<const BYTE*>(buffer.get());
+        const BYTE* end = cursor + bytes;
+
+        while (cursor < end) {
+            const FILE_NOTIFY_INFORMATION* info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(cursor);
+            wstring path(info->FileName, info->FileNameLength / sizeof(WCHAR));
+
+            switch (info->Action) {
+            case FILE_ACTION_ADDED:
+            case FILE_ACTION_RENAMED_NEW_NAME:
+                Coalesce(move(path), ChangeAction::Added, now);
+                break;
+            case FILE_ACTION_REMOVED:
+            case FILE_ACTION_RENAMED_OLD_NAME:
+                Coalesce(move(path), ChangeAction::Removed, now);
+                break;
+            case FILE_ACTION_MODIFIED:
+                Coalesce(move(path), ChangeAction::Modified, now);
+                break;
+            }
+
+            if (info->NextEntryOffset == 0) {
+                break;
+            }
+            cursor += info->NextEntryOffset;
+        }
+    }
+
+    void Watcher::Coalesce(wstring&& path, ChangeAction action, ULONGLONG now) {
+        auto [it, inserted] = pending.try_emplace(move(path), Pending{ action, now });
+        if (inserted) {
+            return;
+        }
+
+        Pending& previous = it->second;
+        previous.lastSeen = now;
+
+        switch (previous.action) {
+        case ChangeAction::Added:
+            // Created then deleted within the quiet period (temp file) : nothing happened
+            if (action == ChangeAction::Removed) {
+                pending.erase(it);
+            }
+            break;
+        case ChangeAction::Removed:
+            // Deleted then recreated (save by replace) : the content changed
+            if (action == ChangeAction::Added || action == ChangeAction::Modified) {
+                previous.action = ChangeAction::Modified;
+            }
+            break;
+        case ChangeAction::Modified:
+            if (action == ChangeAction::Removed) {
+                previous.action = ChangeAction::Removed;
+            }
+            break;
+        case ChangeAction::Rescan:
+            break;
+        }
+    }
+
+    DWORD Watcher::Flush(ULONGLONG now) {
+        ULONGLONG nextDeadline = ULLONG_MAX;
+
+        for (auto it = pending.begin(); it != pending.end();) {
+            ULONGLONG deadline = it->second.lastSeen + debounceMs;
+
+            if (deadline <= now) {
+                if (it->first.empty()) {
+                    // Rescan : any file under root may have changed
+                    FileManager::InvalidateHandlesUnder(root);
+                }
+                else {
+                    FileManager::InvalidateHandle(root + L"\\" + it->first);
+                }
+                ready.push_back({ it->first, it->second.action });
+                it = pending.erase(it);
+            }
+            else {
+                nextDeadline = std::min(nextDeadline, deadline);
+                ++it;
+            }
+        }
+
+        if (!ready.empty()) {
+            callback(ready);
+            ready.clear();
+        }
+
+        return nextDeadline == ULLONG_MAX ? INFINITE : static_cast<DWORD>(nextDeadline - now);
+    }
+
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include "include.h"
+#include <functional>
+
+namespace FileManager {
+	enum class ChangeAction {
+		Added,
+		Removed,
+		Modified,
+		Rescan,		// Too many changes at once (notification buffer overflow), the path is empty : rescan the tree
+	};
+
+	struct ChangeEvent {
+		wstring path;	// Relative to the watched directory
+		ChangeAction action;
+	};
+
+	// Watches a directory tree on a background thread (ReadDirectoryChangesW + overlapped completion).
+	// Notifications are coalesced per path and only delivered once the path has been quiet for debounceMs,
+	//	so an editor saving in several steps (write temp, delete, rename, touch) gives a single event.
+	// Renames are reported as Removed (old name) + Added (new name) and coalesce the same way.
+	// Delivered paths are also invalidated in the FileManager handle cache (a Rescan invalidates every file under the root).
+	class Watcher {
+	public:
+		static constexpr DWORD DEFAULT_DEBOUNCE_MS = 100;
+
+		// Called on the watcher thread with every event whose quiet period ended
+		using Callback = std::function<void(const vector<ChangeEvent>& events)>;
+
+		Watcher() = default;
+		Watcher(const Watcher&) = delete;
+		Watcher& operator=(const Watcher&) = delete;
+		~Watcher() { Stop(); }
+
+		bool Start(const wstring& dirPath, Callback callback, bool recursive = true, DWORD debounceMs = DEFAULT_DEBOUNCE_MS);
+		void Stop();
+		bool IsRunning() const { return thread.joinable(); }
+
+	private:
+		static constexpr DWORD BUFFER_SIZE = 64 * 1024;		// Max size accepted over the network
+		static constexpr DWORD NOTIFY_FILTER = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME |
+			FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_CREATION;
+
+		struct Pending {
+			ChangeAction action;
+			ULONGLONG lastSeen;
+		};
+
+		void Worker();
+		bool IssueRead();
+		void Parse(DWORD bytes, ULONGLONG now);
+		void Coalesce(wstring&& path, ChangeAction action, ULONGLONG now);
+		// Delivers the events quiet since debounceMs, returns the time to wait for the next one (INFINITE if none)
+		DWORD Flush(ULONGLONG now);
+
+		wstring root;
+		Callback callback;
+		bool recursive = true;
+		DWORD debounceMs = DEFAULT_DEBOUNCE_MS;
+
+		HANDLE hDirectory = INVALID_HANDLE_VALUE;
+		HANDLE hChangeEvent = nullptr;
+		HANDLE hStopEvent = nullptr;
+		OVERLAPPED overlapped = {};
+		std::unique_ptr<DWORD[]> buffer;	// DWORD aligned as ReadDirectoryChangesW needs
+
+		std::unordered_map<wstring, Pending> pending;	// Only touched by the watcher thread
+		vector<ChangeEvent> ready;
+		std::jthread thread;
+	};
+
+}
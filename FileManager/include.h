@@ -1,4 +1,8 @@
 #pragma once
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+
 #include <Windows.h>
 #include <string>
 #include <map>
@@ -8,6 +12,19 @@
 #include <concepts>
 #include <stdexcept>
 #include <vector>
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+#include <string_view>
+#include <cwctype>
+#include <algorithm>
+#include <span>
+#include <array>
+#include <cstddef>
 
 
 
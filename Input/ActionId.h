@@ -0,0 +1,46 @@
+#pragma once
+#include "include.h"
+
+namespace Input {
+    // Interned name of an action, an axis or a mouse action : the 64-bit FNV-1a hash of the name.
+    //	A literal is hashed when compiling (MapAction("Jump", ...), "Jump"_action), so mapping, context switches
+    //	and evaluation only compare integers. Two names with the same hash are the same action.
+    class ActionId {
+    public:
+        constexpr ActionId() = default;
+        // Literal : hashed when compiling
+        template<size_t N>
+        consteval ActionId(const char (&name)[N]) : value(Hash(std::string_view(name, N - 1))) {}
+
+        // Name only known at runtime (tooling, config files, ...)
+        static constexpr ActionId FromName(std::string_view name) {
+            ActionId id;
+            id.value = Hash(name);
+            return id;
+        }
+
+        static constexpr UINT64 Hash(std::string_view name) {
+            UINT64 hash = 14695981039346656037ull;
+            for (char c : name) {
+                hash ^= static_cast<UINT8>(c);
+                hash *= 1099511628211ull;
+            }
+            return hash;
+        }
+
+        constexpr UINT64 GetValue() const { return value; }
+        constexpr bool operator==(const ActionId&) const = default;
+
+        // Already a hash
+        struct Hasher {
+            size_t operator()(ActionId id) const { return static_cast<size_t>(id.value); }
+        };
+
+    private:
+        UINT64 value = 0;
+    };
+
+    consteval ActionId operator""_action(const char* name, size_t length) {
+        return ActionId::FromName(std::string_view(name, length));
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include "include.h"
+
+namespace Input {
+    // What the window thread saw, stamped when it saw it
+    struct InputEvent {
+        enum class Type : UINT8 {
+            KeyDown,
+            KeyUp,
+            MouseMove,
+            MouseWheel,
+        };
+
+        Type type;
+        UINT8 key = 0;      // KeyDown / KeyUp : virtual-key code
+        INT32 x = 0;        // MouseMove : position, MouseWheel : delta in x
+        INT32 y = 0;
+        INT64 time = 0;     // QueryPerformanceCounter ticks
+    };
+
+    // Lock-free ring between exactly one producer thread (Push) and one consumer thread (Front / Pop).
+    // Each side keeps a copy of the other side's index and only reloads it when the ring looks full / empty,
+    //	so the shared cache lines move between the threads once per burst, not once per item.
+    template<typename T, size_t Capacity>
+    class SpscQueue {
+        static_assert(std::has_single_bit(Capacity), "Capacity must be a power of 2");
+
+    public:
+        // Producer : false if the ring is full (the item is dropped)
+        bool Push(const T& item) {
+            const size_t tailIndex = tail.load(std::memory_order_relaxed);
+            if (tailIndex - cachedHead == Capacity) {
+                cachedHead = head.load(std::memory_order_acquire);
+                if (tailIndex - cachedHead == Capacity) [[unlikely]] {
+                    return false;
+                }
+            }
+
+            items[tailIndex & (Capacity - 1)] = item;
+            tail.store(tailIndex + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Consumer : oldest item, nullptr if empty. It stays valid until Pop.
+        const T* Front() {
+            const size_t headIndex = head.load(std::memory_order_relaxed);
+            if (headIndex == cachedTail) {
+                cachedTail = tail.load(std::memory_order_acquire);
+                if (headIndex == cachedTail) {
+                    return nullptr;
+                }
+            }
+            return &items[headIndex & (Capacity - 1)];
+        }
+        // Consumer : only after a Front that returned an item
+        void Pop() {
+            head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+    private:
+        // Start : Consumer side
+        alignas(64) std::atomic<size_t> head = 0;
+        size_t cachedTail = 0;
+        // End : Consumer side
+
+        // Start : Producer side
+        alignas(64) std::atomic<size_t> tail = 0;
+        size_t cachedHead = 0;
+        // End : Producer side
+
+        alignas(64) std::array<T, Capacity> items;
+    };
+}
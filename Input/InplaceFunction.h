@@ -0,0 +1,105 @@
+#pragma once
+#include "include.h"
+
+namespace Input {
+    template<typename Signature, size_t Capacity>
+    class InplaceFunction;
+
+    // std::function without the heap : the callable lives inside, so it has to fit in Capacity bytes
+    //	(checked when compiling, capture less or by reference if it doesn't). Copying copies the callable.
+    template<typename R, typename... Args, size_t Capacity>
+    class InplaceFunction<R(Args...), Capacity> {
+    public:
+        InplaceFunction() = default;
+        InplaceFunction(std::nullptr_t) {}
+
+        template<typename F>
+            requires (!std::same_as<std::remove_cvref_t<F>, InplaceFunction> && std::is_invocable_r_v<R, std::decay_t<F>&, Args...>)
+        InplaceFunction(F&& callable) {
+            using Callable = std::decay_t<F>;
+            static_assert(sizeof(Callable) <= Capacity, "The callable doesn't fit in the InplaceFunction");
+            static_assert(alignof(Callable) <= alignof(std::max_align_t), "The callable is over-aligned");
+            static_assert(std::is_copy_constructible_v<Callable>, "The callable can't be copied");
+
+            // An empty std::function or a null function pointer stays empty
+            if constexpr (requires { static_cast<bool>(callable); }) {
+                if (!static_cast<bool>(callable)) {
+                    return;
+                }
+            }
+
+            new (storage) Callable(std::forward<F>(callable));
+            operations = &OPERATIONS<Callable>;
+        }
+
+        InplaceFunction(const InplaceFunction& other) {
+            if (other.operations) {
+                other.operations->copy(storage, other.storage);
+                operations = other.operations;
+            }
+        }
+        InplaceFunction(InplaceFunction&& other) noexcept {
+            if (other.operations) {
+                other.operations->move(storage, other.storage);
+                operations = other.operations;
+                other.Reset();
+            }
+        }
+        InplaceFunction& operator=(const InplaceFunction& other) {
+            if (this != &other) {
+                Reset();
+                if (other.operations) {
+                    other.operations->copy(storage, other.storage);
+                    operations = other.operations;
+                }
+            }
+            return *this;
+        }
+        InplaceFunction& operator=(InplaceFunction&& other) noexcept {
+            if (this != &other) {
+                Reset();
+                if (other.operations) {
+                    other.operations->move(storage, other.storage);
+                    operations = other.operations;
+                    other.Reset();
+                }
+            }
+            return *this;
+        }
+        ~InplaceFunction() { Reset(); }
+
+        // Only when not empty
+        R operator()(Args... args) const {
+            assert(operations && "Calling an empty InplaceFunction");
+            return operations->invoke(storage, std::forward<Args>(args)...);
+        }
+        explicit operator bool() const { return operations != nullptr; }
+
+        void Reset() {
+            if (operations) {
+                operations->destroy(storage);
+                operations = nullptr;
+            }
+        }
+
+    private:
+        struct Operations {
+            R(*invoke)(void* callable, Args&&... args);
+            void(*copy)(void* destination, const void* source);
+            void(*move)(void* destination, void* source);
+            void(*destroy)(void* callable);
+        };
+
+        template<typename Callable>
+        static constexpr Operations OPERATIONS = {
+            [](void* callable, Args&&... args) -> R { return std::invoke(*static_cast<Callable*>(callable), std::forward<Args>(args)...); },
+            [](void* destination, const void* source) { new (destination) Callable(*static_cast<const Callable*>(source)); },
+            [](void* destination, void* source) { new (destination) Callable(std::move(*static_cast<Callable*>(source))); },
+            [](void* callable) { static_cast<Callable*>(callable)->~Callable(); },
+        };
+
+        // mutable : like std::function, a const InplaceFunction calls a callable that can change its captures
+        alignas(std::max_align_t) mutable std::byte storage[Capacity];
+        const Operations* operations = nullptr;
+    };
+}
@@ -1,4 +1,5 @@
 #include "Input.h"
+#include "InputRecorder.h"
 #include "..\LogManager\LogManager.h"
 
 
@@ -10,32 +11,56 @@ using std::to_wstring;
 using std::move;
 
 namespace Input {
+
+    namespace {
+        // Slot of id in slots (mapped or not), nullptr if it never was
+        template<typename Slot>
+        Slot* FindSlot(std::deque<Slot>& slots, ActionId id) {
+            for (Slot& slot : slots) {
+                if (slot.id == id) {
+                    return &slot;
+                }
+            }
+            return nullptr;
+        }
+    }
+
     Input::~Input() {
         if (mouseLocked) {
             SetMouseLocked(false);
         }
         axes.clear();
-        actions.clear();
-        keyStates.clear();
+        actionSlots.clear();
     }
 
     void Input::Update(const FLOAT deltaTime) {
-        UpdateKeyStates(deltaTime);
-        ProcessActions(deltaTime);
+        const INT64 now = Now();
+        // Before consuming : the move SetCursorPos causes comes after now
+        UpdateCursor(now);
+        // Also moved by RecenterMouse / SetMouseLocked, called by the application whenever
+        if (replay) {
+            mouseAnchorPending = replay->mouseAnchorPending;
+            mouseAnchorTime = replay->mouseAnchorTime;
+        }
+        const bool anchorPending = mouseAnchorPending;
+        const INT64 anchorTime = mouseAnchorTime;
+
+        smoothedDeltaX = 0.0f;
+        smoothedDeltaY = 0.0f;
+        const INT64 stateTime = ConsumeEvents(now);
+        UpdateKeyStates(stateTime);
+        dispatching = true;
+        ProcessActions(stateTime);
         UpdateMouseDelta();
         ProcessMouseActions();
         ProcessAxes(deltaTime);
+        dispatching = false;
+        ApplyDeferredBindings();
 
-        if (mouseLocked) {
-            POINT currentPos;
-            GetCursorPos(&currentPos);
-
-            int distanceFromCenter = abs(currentPos.x - windowCenter.x) + abs(currentPos.y - windowCenter.y);
-
-            if (distanceFromCenter > 100) {
-                centerNextFrame = true;
-                SetCursorPos(windowCenter.x, windowCenter.y);
-            }
+        if (recorder) {
+            // stateTime != now : the consumption stopped on an event left for the next Update
+            recorder->RecordFrame(deltaTime, now, cursorPos, stateTime != now, anchorPending, anchorTime, mouseInWindow, recordedEvents);
+            recordedEvents.clear();
         }
 
         mouseWheelDelta = 0;
@@ -43,69 +68,176 @@ namespace Input {
 
 
     // Keyboard (mostly)
-    void Input::MapAction(const std::string& actionName, const vector<Key>& keys, std::function<void()> callback, KeyAction execution, BOOL conflict) {
-        actions[actionName] = { keys, callback, execution, conflict };
-        for (Key key : keys) {
-            keyStates[key].state = KeyState::State::Released;
+    void Input::MapAction(ActionId action, Key key, Callback callback, KeyAction execution, BOOL conflict) {
+        MapAction(action, std::span<const Key>(&key, 1), move(callback), execution, conflict);
+    }
+    void Input::MapAction(ActionId action, std::span<const Key> keys, Callback callback, KeyAction execution, BOOL conflict) {
+        if (dispatching) {
+            SkipDispatch(action);
+            deferredBindings.push_back([this, action, keys = vector<Key>(keys.begin(), keys.end()), callback = move(callback), execution, conflict]() mutable {
+                MapAction(action, keys, move(callback), execution, conflict);
+            });
+            return;
+        }
+
+        InputAction* bound = FindAction(action);
+        if (!bound) {
+            actionIndex.emplace(action, static_cast<UINT32>(actionSlots.size()));
+            bound = &actionSlots.emplace_back();
+        }
+        else if (bound->mapped) {
+            UnbindAction(*bound);
+        }
+
+        bound->keys.assign(keys.begin(), keys.end());
+        bound->callback = move(callback);
+        bound->execution = execution;
+        bound->needsConflictResolution = conflict;
+        bound->executed = false;
+        bound->mapped = true;
+
+        for (Key key : bound->keys) {
+            TrackKey(key);
+
+            vector<InputAction*>& keyAction = keyActions[static_cast<size_t>(key)];
+            if (std::find(keyAction.begin(), keyAction.end(), bound) == keyAction.end()) {
+                keyAction.push_back(bound);
+            }
+        }
+    }
+    void Input::UnmapAction(ActionId action) {
+        if (dispatching) {
+            SkipDispatch(action);
+            deferredBindings.push_back([this, action] { UnmapAction(action); });
+            return;
+        }
+
+        InputAction* bound = FindAction(action);
+        if (!bound || !bound->mapped) {
+            return;
         }
+        UnbindAction(*bound);
+
+        // The slot stays for the next MapAction of this id
+        bound->mapped = false;
+        bound->callback.Reset();
+        bound->keys.clear();
     }
-    void Input::MapAction(const std::string& actionName, Key key, std::function<void()> callback, KeyAction execution, BOOL conflict) {
-        actions[actionName] = { {key}, callback, execution, conflict };
-        keyStates[key].state = KeyState::State::Released;
+    bool Input::IsActionMapped(ActionId action) const {
+        auto it = actionIndex.find(action);
+        return it != actionIndex.end() && actionSlots[it->second].mapped;
     }
-    void Input::UnmapAction(const std::string& actionName) {
-        actions.erase(actionName);
+    Input::InputAction* Input::FindAction(ActionId action) {
+        auto it = actionIndex.find(action);
+        return it != actionIndex.end() ? &actionSlots[it->second] : nullptr;
+    }
+    void Input::UnbindAction(InputAction& action) {
+        for (Key key : action.keys) {
+            std::erase(keyActions[static_cast<size_t>(key)], &action);
+        }
+
+        // Nothing may call its callback anymore
+        std::erase_if(pendingCallback, [&](const PendingCallback& pending) { return pending.action == &action; });
+    }
+    void Input::SkipDispatch(ActionId action) {
+        const InputAction* bound = FindAction(action);
+        if (!bound) {
+            return;
+        }
+        for (const Callback*& callback : dispatchList) {
+            if (callback == &bound->callback) {
+                callback = nullptr;
+            }
+        }
+    }
+    void Input::ApplyDeferredBindings() {
+        // Not dispatching anymore : each one applies right away
+        for (std::function<void()>& binding : deferredBindings) {
+            binding();
+        }
+        deferredBindings.clear();
     }
 
     bool Input::IsKeyHeld(Key key) const {
-        auto it = keyStates.find(key);
-        return it != keyStates.end() && it->second.state == KeyState::State::Held;
+        return keyHeld.Test(key);
     }
     bool Input::IsKeyPressed(Key key) const {
-        auto it = keyStates.find(key);
-        return it != keyStates.end() && it->second.state == KeyState::State::Pressed;
+        return keyPressed.Test(key);
     }
     bool Input::IsKeyDoublePressed(Key key) const {
-        auto it = keyStates.find(key);
-        return it != keyStates.end() && it->second.state == KeyState::State::DoublePressed;
+        return keyDoublePressed.Test(key);
+    }
+    bool Input::IsKeyDown(Key key) const {
+        return keyDown.Test(key);
     }
 
-    void Input::OnKeyDown(WPARAM key) {
-        Key keyEnum = static_cast<Key>(key);
-        if (keyStates.find(keyEnum) != keyStates.end()) {
-            if (keyStates[keyEnum].state == KeyState::State::Released) keyStates[keyEnum].state = KeyState::State::Pressed;
-            else if (keyStates[keyEnum].state == KeyState::State::Cooldown) {
-                keyStates[keyEnum].state = KeyState::State::DoublePressed;
-                keyStates[keyEnum].timer = 0.f;
-            }
+    void Input::TrackKey(Key key) {
+        // The actions of a down key see it released on the next frame
+        if (keyDown.Test(key)) {
+            keyChanged.Set(key);
         }
+        keyTracked.Set(key);
+        keyPressed.Reset(key);
+        keyDoublePressed.Reset(key);
+        keyHeld.Reset(key);
+        keyCooldown.Reset(key);
+        keyDown.Reset(key);
     }
-    void Input::OnKeyUp(WPARAM key) {
-        Key keyEnum = static_cast<Key>(key);
-        if (keyStates.find(keyEnum) != keyStates.end()) {
-            if (keyStates[keyEnum].state == KeyState::State::Pressed) {
-                keyStates[keyEnum].state = KeyState::State::Cooldown;
-            }
-            else keyStates[keyEnum].state = KeyState::State::Released;
-            keyStates[keyEnum].timer = 0.f;
+
+    void Input::ApplyKeyDown(size_t key, INT64 time) {
+        if (!keyTracked.Test(key)) {
+            return;
         }
+
+        if (keyCooldown.Test(key) && KeyElapsed(key, time) < DOUBLE_TAP_THRESHOLD) {
+            keyCooldown.Reset(key);
+            keyDoublePressed.Set(key);
+        }
+        else if (!keyDown.Test(key)) {
+            // Released, or a cooldown over by now (a repeated WM_KEYDOWN of a down key changes nothing)
+            keyCooldown.Reset(key);
+            keyPressed.Set(key);
+        }
+        else {
+            return;
+        }
+        keyDown.Set(key);
+        keyChanged.Set(key);
+        keyTimers[key] = -Seconds(time - keyClock);
     }
+    void Input::ApplyKeyUp(size_t key, INT64 time) {
+        if (!keyTracked.Test(key)) {
+            return;
+        }
 
-    inline void Input::PushCallback(std::vector<std::function<void()>>& vectorCallback, std::function<void()> callback) {
+        // Released before TAP_THRESHOLD : a tap, which may become a double press
+        if (keyPressed.Test(key) && KeyElapsed(key, time) < TAP_THRESHOLD) {
+            keyCooldown.Set(key);
+        }
+        else {
+            keyCooldown.Reset(key);
+        }
+        keyPressed.Reset(key);
+        keyDoublePressed.Reset(key);
+        keyHeld.Reset(key);
+        keyDown.Reset(key);
+        keyChanged.Set(key);
+        keyTimers[key] = -Seconds(time - keyClock);
+    }
+    inline void Input::PushCallback(const Callback& callback) {
         if (callback) [[likely]] {
-            vectorCallback.push_back(callback);
+            dispatchList.push_back(&callback);
         }
         else [[unlikely]] {
             LOG_WARNING(L"Input - PushCallBack", L"The callback is empty");
         }
     }
-    void Input::ProcessActions(const FLOAT deltaTime) {
-        vector<std::function<void()>> callbacksToExecute;
+    void Input::ProcessActions(INT64 time) {
+        dispatchList.clear();
 
         for (auto it = pendingCallback.begin(); it != pendingCallback.end();) {
-            it->timer += deltaTime;
-            if (it->timer >= it->delay) {
-                callbacksToExecute.push_back(it->callback);
+            if (Seconds(time - it->pressTime) >= it->delay) {
+                PushCallback(it->action->callback);
                 it = pendingCallback.erase(it);
             }
             else {
@@ -113,114 +245,148 @@ namespace Input {
             }
         }
 
-        for (auto& [name, action] : actions) {
-            if (action.execution == KeyAction::Holding) {
-                bool anyKeyActive = false;
+        // Start : Actions bound to a changed or down key, each one once
+        actionFrame++;
+        const KeyMask activeKeys = keyChanged | keyDown;
+        keyChanged = KeyMask();
+
+        for (size_t word = 0; word < KeyMask::WORD_COUNT; word++) {
+            for (UINT64 bits = activeKeys.words[word]; bits; bits &= bits - 1) {
+                const size_t code = word * 64 + std::countr_zero(bits);
+                for (InputAction* action : keyActions[code]) {
+                    if (action->evaluatedFrame != actionFrame) {
+                        action->evaluatedFrame = actionFrame;
+                        EvaluateAction(*action, time);
+                    }
+                }
+            }
+        }
+        // End : Actions bound to a changed or down key
 
-                for (Key key : action.keys) {
-                    if (IsKeyHeld(key) || IsKeyPressed(key)) {
-                        anyKeyActive = true;
+        // A callback can unmap the action of one after it (its entry is nulled then, see SkipDispatch)
+        for (size_t i = 0; i < dispatchList.size(); i++) {
+            if (const Callback* callback = dispatchList[i]) {
+                (*callback)();
+            }
+        }
+    }
+    void Input::EvaluateAction(InputAction& action, INT64 time) {
+        if (action.execution == KeyAction::Holding) {
+            bool anyKeyActive = false;
 
-                        PushCallback(callbacksToExecute, action.callback);
-                        break;
-                    }
+            for (Key key : action.keys) {
+                if (IsKeyHeld(key) || IsKeyPressed(key)) {
+                    anyKeyActive = true;
+
+                    PushCallback(action.callback);
+                    break;
                 }
             }
-            else if (action.execution == KeyAction::SimplePress) {
-                bool anyKeyActive = false;
-
-                for (Key key : action.keys) {
-                    if (IsKeyPressed(key) || IsKeyDoublePressed(key) || IsKeyHeld(key)) {
-                        anyKeyActive = true;
-                        if (!action.executed) {
-                            if (action.needsConflictResolution) {
-                                if (IsKeyPressed(key) && !IsKeyDoublePressed(key)) {
-                                    pendingCallback.push_back({ action.callback, key, DEFAULT_CONFLICT_DELAY, 0.0f });
-                                    action.executed = true;
-                                }
-                            }
-                            else {
-                                PushCallback(callbacksToExecute, action.callback);
+        }
+        else if (action.execution == KeyAction::SimplePress) {
+            bool anyKeyActive = false;
+
+            for (Key key : action.keys) {
+                if (IsKeyPressed(key) || IsKeyDoublePressed(key) || IsKeyHeld(key)) {
+                    anyKeyActive = true;
+                    if (!action.executed) {
+                        if (action.needsConflictResolution) {
+                            if (IsKeyPressed(key) && !IsKeyDoublePressed(key)) {
+                                // The key timer holds the time since the press
+                                pendingCallback.push_back({ &action, key, DEFAULT_CONFLICT_DELAY, time - Ticks(KeyElapsed(static_cast<size_t>(key), time)) });
                                 action.executed = true;
                             }
                         }
-                        break;
+                        else {
+                            PushCallback(action.callback);
+                            action.executed = true;
+                        }
                     }
+                    break;
                 }
+            }
 
-                if (!anyKeyActive) {
-                    action.executed = false;
-                }
+            if (!anyKeyActive) {
+                action.executed = false;
             }
-            else if (action.execution == KeyAction::DoublePress) {
-                bool anyKeyActive = false;
+        }
+        else if (action.execution == KeyAction::DoublePress) {
+            bool anyKeyActive = false;
 
-                for (Key key : action.keys) {
-                    if (IsKeyDoublePressed(key)) {
-                        anyKeyActive = true;
+            for (Key key : action.keys) {
+                if (IsKeyDoublePressed(key)) {
+                    anyKeyActive = true;
 
-                        if (!action.executed) {
-                            PushCallback(callbacksToExecute, action.callback);
-                            action.executed = true;
+                    if (!action.executed) {
+                        PushCallback(action.callback);
+                        action.executed = true;
 
-                            for (auto it = pendingCallback.begin(); it != pendingCallback.end();) {
-                                if (it->key == key) {
-                                    it = pendingCallback.erase(it);
-                                }
-                                else {
-                                    it++;
-                                }
+                        for (auto it = pendingCallback.begin(); it != pendingCallback.end();) {
+                            if (it->key == key) {
+                                it = pendingCallback.erase(it);
+                            }
+                            else {
+                                it++;
                             }
                         }
-                        break;
                     }
-                }
-
-                if (!anyKeyActive) {
-                    action.executed = false;
+                    break;
                 }
             }
-        }
 
-        for (auto& callback : callbacksToExecute) {
-            callback();
+            if (!anyKeyActive) {
+                action.executed = false;
+            }
         }
     }
-    void Input::Input::UpdateKeyStates(const FLOAT deltaTime) {
-        for (auto& [key, state] : keyStates) {
-            switch (state.state) {
-            case KeyState::State::Pressed:
-                state.timer += deltaTime;
-                if (state.timer >= TAP_THRESHOLD) state.state = KeyState::State::Held;
-                break;
+    void Input::Input::UpdateKeyStates(INT64 time) {
+        // Start : Advance every timer to time (SSE, 4 keys at a time) and collect the thresholds crossed
+        const __m128 delta = _mm_set1_ps(Seconds(time - keyClock));
+        keyClock = time;
+        const __m128 tap = _mm_set1_ps(TAP_THRESHOLD);
+        const __m128 doubleTap = _mm_set1_ps(DOUBLE_TAP_THRESHOLD);
+
+        KeyMask pastTap;
+        KeyMask pastDoubleTap;
+        for (size_t i = 0; i < KEY_COUNT; i += 4) {
+            const __m128 timer = _mm_add_ps(_mm_load_ps(&keyTimers[i]), delta);
+            _mm_store_ps(&keyTimers[i], timer);
+
+            pastTap.words[i / 64] |= UINT64(_mm_movemask_ps(_mm_cmpge_ps(timer, tap))) << (i % 64);
+            pastDoubleTap.words[i / 64] |= UINT64(_mm_movemask_ps(_mm_cmpge_ps(timer, doubleTap))) << (i % 64);
+        }
+        // End : Advance every timer
 
-            case KeyState::State::Held:
-                state.timer += deltaTime;
-                break;
+        // Pressed -> Held
+        const KeyMask nowHeld = keyPressed & pastTap;
+        keyPressed &= ~nowHeld;
+        keyHeld |= nowHeld;
 
-            case KeyState::State::Cooldown:
-                state.timer += deltaTime;
-                if (state.timer >= DOUBLE_TAP_THRESHOLD) {
-                    state.state = KeyState::State::Released;
-                    state.timer = 0.f;
-                }
-                break;
-            }
-        }
+        // Cooldown -> Released (a double press is too late now)
+        keyCooldown &= ~pastDoubleTap;
     }
 
     // Other
 
     void Input::RecenterMouse() {
-        shouldRecenterMouse = true;
-        SetCursorPos(windowCenter.x, windowCenter.y);
+        ReanchorMouse(Now());
+        if (!replay) {
+            SetCursorPos(windowCenter.x, windowCenter.y);
+        }
     }
     bool Input::IsMouseInWindow() {
+        if (replay) {
+            return replay->mouseInWindow;
+        }
+
+        POINT cursor;
+        GetCursorPos(&cursor);
+        return IsCursorInWindow(cursor);
+    }
+    bool Input::IsCursorInWindow(POINT cursor) const {
         if (!hwnd) return false;
 
-        POINT cursorPos;
-        GetCursorPos(&cursorPos);
-        HWND windowUnderCursor = WindowFromPoint(cursorPos);
+        HWND windowUnderCursor = WindowFromPoint(cursor);
 
         return (windowUnderCursor == hwnd || IsChild(hwnd, windowUnderCursor));
     }
@@ -230,18 +396,31 @@ namespace Input {
         return isLeftMousePressed;
     }
 
-    void Input::UnmapAxis(const std::string& axisName) {
-        axes.erase(axisName);
+    void Input::UnmapAxis(ActionId axis) {
+        if (dispatching) {
+            deferredBindings.push_back([this, axis] { UnmapAxis(axis); });
+            return;
+        }
+        if (InputAxis* slot = FindSlot(axes, axis)) {
+            slot->mapped = false;
+            slot->callback.Reset();
+        }
     }
     void Input::ProcessMouseActions() {
-        for (const auto& [name, action] : mouseActions) {
-            if (IsMouseInWindow() && action.callback) {
+        for (size_t i = 0; i < mouseActions.size(); i++) {
+            const MouseAction& action = mouseActions[i];
+            if (action.mapped && action.callback && mouseInWindow) {
                 action.callback();
             }
         }
     }
     void Input::ProcessAxes(const float deltaTime) {
-        for (const auto& [name, axis] : axes) {
+        for (size_t i = 0; i < axes.size(); i++) {
+            const InputAxis& axis = axes[i];
+            if (!axis.mapped) {
+                continue;
+            }
+
             float value = 0.0f;
 
             if (IsKeyHeld(axis.positiveKey) || IsKeyPressed(axis.positiveKey)) {
@@ -259,65 +438,99 @@ namespace Input {
             }
         }
     }
-    void Input::UpdateMouseDelta() {
-        POINT currentPos;
-        GetCursorPos(&currentPos);
-
-        PCUpdateMouseDelta(currentPos);
-    }
-
-    constexpr void Input::PCUpdateMouseDelta(POINT& currentPos) {
-        if (shouldRecenterMouse || centerNextFrame) {
-            shouldRecenterMouse = false;
-            centerNextFrame = false;
-            lastMousePos = currentPos;
-            rawMouseDeltaX = 0.0f;
-            rawMouseDeltaY = 0.0f;
-            return;
+    void Input::UpdateCursor(INT64 now) {
+        if (replay) {
+            cursorPos = replay->cursor;
+            mouseInWindow = replay->mouseInWindow;
+        }
+        else {
+            GetCursorPos(&cursorPos);
+            mouseInWindow = IsCursorInWindow(cursorPos);
         }
 
-        rawMouseDeltaX = static_cast<float>(currentPos.x - lastMousePos.x);
-        rawMouseDeltaY = static_cast<float>(currentPos.y - lastMousePos.y);
-
-        mouseHistoryX.push_back(rawMouseDeltaX);
-        mouseHistoryY.push_back(rawMouseDeltaY);
+        if (mouseLocked) {
+            int distanceFromCenter = abs(cursorPos.x - windowCenter.x) + abs(cursorPos.y - windowCenter.y);
 
-        if (mouseHistoryX.size() > mouseHistorySize) {
-            mouseHistoryX.erase(mouseHistoryX.begin());
-            mouseHistoryY.erase(mouseHistoryY.begin());
+            if (distanceFromCenter > 100) {
+                ReanchorMouse(now);
+                if (!replay) {
+                    SetCursorPos(windowCenter.x, windowCenter.y);
+                }
+            }
         }
+    }
+    void Input::UpdateMouseDelta() {
+        mouseDelta.x = static_cast<LONG>(smoothedDeltaX);
+        mouseDelta.y = static_cast<LONG>(smoothedDeltaY);
+    }
 
-        float avgDeltaX = 0.0f;
-        float avgDeltaY = 0.0f;
-        for (size_t i = 0; i < mouseHistoryX.size(); ++i) {
-            avgDeltaX += mouseHistoryX[i];
-            avgDeltaY += mouseHistoryY[i];
+    void Input::SetMouseSmoothingFactor(float factor) {
+        if (ExponentialFilter* filter = mouseFilters.Find<ExponentialFilter>()) {
+            filter->SetRetention(factor);
+        }
+        else {
+            mouseFilters.Add(ExponentialFilter(factor));
+        }
+    }
+    void Input::SetMouseHistorySize(size_t size) {
+        if (MovingAverageFilter* filter = mouseFilters.Find<MovingAverageFilter>()) {
+            filter->SetWindow(size);
+        }
+        else {
+            mouseFilters.Add(MovingAverageFilter(size));
         }
-        avgDeltaX /= static_cast<float>(mouseHistoryX.size());
-        avgDeltaY /= static_cast<float>(mouseHistoryY.size());
+    }
 
-        smoothedDeltaX = smoothedDeltaX * mouseSmoothingFactor + avgDeltaX * (1.0f - mouseSmoothingFactor);
-        smoothedDeltaY = smoothedDeltaY * mouseSmoothingFactor + avgDeltaY * (1.0f - mouseSmoothingFactor);
+    void Input::MapAxis(ActionId axis, Key positiveKey, Key negativeKey, AxisCallback callback) {
+        if (dispatching) {
+            deferredBindings.push_back([this, axis, positiveKey, negativeKey, callback = move(callback)]() mutable {
+                MapAxis(axis, positiveKey, negativeKey, move(callback));
+            });
+            return;
+        }
 
-        mouseDelta.x = static_cast<LONG>(smoothedDeltaX);
-        mouseDelta.y = static_cast<LONG>(smoothedDeltaY);
+        InputAxis* slot = FindSlot(axes, axis);
+        if (!slot) {
+            slot = &axes.emplace_back();
+        }
+        *slot = { axis, positiveKey, negativeKey, move(callback) };
+        slot->mapped = true;
 
-        lastMousePos = currentPos;
-        mousePos = currentPos;
+        TrackKey(positiveKey);
+        TrackKey(negativeKey);
     }
+    void Input::MapMouse(ActionId action, Callback callback) {
+        if (dispatching) {
+            deferredBindings.push_back([this, action, callback = move(callback)]() mutable { MapMouse(action, move(callback)); });
+            return;
+        }
 
-    void Input::MapAxis(const std::string& axisName, Key positiveKey, Key negativeKey, std::function<void(float)> callback) {
-        axes[axisName] = { axisName, positiveKey, negativeKey, callback };
-        keyStates[positiveKey] = { KeyState::State::Released, 0.0f };
-        keyStates[negativeKey] = { KeyState::State::Released, 0.0f };
-    }
-    void Input::MapMouse(const std::string& actionName, std::function<void()> callback) {
-        mouseActions[actionName] = { actionName, callback };
+        MouseAction* slot = FindSlot(mouseActions, action);
+        if (!slot) {
+            slot = &mouseActions.emplace_back();
+        }
+        *slot = { action, move(callback), true };
     }
-    void Input::UnmapMouse(const std::string& actionName) {
-        mouseActions.erase(actionName);
+    void Input::UnmapMouse(ActionId action) {
+        if (dispatching) {
+            deferredBindings.push_back([this, action] { UnmapMouse(action); });
+            return;
+        }
+        if (MouseAction* slot = FindSlot(mouseActions, action)) {
+            slot->mapped = false;
+            slot->callback.Reset();
+        }
     }
     void Input::SetMouseLocked(bool locked) {
+        // Replayed : the real cursor isn't touched
+        if (replay) {
+            if (locked && !mouseLocked) {
+                ReanchorMouse(Now());
+            }
+            mouseLocked = locked;
+            return;
+        }
+
         if (locked && !mouseLocked) {
             GetClipCursor(&originalClipRect);
 
@@ -329,7 +542,7 @@ namespace Input {
 
             ShowCursor(FALSE);
 
-            shouldRecenterMouse = true;
+            ReanchorMouse(Now());
             SetCursorPos(windowCenter.x, windowCenter.y);
         }
         else if (!locked && mouseLocked) {
@@ -339,11 +552,132 @@ namespace Input {
 
         mouseLocked = locked;
     }
+
+    // Start : Events
+    INT64 Input::QueryCounter() {
+        LARGE_INTEGER counter;
+        QueryPerformanceCounter(&counter);
+        return counter.QuadPart;
+    }
+    double Input::Frequency() {
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+        return static_cast<double>(frequency.QuadPart);
+    }
+
+    void Input::PushEvent(InputEvent event) {
+        event.time = Now();
+        if (!events.Push(event)) [[unlikely]] {
+            // Once per overflow, not once per dropped event
+            if (!eventOverflow.exchange(true, std::memory_order_relaxed)) {
+                LOG_WARNING(L"Input - PushEvent", L"The event queue is full (Update isn't called ?), events are dropped");
+            }
+            return;
+        }
+        eventOverflow.store(false, std::memory_order_relaxed);
+    }
+    void Input::OnKeyDown(WPARAM key) {
+        if (key < KEY_COUNT) {
+            PushEvent({ InputEvent::Type::KeyDown, static_cast<UINT8>(key) });
+        }
+    }
+    void Input::OnKeyUp(WPARAM key) {
+        if (key < KEY_COUNT) {
+            PushEvent({ InputEvent::Type::KeyUp, static_cast<UINT8>(key) });
+        }
+    }
     void Input::OnMouseMove(int x, int y) {
-        mousePos.x = x;
-        mousePos.y = y;
+        PushEvent({ InputEvent::Type::MouseMove, 0, x, y });
     }
     void Input::OnMouseWheel(int delta) {
-        mouseWheelDelta = delta;
+        PushEvent({ InputEvent::Type::MouseWheel, 0, delta });
+    }
+
+    void Input::SetReplay(const ReplayFrame* frame, double frameTicksPerSecond) {
+        replay = frame;
+        ticksPerSecond = frame ? frameTicksPerSecond : Frequency();
+        keyClock = Now();
+    }
+
+    INT64 Input::ConsumeEvents(INT64 now) {
+        KeyMask changed;
+        while (const InputEvent* event = events.Front()) {
+            // Queued while consuming : next frame
+            if (event->time > now) {
+                break;
+            }
+            // Never before the key states (an event can't change the past)
+            const INT64 time = std::max(event->time, keyClock);
+
+            switch (event->type) {
+            case InputEvent::Type::KeyDown:
+            case InputEvent::Type::KeyUp:
+                if (keyTracked.Test(event->key)) {
+                    // Auto-repeated WM_KEYDOWN of a down key, or the release of a released one : not a change
+                    //	(a held key repeats at ~30 Hz, counting those would consume one per frame and queue everything behind them)
+                    if (keyDown.Test(event->key) == (event->type == InputEvent::Type::KeyDown)) {
+                        break;
+                    }
+                    // Second change of this key : the actions see the first one this frame, this one the next
+                    if (changed.Test(event->key)) {
+                        return time;
+                    }
+                    changed.Set(event->key);
+                }
+                if (event->type == InputEvent::Type::KeyDown) {
+                    ApplyKeyDown(event->key, time);
+                }
+                else {
+                    ApplyKeyUp(event->key, time);
+                }
+                break;
+            case InputEvent::Type::MouseMove:
+                FilterMouseMove(*event);
+                break;
+            case InputEvent::Type::MouseWheel:
+                mouseWheelDelta += event->x;
+                break;
+            }
+
+            if (recorder) {
+                recordedEvents.push_back(*event);
+            }
+            events.Pop();
+        }
+
+        return now;
+    }
+
+    void Input::FilterMouseMove(const InputEvent& event) {
+        mousePos = { event.x, event.y };
+
+        if (mouseAnchorPending && event.time >= mouseAnchorTime) {
+            mouseAnchorPending = false;
+            mouseFilters.Reset();
+            lastMovePos = mousePos;
+            lastMoveTime = event.time;
+            return;
+        }
+
+        const FLOAT deltaX = static_cast<FLOAT>(mousePos.x - lastMovePos.x);
+        const FLOAT deltaY = static_cast<FLOAT>(mousePos.y - lastMovePos.y);
+        FLOAT elapsed = Seconds(event.time - lastMoveTime);
+        lastMovePos = mousePos;
+        lastMoveTime = event.time;
+
+        if (elapsed > MOUSE_IDLE_TIME) {
+            mouseFilters.Reset();
+        }
+        elapsed = std::max(elapsed, MIN_MOUSE_INTERVAL);
+
+        // Filtered as a velocity, so the stages don't depend on the polling rate
+        const MouseSample velocity = mouseFilters.Apply({ deltaX / elapsed, deltaY / elapsed }, elapsed);
+        smoothedDeltaX += velocity.x * elapsed;
+        smoothedDeltaY += velocity.y * elapsed;
+    }
+    void Input::ReanchorMouse(INT64 time) {
+        mouseAnchorPending = true;
+        mouseAnchorTime = time;
     }
+    // End : Events
 }
@@ -1,7 +1,13 @@
 #pragma once
 #include "include.h"
+#include "EventQueue.h"
+#include "MouseFilter.h"
+#include "InplaceFunction.h"
+#include "ActionId.h"
 
 namespace Input {
+    class InputRecorder;
+
     enum class Key {
         A = 'A',
         B = 'B',
@@ -70,6 +76,46 @@ namespace Input {
         F11 = VK_F11,
         F12 = VK_F12,
     };
+
+    // Virtual-key codes are bytes : every key state fits in flat arrays indexed by the code
+    static constexpr size_t KEY_COUNT = 256;
+
+    // One bit per virtual-key code : a set of keys (a chord) is tested against a key state with one compare
+    class KeyMask {
+    public:
+        constexpr KeyMask() = default;
+        constexpr KeyMask(std::initializer_list<Key> keys) {
+            for (Key key : keys) {
+                Set(key);
+            }
+        }
+
+        constexpr void Set(Key key) { Set(static_cast<size_t>(key)); }
+        constexpr void Reset(Key key) { Reset(static_cast<size_t>(key)); }
+        constexpr bool Test(Key key) const { return Test(static_cast<size_t>(key)); }
+        constexpr void Set(size_t code) { words[code / 64] |= UINT64(1) << (code % 64); }
+        constexpr void Reset(size_t code) { words[code / 64] &= ~(UINT64(1) << (code % 64)); }
+        constexpr bool Test(size_t code) const { return (words[code / 64] >> (code % 64)) & 1; }
+
+        // Every key of other is in this mask
+        constexpr bool Contains(const KeyMask& other) const { return (*this & other) == other; }
+        constexpr bool Intersects(const KeyMask& other) const { return (*this & other).Any(); }
+        constexpr bool Any() const { return (words[0] | words[1] | words[2] | words[3]) != 0; }
+
+        constexpr KeyMask operator&(const KeyMask& other) const { KeyMask mask; for (size_t i = 0; i < WORD_COUNT; i++) mask.words[i] = words[i] & other.words[i]; return mask; }
+        constexpr KeyMask operator|(const KeyMask& other) const { KeyMask mask; for (size_t i = 0; i < WORD_COUNT; i++) mask.words[i] = words[i] | other.words[i]; return mask; }
+        constexpr KeyMask operator~() const { KeyMask mask; for (size_t i = 0; i < WORD_COUNT; i++) mask.words[i] = ~words[i]; return mask; }
+        constexpr KeyMask& operator&=(const KeyMask& other) { return *this = *this & other; }
+        constexpr KeyMask& operator|=(const KeyMask& other) { return *this = *this | other; }
+        constexpr bool operator==(const KeyMask& other) const = default;
+
+    private:
+        friend class Input;
+        static constexpr size_t WORD_COUNT = KEY_COUNT / 64;
+
+        std::array<UINT64, WORD_COUNT> words = {};
+    };
+
     enum class KeyAction {
         SimplePress,
         DoublePress,
@@ -78,36 +124,65 @@ namespace Input {
     
     class Input {
     public:
+        // Bindings keep their callable inline : mapping never allocates for it, running it never copies it.
+        //	64 bytes : a few captures, or a whole std::function
+        static constexpr size_t CALLBACK_CAPACITY = 64;
+        using Callback = InplaceFunction<void(), CALLBACK_CAPACITY>;
+        using AxisCallback = InplaceFunction<void(float), CALLBACK_CAPACITY>;
+
         Input() {}
         Input(HWND hWnd) : hwnd(hWnd) {}
+        // keyActions points into actionSlots
+        Input(const Input&) = delete;
+        Input& operator=(const Input&) = delete;
         ~Input();
 
+        // Consumes the queued events in order, then updates the key states and runs the actions.
+        // Tap, double tap and hold thresholds are measured between the event times, not in frames.
         void Update(const FLOAT deltaTime);
 
+        static constexpr size_t EVENT_QUEUE_CAPACITY = 1024;
 
-        // Keyboard (mostly)
+        // Start : Window thread (producer), only queue a timestamped event : Update can run on another thread
         void OnKeyDown(WPARAM key);
         void OnKeyUp(WPARAM key);
-        void MapAction(const std::string& actionName, Key key, std::function<void()> callback, KeyAction execution, BOOL conflict = false);
-        void MapAction(const std::string& actionName, const std::vector<Key>& keys, std::function<void()> callback, KeyAction execution, BOOL conflict = false);
-        void UnmapAction(const std::string& actionName);
+        void OnMouseMove(int x, int y);
+        void OnMouseWheel(int delta);
+        // End : Window thread
+
+        // Keyboard (mostly)
+        // Mapping an id again replaces its binding. Remapping an id unmapped before allocates nothing.
+        // Called from a callback, Map* / Unmap* take effect once every callback of the Update returned.
+        void MapAction(ActionId action, Key key, Callback callback, KeyAction execution, BOOL conflict = false);
+        void MapAction(ActionId action, std::span<const Key> keys, Callback callback, KeyAction execution, BOOL conflict = false);
+        void MapAction(ActionId action, std::initializer_list<Key> keys, Callback callback, KeyAction execution, BOOL conflict = false) {
+            MapAction(action, std::span<const Key>(keys.begin(), keys.size()), std::move(callback), execution, conflict);
+        }
+        void UnmapAction(ActionId action);
+        bool IsActionMapped(ActionId action) const;
+        // Tooling (console, config files, debug views) : hashes name, prefer ids everywhere else
+        bool IsActionNameMapped(std::string_view name) const { return IsActionMapped(ActionId::FromName(name)); }
         
         bool IsKeyHeld(Key key) const;
         bool IsKeyPressed(Key key) const;
         bool IsKeyDoublePressed(Key key) const;
+        // Pressed, double pressed or held
+        bool IsKeyDown(Key key) const;
+        // Every key of chord is down (Ctrl + Shift + S, ...)
+        bool IsChordDown(const KeyMask& chord) const { return keyDown.Contains(chord); }
+        // Every key of chord is held (past TAP_THRESHOLD)
+        bool IsChordHeld(const KeyMask& chord) const { return keyHeld.Contains(chord); }
         
         // Other
-        void OnMouseMove(int x, int y);
-        void OnMouseWheel(int delta);
-        void MapMouse(const std::string& actionName, std::function<void()> callback);
-        void UnmapMouse(const std::string& actionName);
+        void MapMouse(ActionId action, Callback callback);
+        void UnmapMouse(ActionId action);
 
         POINT GetMousePosition() const { return mousePos; }
         POINT GetMouseDelta() const { return mouseDelta; }
         int GetMouseWheelDelta() const { return mouseWheelDelta; }
 
-        void MapAxis(const std::string& axisName, Key positiveKey, Key negativeKey, std::function<void(float)> callback);
-        void UnmapAxis(const std::string& axisName);
+        void MapAxis(ActionId axis, Key positiveKey, Key negativeKey, AxisCallback callback);
+        void UnmapAxis(ActionId axis);
 
         constexpr float GetDeltaHorizontal() { return static_cast<float>(mouseDelta.x); }
         constexpr float GetDeltaVertical() const { return static_cast<float>(mouseDelta.y); }
@@ -126,19 +201,34 @@ namespace Input {
         float GetSmoothDeltaVertical() const {
             return smoothedDeltaY * mouseSensitivity;
         }
-        void SetMouseSmoothingFactor(float factor) {
-            mouseSmoothingFactor = std::clamp(factor, 0.0f, 1.0f);
-        }
-        void SetMouseHistorySize(size_t size) {
-            mouseHistorySize = std::max(size, static_cast<size_t>(1));
-            if (mouseHistoryX.size() > mouseHistorySize) {
-                mouseHistoryX.resize(mouseHistorySize);
-                mouseHistoryY.resize(mouseHistorySize);
-            }
-        }
+        // Every mouse move consumed by Update goes through the chain (a moving average then an exponential smoothing by default),
+        //	the smoothed delta is the sum of the filtered moves of the frame. Only change it on the Update thread.
+        MouseFilterChain& GetMouseFilters() { return mouseFilters; }
+        // Exponential stage : part of the smoothed velocity kept after 1/60 s (added if the chain has none)
+        void SetMouseSmoothingFactor(float factor);
+        // Moving average stage : number of moves averaged (added if the chain has none)
+        void SetMouseHistorySize(size_t size);
 
         void SetHWND(HWND hWnd) { hwnd = hWnd; }
+
+        // Every Update (its deltaTime, the events it consumed and the cursor) is written to recorder while it is set
+        //	(InputRecorder::Begin / End do it)
+        void SetRecorder(InputRecorder* recorder) { this->recorder = recorder; }
+        // What a replayed Update reads instead of QueryPerformanceCounter and GetCursorPos
+        struct ReplayFrame {
+            INT64 time;     // In ticks of the recording
+            POINT cursor;
+            bool mouseAnchorPending;    // Where the moves were measured from when they were consumed
+            INT64 mouseAnchorTime;
+            bool mouseInWindow;         // What IsMouseInWindow returned, for the mouse actions
+        };
+        // While frame is set, the event stamps and Update read it (and never move the cursor) :
+        //	no window nor OS input is needed (see InputReplayer). nullptr goes back to the live clock and cursor.
+        void SetReplay(const ReplayFrame* frame, double frameTicksPerSecond);
+        double GetTicksPerSecond() const { return ticksPerSecond; }
     private:
+        friend class InputRecorder;     // Reads keyClock when a recording begins
+
         // Keyboard (mostly)
         static constexpr FLOAT TAP_THRESHOLD = std::chrono::duration<float>(std::chrono::milliseconds(100)).count();
         static constexpr FLOAT DOUBLE_TAP_THRESHOLD = std::chrono::duration<float>(std::chrono::milliseconds(300)).count();
@@ -147,47 +237,106 @@ namespace Input {
 
         struct InputAction {
             std::vector<Key> keys;
-            std::function<void()> callback;
+            Callback callback;
             KeyAction execution;
             BOOL needsConflictResolution = false;
             BOOL executed = false;
+            UINT64 evaluatedFrame = 0;
+            bool mapped = false;
         };
-        std::unordered_map<std::string, InputAction> actions;
+        // Start : Action slots
+        // One slot per id ever mapped, kept when it is unmapped (with the capacity of its keys) for the next time it is :
+        //	a context switch only flips slots. A deque so the slots never move (keyActions, pendingCallback and
+        //	dispatchList point into it, a callback can map a new action).
+        std::deque<InputAction> actionSlots;
+        std::unordered_map<ActionId, UINT32, ActionId::Hasher> actionIndex;
+        InputAction* FindAction(ActionId action);
+        // End : Action slots
+        // Reverse index : actions bound to each virtual-key code
+        std::array<std::vector<InputAction*>, KEY_COUNT> keyActions;
+        UINT64 actionFrame = 0;
+        void UnbindAction(InputAction& action);
+        // The callback of action, delayed (the action stays mapped until it runs, or it is dropped).
+        //	Timed from the press event, not by summing frame deltas : a replay runs it on the same frame.
         struct PendingCallback {
-            std::function<void()> callback;
+            InputAction* action;
             Key key;
             FLOAT delay;
-            FLOAT timer = 0.0f;
+            INT64 pressTime;    // Ticks, like the event times
         };
         std::vector<PendingCallback> pendingCallback;
-        void ProcessActions(const FLOAT deltaTime);
-        inline void PushCallback(std::vector<std::function<void()>>& vectorCallback, std::function<void()> callback);
-
-        struct KeyState {
-            enum class State {
-                Pressed,
-                DoublePressed,
-                Held,
-                Released,
-                Cooldown
-            } state;
-            FLOAT timer = 0.f;
-        };
-        std::unordered_map<Key, KeyState> keyStates;
-        void UpdateKeyStates(const FLOAT deltaTime);
+        // Only the actions bound to a key that changed since the last frame or is down are evaluated :
+        //	an idle frame costs nothing however many actions are mapped
+        // time : when the key states are valid (what ConsumeEvents returned)
+        void ProcessActions(INT64 time);
+        void EvaluateAction(InputAction& action, INT64 time);
+        inline void PushCallback(const Callback& callback);
+        // The callbacks of this frame, run once every action is evaluated. Kept between frames so it stops allocating;
+        //	an entry is nulled when its action is unmapped by a callback that runs before it.
+        std::vector<const Callback*> dispatchList;
+        // While callbacks run (in place, not copied), binding changes are queued : a callback unmapping its own action
+        //	or switching the InputManager context would destroy the callable that is running
+        bool dispatching = false;
+        std::vector<std::function<void()>> deferredBindings;
+        void SkipDispatch(ActionId action);
+        void ApplyDeferredBindings();
+
+        // Key states, one bit per virtual-key code in each mask : a key is in at most one of
+        //	pressed, doublePressed, held and cooldown (released if tracked and in none of them).
+        // Only the tracked keys (mapped by an action or an axis) change state.
+        KeyMask keyTracked;
+        KeyMask keyPressed;
+        KeyMask keyDoublePressed;
+        KeyMask keyHeld;
+        KeyMask keyCooldown;
+        KeyMask keyDown;    // pressed | doublePressed | held
+        KeyMask keyChanged; // By the events consumed since the last ProcessActions
+        // Time in the current state at keyClock, advanced for every key at once (only read in the pressed and cooldown states).
+        //	A key changed by an event after keyClock starts negative, so it reads 0 at the event time.
+        alignas(16) std::array<FLOAT, KEY_COUNT> keyTimers = {};
+        INT64 keyClock = QueryCounter();
+        void UpdateKeyStates(INT64 time);
+
+        // Start : Events
+        SpscQueue<InputEvent, EVENT_QUEUE_CAPACITY> events;
+        std::atomic<bool> eventOverflow = false;
+        double ticksPerSecond = Frequency();
+        const ReplayFrame* replay = nullptr;
+        InputRecorder* recorder = nullptr;
+        std::vector<InputEvent> recordedEvents;    // Consumed by this Update, while recording
+
+        void PushEvent(InputEvent event);
+        // Applies the events up to now, returns the time the key states are valid at :
+        //	now, or the time of a key's second change, left for the next frame so each change is seen by the actions
+        INT64 ConsumeEvents(INT64 now);
+        void ApplyKeyDown(size_t key, INT64 time);
+        void ApplyKeyUp(size_t key, INT64 time);
+        // Time in the state of key at time
+        FLOAT KeyElapsed(size_t key, INT64 time) const { return keyTimers[key] + Seconds(time - keyClock); }
+        FLOAT Seconds(INT64 ticks) const { return static_cast<FLOAT>(static_cast<double>(ticks) / ticksPerSecond); }
+        INT64 Ticks(FLOAT seconds) const { return static_cast<INT64>(static_cast<double>(seconds) * ticksPerSecond); }
+        INT64 Now() const { return replay ? replay->time : QueryCounter(); }
+        static INT64 QueryCounter();
+        static double Frequency();
+        // End : Events
+        // Tracked and released
+        void TrackKey(Key key);
         
         // Other
+        // Few and all run every frame : found by id, one slot per id ever mapped (like actionSlots)
         struct MouseAction {
-            std::string name;
-            std::function<void()> callback;
+            ActionId id;
+            Callback callback;
+            bool mapped = false;
         };
         struct InputAxis {
-            std::string name;
+            ActionId id;
             Key positiveKey;
             Key negativeKey;
-            std::function<void(float)> callback;
+            AxisCallback callback;
             float deadzone = 0.1f;
             float sensitivity = 1.0f;
+            bool mapped = false;
         };
 
 
@@ -195,12 +344,11 @@ namespace Input {
         POINT windowCenter = { 0, 0 };
         
         
-        std::unordered_map<std::string, MouseAction> mouseActions;
-        std::unordered_map<std::string, InputAxis> axes;
+        std::deque<MouseAction> mouseActions;
+        std::deque<InputAxis> axes;
         
         POINT mousePos = { 0, 0 };
         POINT mouseDelta = { 0, 0 };
-        POINT lastMousePos = { 0, 0 };
         int mouseWheelDelta = 0;
         float mouseSensitivity = 0.2f;
         bool mouseLocked = false;
@@ -210,18 +358,31 @@ namespace Input {
         void ProcessMouseActions();
         void ProcessAxes(const float deltaTime);
         void UpdateMouseDelta();
-        constexpr void PCUpdateMouseDelta(POINT&);
-        
-        bool shouldRecenterMouse = false;
-        float rawMouseDeltaX = 0.0f;
-        float rawMouseDeltaY = 0.0f;
-        float smoothedDeltaX = 0.0f;
+        // Reads the cursor and puts it back in the center if it is locked and went too far
+        //	(the moves after now are measured from the center)
+        void UpdateCursor(INT64 now);
+        POINT cursorPos = { 0, 0 };     // Read once per Update by UpdateCursor
+        bool mouseInWindow = false;     // Same
+        bool IsCursorInWindow(POINT cursor) const;
+
+        // Start : Mouse filters
+        // Longer without a move : the mouse stopped, the next move starts the filters over
+        static constexpr FLOAT MOUSE_IDLE_TIME = std::chrono::duration<float>(std::chrono::milliseconds(100)).count();
+        // Moves closer than that (same tick, coalesced messages) are measured over it
+        static constexpr FLOAT MIN_MOUSE_INTERVAL = 1.0f / 8000.0f;
+
+        MouseFilterChain mouseFilters = { MovingAverageFilter(3), ExponentialFilter(.3f) };
+        POINT lastMovePos = { 0, 0 };
+        INT64 lastMoveTime = 0;
+        // The first move at or after mouseAnchorTime only gives the position the next ones are measured from
+        //	(the first move ever, the one SetCursorPos causes)
+        bool mouseAnchorPending = true;
+        INT64 mouseAnchorTime = 0;
+        float smoothedDeltaX = 0.0f;    // Filtered moves consumed by this Update
         float smoothedDeltaY = 0.0f;
-        float mouseSmoothingFactor = .3f;
-        std::vector<float> mouseHistoryX;
-        std::vector<float> mouseHistoryY;
-        size_t mouseHistorySize = 3;
-        bool centerNextFrame = false;
+        void FilterMouseMove(const InputEvent& event);
+        void ReanchorMouse(INT64 time);
+        // End : Mouse filters
     };
 
 
@@ -34,7 +34,7 @@ namespace InputManager {
         InputContext& context = contexts[contextId];
 
         for (size_t i = 0; i < context.inputMaps.size(); ++i) {
-            if (context.inputMaps[i].actionName == inputMap.actionName) {
+            if (context.inputMaps[i].action == inputMap.action) {
                 context.inputMaps.erase(context.inputMaps.begin() + i);
                 return true;
             }
@@ -43,7 +43,7 @@ namespace InputManager {
         return false;
     }
 
-    bool InputManager::RemoveInputMap(UINT8 contextId, string actionName) {
+    bool InputManager::RemoveInputMap(UINT8 contextId, Input::ActionId action) {
         if (contexts.find(contextId) == contexts.end()) {
             LOG_WARNING("InputManager - RemoveInputMap", "Context ID " + to_string(contextId) + " does not exist");
             return false;
@@ -52,7 +52,7 @@ namespace InputManager {
         InputContext& context = contexts[contextId];
 
         for (size_t i = 0; i < context.inputMaps.size(); ++i) {
-            if (context.inputMaps[i].actionName == actionName) {
+            if (context.inputMaps[i].action == action) {
                 context.inputMaps.erase(context.inputMaps.begin() + i);
                 return true;
             }
@@ -145,33 +145,27 @@ namespace InputManager {
 
         for (auto& inputMap : context.inputMaps) {
             if (inputMap.blockLowerContexts) {
-                std::vector<InputMap*> alreadyMappedKey = FindKeyMap(inputMap.key);
-                for (auto& mappedKey : alreadyMappedKey) {
-                    if (!(mappedKey->priority >= inputMap.priority)) {
-                        input->UnmapAction(mappedKey->actionName);
-                    }
-                }
+                UnmapLowerPriority(inputMap);
             }
-            input->MapAction(inputMap.actionName, inputMap.key, inputMap.callback, inputMap.execution, inputMap.delayBeforeExecution);
+            input->MapAction(inputMap.action, inputMap.key, inputMap.callback, inputMap.execution, inputMap.delayBeforeExecution);
         }
 
         return true;
     }
 
-    std::vector<InputMap*> InputManager::FindKeyMap(Key key) {
-        std::vector<InputMap*> it;
-
+    void InputManager::UnmapLowerPriority(const InputMap& blocking) {
         for (UINT8 currentContextId : activeContextStack) {
-            if (contexts.find(currentContextId) != contexts.end()) {
-                for (auto& inputMap : contexts[currentContextId].inputMaps) {
-                    if (inputMap.key == key) {
-                        it.push_back(&inputMap);
-                    }
+            auto it = contexts.find(currentContextId);
+            if (it == contexts.end()) {
+                continue;
+            }
+
+            for (const InputMap& inputMap : it->second.inputMaps) {
+                if (inputMap.key == blocking.key && inputMap.priority < blocking.priority) {
+                    input->UnmapAction(inputMap.action);
                 }
             }
         }
-
-        return it;
     }
 
     bool InputManager::UnUseContexts() {
@@ -187,7 +181,7 @@ namespace InputManager {
                     LOG_ERROR("InputManager - UnUseContexts", "Warning /!\\ Register in activeContextStack but isActive is set to false");
                 }
                 for (auto& inputMap : context.inputMaps) {
-                    input->UnmapAction(inputMap.actionName);
+                    input->UnmapAction(inputMap.action);
                 }
                 context.isActive = false;
             }
@@ -3,9 +3,9 @@
 
 namespace InputManager {
 	struct InputMap {
-		std::string actionName;
+		Input::ActionId action;
 		Key key;
-		std::function<void()> callback;
+		Input::Input::Callback callback;
 		Input::KeyAction execution;
 		FLOAT delayBeforeExecution = 0.f;
 
@@ -32,7 +32,7 @@ namespace InputManager {
 
 		void AddInputMap(UINT8 contextId, InputMap inputmap);
 		bool RemoveInputMap(UINT8 contextId, const InputMap& inputmap);
-		bool RemoveInputMap(UINT8 contextId, std::string actionName);
+		bool RemoveInputMap(UINT8 contextId, Input::ActionId action);
 		bool RemoveInputMap(UINT8 contextId, Key key);
 
 
@@ -45,7 +45,8 @@ namespace InputManager {
 
 		void SetInput(Input::Input* input) { this->input = input; }
 	private:
-		std::vector<InputMap*> FindKeyMap(Key key);
+		// Unmaps the active bindings of the key of blocking with a lower priority
+		void UnmapLowerPriority(const InputMap& blocking);
 
 		Input::Input* input;
 
@@ -0,0 +1,224 @@
+#include "InputRecorder.h"
+#include "..\FileManager\FileManager.h"
+#include <cstring>
+#include <thread>
+
+namespace Input {
+
+    namespace {
+        template<typename T>
+        void Append(vector<std::byte>& out, const T& value) {
+            const std::byte* bytes = reinterpret_cast<const std::byte*>(&value);
+            out.insert(out.end(), bytes, bytes + sizeof(T));
+        }
+
+        template<typename T>
+        bool Extract(std::span<const std::byte>& in, T& value) {
+            if (in.size() < sizeof(T)) {
+                return false;
+            }
+            std::memcpy(&value, in.data(), sizeof(T));
+            in = in.subspan(sizeof(T));
+            return true;
+        }
+
+        INT16 Clamp16(INT32 value) {
+            return static_cast<INT16>(std::clamp<INT32>(value, INT16_MIN, INT16_MAX));
+        }
+    }
+
+    // Start : InputRecorder
+    bool InputRecorder::Begin(Input& recorded, const wstring& path) {
+        if (IsRecording()) [[unlikely]] {
+            LOG_WARNING(L"InputRecorder - Begin", L"Already recording (" + filePath + L"), call End first");
+            return false;
+        }
+
+        filePath = path;
+        failed = false;
+        header = { 0, VERSION, static_cast<INT64>(recorded.GetTicksPerSecond()), recorded.keyClock, 0 };
+
+        // Placeholder (magic 0) until End knows the frame count
+        if (!writer.Open(filePath, true) || !writer.Append(std::as_bytes(std::span(&header, 1)))) [[unlikely]] {
+            writer.Close();
+            return false;
+        }
+
+        input = &recorded;
+        input->SetRecorder(this);
+        return true;
+    }
+    bool InputRecorder::End() {
+        if (!IsRecording()) {
+            return false;
+        }
+
+        input->SetRecorder(nullptr);
+        input = nullptr;
+
+        if (!writer.Close() || failed) [[unlikely]] {
+            LOG_ERROR(L"InputRecorder - End", L"(" + filePath + L") A write failed, the recording is incomplete");
+            return false;
+        }
+
+        header.magic = MAGIC;
+        bool success = FileManager::FileManager::WriteFile(filePath, std::as_bytes(std::span(&header, 1)), 0);
+        FileManager::FileManager::InvalidateHandle(filePath);
+
+        return success;
+    }
+
+    void InputRecorder::RecordFrame(FLOAT deltaTime, INT64 time, POINT cursor, bool deferred, bool anchorPending, INT64 anchorTime, bool mouseInWindow, std::span<const InputEvent> frameEvents) {
+        if (failed) [[unlikely]] {
+            return;
+        }
+
+        // The event queue holds less than a UINT16 of events, so one Update never consumes more
+        static_assert(Input::EVENT_QUEUE_CAPACITY <= UINT16_MAX);
+
+        UINT8 flags = FRAME_NONE;
+        if (deferred) {
+            flags |= FRAME_DEFERRED;
+        }
+        if (anchorPending) {
+            flags |= FRAME_MOUSE_ANCHOR;
+        }
+        if (mouseInWindow) {
+            flags |= FRAME_MOUSE_IN_WINDOW;
+        }
+
+        frameBuffer.clear();
+        Append(frameBuffer, FrameRecord{
+            time, anchorTime, deltaTime, static_cast<INT32>(cursor.x), static_cast<INT32>(cursor.y),
+            static_cast<UINT16>(frameEvents.size()), flags, 0
+        });
+        for (const InputEvent& event : frameEvents) {
+            Append(frameBuffer, EventRecord{ event.time, static_cast<UINT8>(event.type), event.key, Clamp16(event.x), Clamp16(event.y), 0 });
+        }
+
+        if (!writer.Append(frameBuffer)) [[unlikely]] {
+            failed = true;
+            return;
+        }
+        header.frameCount++;
+    }
+    // End : InputRecorder
+
+    // Start : InputReplayer
+    bool InputReplayer::Load(const wstring& filePath) {
+        frames.clear();
+        events.clear();
+
+        FileManager::FileManager file;
+        if (!file.ReadFile(filePath)) [[unlikely]] {
+            return false;
+        }
+
+        std::span<const std::byte> in = std::as_bytes(std::span(file.GetData()));
+        InputRecorder::Header header;
+        if (!Extract(in, header) || header.magic != InputRecorder::MAGIC || header.version != InputRecorder::VERSION || header.ticksPerSecond <= 0) {
+            LOG_WARNING(L"InputReplayer - Load", L"(" + filePath + L") isn't a finished input recording or has an old version");
+            return false;
+        }
+
+        frames.reserve(static_cast<size_t>(std::min<UINT64>(header.frameCount, in.size() / sizeof(InputRecorder::FrameRecord))));
+        for (UINT64 i = 0; i < header.frameCount; i++) {
+            Frame frame = { {}, events.size() };
+            if (!Extract(in, frame.record)) [[unlikely]] {
+                LOG_WARNING(L"InputReplayer - Load", L"(" + filePath + L") is truncated");
+                frames.clear();
+                events.clear();
+                return false;
+            }
+
+            for (UINT16 j = 0; j < frame.record.eventCount; j++) {
+                InputRecorder::EventRecord event;
+                if (!Extract(in, event) || event.type > static_cast<UINT8>(InputEvent::Type::MouseWheel)) [[unlikely]] {
+                    LOG_WARNING(L"InputReplayer - Load", L"(" + filePath + L") is truncated or corrupted");
+                    frames.clear();
+                    events.clear();
+                    return false;
+                }
+                events.push_back(event);
+            }
+            frames.push_back(frame);
+        }
+
+        ticksPerSecond = header.ticksPerSecond;
+        startTime = header.startTime;
+        return true;
+    }
+
+    bool InputReplayer::Replay(Input& input, const FrameCallback& onFrame, bool paced) const {
+        if (ticksPerSecond <= 0) [[unlikely]] {
+            LOG_WARNING(L"InputReplayer - Replay", L"Nothing loaded");
+            return false;
+        }
+
+        Input::ReplayFrame current = { startTime, { 0, 0 }, true, 0, false };
+        input.SetReplay(&current, static_cast<double>(ticksPerSecond));
+
+        const auto start = std::chrono::steady_clock::now();
+        bool queued = false;    // The first event of this frame was queued by the previous one (FRAME_DEFERRED)
+        for (size_t i = 0; i < frames.size(); i++) {
+            const InputRecorder::FrameRecord& frame = frames[i].record;
+
+            for (size_t j = queued ? 1 : 0; j < frame.eventCount; j++) {
+                Feed(input, current, events[frames[i].firstEvent + j]);
+            }
+            queued = false;
+
+            // The recorded Update stopped on the next frame's first event : it has to be queued for this one to stop too
+            if ((frame.flags & InputRecorder::FRAME_DEFERRED) && i + 1 < frames.size() && frames[i + 1].record.eventCount > 0) {
+                Feed(input, current, events[frames[i + 1].firstEvent]);
+                queued = true;
+            }
+
+            if (paced) {
+                const double elapsed = static_cast<double>(frame.time - frames[0].record.time) / static_cast<double>(ticksPerSecond);
+                std::this_thread::sleep_until(start + std::chrono::duration<double>(elapsed));
+            }
+
+            current.time = frame.time;
+            current.cursor = { frame.cursorX, frame.cursorY };
+            current.mouseAnchorPending = (frame.flags & InputRecorder::FRAME_MOUSE_ANCHOR) != 0;
+            current.mouseAnchorTime = frame.mouseAnchorTime;
+            current.mouseInWindow = (frame.flags & InputRecorder::FRAME_MOUSE_IN_WINDOW) != 0;
+            input.Update(frame.deltaTime);
+
+            if (onFrame) {
+                onFrame(i);
+            }
+        }
+
+        input.SetReplay(nullptr, 0.);
+        return true;
+    }
+
+    void InputReplayer::Feed(Input& input, Input::ReplayFrame& current, const InputRecorder::EventRecord& event) {
+        current.time = event.time;
+
+        switch (static_cast<InputEvent::Type>(event.type)) {
+        case InputEvent::Type::KeyDown:
+            input.OnKeyDown(event.key);
+            break;
+        case InputEvent::Type::KeyUp:
+            input.OnKeyUp(event.key);
+            break;
+        case InputEvent::Type::MouseMove:
+            input.OnMouseMove(event.x, event.y);
+            break;
+        case InputEvent::Type::MouseWheel:
+            input.OnMouseWheel(event.x);
+            break;
+        }
+    }
+
+    double InputReplayer::GetDuration() const {
+        if (frames.empty() || ticksPerSecond <= 0) {
+            return 0.;
+        }
+        return static_cast<double>(frames.back().record.time - frames.front().record.time) / static_cast<double>(ticksPerSecond);
+    }
+    // End : InputReplayer
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include "Input.h"
+#include "..\FileManager\AppendWriter.h"
+
+namespace Input {
+    // Input capture (.inrec) : every Update of an Input with the events it consumed, its deltaTime,
+    //	the time it consumed them at, the cursor (and whether it was over the window) and where the mouse moves were measured from,
+    //	so InputReplayer can run the exact same Updates again.
+    //	Header | per Update : FrameRecord, then its EventRecords
+    // Start recording while no key is down : a replay starts from released keys, on an Input mapped the same way.
+    class InputRecorder {
+    public:
+        static constexpr UINT32 MAGIC = 0x43455249;    // "IREC"
+        static constexpr UINT32 VERSION = 3;
+
+        enum FrameFlags : UINT8 {
+            FRAME_NONE = 0,
+            FRAME_DEFERRED = 1 << 0,    // The Update stopped on the first event of the next one (already queued)
+            FRAME_MOUSE_ANCHOR = 1 << 1,    // A move at or after mouseAnchorTime was awaited to measure the next ones from
+            FRAME_MOUSE_IN_WINDOW = 1 << 2, // The cursor was over the window (the mouse actions ran)
+        };
+
+        struct Header {
+            UINT32 magic;
+            UINT32 version;
+            INT64 ticksPerSecond;
+            INT64 startTime;        // Time the key states were at when the recording began
+            UINT64 frameCount;
+        };
+        struct FrameRecord {
+            INT64 time;             // Time the events were consumed at
+            INT64 mouseAnchorTime;
+            FLOAT deltaTime;
+            INT32 cursorX;
+            INT32 cursorY;
+            UINT16 eventCount;
+            UINT8 flags;
+            UINT8 reserved;
+        };
+        struct EventRecord {
+            INT64 time;
+            UINT8 type;             // InputEvent::Type
+            UINT8 key;
+            INT16 x;                // Mouse positions and wheel deltas are 16 bits in their window messages
+            INT16 y;
+            UINT16 reserved;
+        };
+
+        InputRecorder() = default;
+        InputRecorder(const InputRecorder&) = delete;
+        InputRecorder& operator=(const InputRecorder&) = delete;
+        ~InputRecorder() { End(); }
+
+        // Records every Update of input (on its thread) into filePath, until End
+        bool Begin(Input& input, const wstring& filePath);
+        // Stops recording and writes the header, false if anything failed (the file doesn't replay then)
+        bool End();
+        bool IsRecording() const { return input != nullptr; }
+        UINT64 GetFrameCount() const { return header.frameCount; }
+
+    private:
+        friend class Input;
+
+        void RecordFrame(FLOAT deltaTime, INT64 time, POINT cursor, bool deferred, bool anchorPending, INT64 anchorTime, bool mouseInWindow, std::span<const InputEvent> events);
+
+        Input* input = nullptr;
+        wstring filePath;
+        FileManager::AppendWriter writer;
+        Header header = {};
+        vector<std::byte> frameBuffer;  // One Append per Update
+        bool failed = false;
+    };
+
+    // Runs a recording through an Input without a window nor a keyboard : the events go through
+    //	OnKeyDown / OnKeyUp / OnMouseMove / OnMouseWheel at their recorded times, then Update runs at the recorded
+    //	frame time with the recorded deltaTime and cursor (see Input::SetReplay). The same mappings get the same callbacks.
+    class InputReplayer {
+    public:
+        using FrameCallback = std::function<void(size_t frameIndex)>;
+
+        // Reads and validates the whole recording
+        bool Load(const wstring& filePath);
+
+        // Every frame, as fast as possible, or paced as far apart as they were recorded.
+        //	onFrame runs after each Update (checks, timings, rendering, ...).
+        bool Replay(Input& input, const FrameCallback& onFrame = {}, bool paced = false) const;
+
+        size_t GetFrameCount() const { return frames.size(); }
+        size_t GetEventCount() const { return events.size(); }
+        // Recorded time from the first to the last frame, in seconds
+        double GetDuration() const;
+
+    private:
+        struct Frame {
+            InputRecorder::FrameRecord record;
+            size_t firstEvent;
+        };
+
+        static void Feed(Input& input, Input::ReplayFrame& current, const InputRecorder::EventRecord& event);
+
+        INT64 ticksPerSecond = 0;
+        INT64 startTime = 0;
+        vector<Frame> frames;
+        vector<InputRecorder::EventRecord> events;
+    };
+}
@@ -0,0 +1,105 @@
+#include "MouseFilter.h"
+
+namespace Input {
+
+    // Start : MovingAverageFilter
+    MouseSample MovingAverageFilter::Apply(MouseSample sample, FLOAT elapsed) {
+        if (history.Size() == window) {
+            sumX -= history.Front().x;
+            sumY -= history.Front().y;
+            history.Pop();
+        }
+
+        history.Push(sample);
+        sumX += sample.x;
+        sumY += sample.y;
+
+        const double count = static_cast<double>(history.Size());
+        return { static_cast<FLOAT>(sumX / count), static_cast<FLOAT>(sumY / count) };
+    }
+    void MovingAverageFilter::Reset() {
+        history.Clear();
+        sumX = 0.0;
+        sumY = 0.0;
+    }
+
+    void MovingAverageFilter::SetWindow(size_t size) {
+        window = std::clamp<size_t>(size, 1, MAX_WINDOW);
+        while (history.Size() > window) {
+            sumX -= history.Front().x;
+            sumY -= history.Front().y;
+            history.Pop();
+        }
+    }
+    // End : MovingAverageFilter
+
+    // Start : ExponentialFilter
+    MouseSample ExponentialFilter::Apply(MouseSample sample, FLOAT elapsed) {
+        if (!primed) {
+            primed = true;
+            value = sample;
+            return value;
+        }
+
+        const FLOAT kept = std::pow(retention, elapsed / REFERENCE_INTERVAL);
+        value.x = value.x * kept + sample.x * (1.0f - kept);
+        value.y = value.y * kept + sample.y * (1.0f - kept);
+        return value;
+    }
+
+    void ExponentialFilter::SetRetention(FLOAT factor) {
+        // 1 would never move again
+        retention = std::clamp(factor, 0.0f, .99f);
+    }
+    // End : ExponentialFilter
+
+    // Start : OneEuroFilter
+    MouseSample OneEuroFilter::Apply(MouseSample sample, FLOAT elapsed) {
+        if (!primed) {
+            primed = true;
+            value = sample;
+            derivative = {};
+            return value;
+        }
+
+        return {
+            FilterAxis(sample.x, value.x, derivative.x, elapsed),
+            FilterAxis(sample.y, value.y, derivative.y, elapsed)
+        };
+    }
+
+    void OneEuroFilter::SetParameters(FLOAT minCutoff, FLOAT beta, FLOAT derivativeCutoff) {
+        this->minCutoff = std::max(minCutoff, 0.0f);
+        this->beta = std::max(beta, 0.0f);
+        this->derivativeCutoff = std::max(derivativeCutoff, 0.0f);
+    }
+
+    FLOAT OneEuroFilter::Alpha(FLOAT cutoff, FLOAT elapsed) {
+        const FLOAT tau = 1.0f / (2.0f * std::numbers::pi_v<FLOAT> * std::max(cutoff, 1e-3f));
+        return 1.0f / (1.0f + tau / elapsed);
+    }
+
+    FLOAT OneEuroFilter::FilterAxis(FLOAT sample, FLOAT& filtered, FLOAT& change, FLOAT elapsed) const {
+        const FLOAT rawChange = (sample - filtered) / elapsed;
+        change += Alpha(derivativeCutoff, elapsed) * (rawChange - change);
+
+        const FLOAT cutoff = minCutoff + beta * std::abs(change);
+        filtered += Alpha(cutoff, elapsed) * (sample - filtered);
+        return filtered;
+    }
+    // End : OneEuroFilter
+
+    // Start : MouseFilterChain
+    MouseSample MouseFilterChain::Apply(MouseSample sample, FLOAT elapsed) {
+        for (MouseFilterStage& stage : stages) {
+            sample = std::visit([&](auto& filter) { return filter.Apply(sample, elapsed); }, stage);
+        }
+        return sample;
+    }
+    void MouseFilterChain::Reset() {
+        for (MouseFilterStage& stage : stages) {
+            std::visit([](auto& filter) { filter.Reset(); }, stage);
+        }
+    }
+    // End : MouseFilterChain
+}
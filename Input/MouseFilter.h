@@ -0,0 +1,145 @@
+#pragma once
+#include "include.h"
+
+namespace Input {
+    // Fixed capacity ring : never allocates nor shifts, the items stay where they were pushed
+    template<typename T, size_t Capacity>
+    class RingBuffer {
+        static_assert(std::has_single_bit(Capacity), "Capacity must be a power of 2");
+
+    public:
+        // Only when not full
+        void Push(const T& item) {
+            assert(count < Capacity && "Pop before pushing into a full ring");
+            items[(first + count) & (Capacity - 1)] = item;
+            count++;
+        }
+        // Oldest item, only when not empty
+        const T& Front() const { return items[first]; }
+        void Pop() {
+            first = (first + 1) & (Capacity - 1);
+            count--;
+        }
+        void Clear() {
+            first = 0;
+            count = 0;
+        }
+
+        size_t Size() const { return count; }
+        bool IsEmpty() const { return count == 0; }
+        static constexpr size_t GetCapacity() { return Capacity; }
+
+    private:
+        std::array<T, Capacity> items = {};
+        size_t first = 0;
+        size_t count = 0;
+    };
+
+    // Mouse velocity in pixels per second
+    struct MouseSample {
+        FLOAT x = 0.0f;
+        FLOAT y = 0.0f;
+    };
+
+    // Every filter gets one sample per mouse move and the seconds since the previous one,
+    //	its first sample (after a Reset) goes through unchanged.
+
+    // Mean of the last window samples, kept as a running sum (O(1) per sample)
+    class MovingAverageFilter {
+    public:
+        static constexpr size_t MAX_WINDOW = 64;
+
+        explicit MovingAverageFilter(size_t window = 3) { SetWindow(window); }
+
+        MouseSample Apply(MouseSample sample, FLOAT elapsed);
+        void Reset();
+
+        // Clamped to [1, MAX_WINDOW], keeps the most recent samples
+        void SetWindow(size_t size);
+        size_t GetWindow() const { return window; }
+
+    private:
+        RingBuffer<MouseSample, MAX_WINDOW> history;
+        size_t window = 1;
+        // double : the sum doesn't drift over a session of adding and removing samples
+        double sumX = 0.0;
+        double sumY = 0.0;
+    };
+
+    // Exponential smoothing measured in time, not in samples : the same on a 125 Hz and an 8000 Hz mouse
+    class ExponentialFilter {
+    public:
+        // Part of the smoothed value kept after 1/60 s, [0, 1[ (0 : no smoothing)
+        explicit ExponentialFilter(FLOAT retention = .3f) { SetRetention(retention); }
+
+        MouseSample Apply(MouseSample sample, FLOAT elapsed);
+        void Reset() { primed = false; }
+
+        void SetRetention(FLOAT factor);
+        FLOAT GetRetention() const { return retention; }
+
+    private:
+        static constexpr FLOAT REFERENCE_INTERVAL = 1.0f / 60.0f;
+
+        FLOAT retention = 0.0f;
+        MouseSample value;
+        bool primed = false;
+    };
+
+    // One Euro filter (Casiez et al.) : a low-pass whose cutoff rises with the speed of change,
+    //	smooth when aiming slowly, little lag when turning fast
+    class OneEuroFilter {
+    public:
+        // minCutoff (Hz) : smoothing at rest, beta : how fast the cutoff rises with the change of the velocity,
+        //	derivativeCutoff (Hz) : smoothing of that change
+        explicit OneEuroFilter(FLOAT minCutoff = 10.0f, FLOAT beta = .005f, FLOAT derivativeCutoff = 10.0f)
+            : minCutoff(minCutoff), beta(beta), derivativeCutoff(derivativeCutoff) {}
+
+        MouseSample Apply(MouseSample sample, FLOAT elapsed);
+        void Reset() { primed = false; }
+
+        void SetParameters(FLOAT minCutoff, FLOAT beta, FLOAT derivativeCutoff);
+
+    private:
+        static FLOAT Alpha(FLOAT cutoff, FLOAT elapsed);
+        FLOAT FilterAxis(FLOAT sample, FLOAT& filtered, FLOAT& change, FLOAT elapsed) const;
+
+        FLOAT minCutoff;
+        FLOAT beta;
+        FLOAT derivativeCutoff;
+        MouseSample value;
+        MouseSample derivative;
+        bool primed = false;
+    };
+
+    using MouseFilterStage = std::variant<MovingAverageFilter, ExponentialFilter, OneEuroFilter>;
+
+    // Stages applied in order to every mouse move. Only Add / Clear allocate.
+    class MouseFilterChain {
+    public:
+        MouseFilterChain() = default;
+        MouseFilterChain(std::initializer_list<MouseFilterStage> stages) : stages(stages) {}
+
+        MouseSample Apply(MouseSample sample, FLOAT elapsed);
+        // Forgets the motion, keeps the stages
+        void Reset();
+
+        void Add(const MouseFilterStage& stage) { stages.push_back(stage); }
+        void Clear() { stages.clear(); }
+        bool IsEmpty() const { return stages.empty(); }
+
+        // First stage of this type, nullptr if there is none
+        template<typename Filter>
+        Filter* Find() {
+            for (MouseFilterStage& stage : stages) {
+                if (Filter* filter = std::get_if<Filter>(&stage)) {
+                    return filter;
+                }
+            }
+            return nullptr;
+        }
+
+    private:
+        std::vector<MouseFilterStage> stages;
+    };
+}
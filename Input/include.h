@@ -1,5 +1,7 @@
 #pragma once
+#ifndef NOMINMAX
 #define NOMINMAX
+#endif
 
 #include <Windows.h>
 #include <string>
@@ -9,8 +11,20 @@
 #include <concepts>
 #include <stdexcept>
 #include <vector>
+#include <deque>
+#include <span>
+#include <string_view>
 #include <functional>
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <initializer_list>
+#include <variant>
+#include <cmath>
+#include <numbers>
+#include <new>
+#include <xmmintrin.h>
 #pragma comment(lib, "user32.lib")
 
 #ifdef max
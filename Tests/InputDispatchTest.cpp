@@ -0,0 +1,124 @@
+#include "..\Input\InputManager.h"
+#include <cstdio>
+#include <string>
+
+#pragma comment(lib, "Input.lib")
+#pragma comment(lib, "LogManager.lib")
+
+// Binding changes made from inside a callback (Input runs the stored callables in place)
+// Usage : InputDispatchTest.exe   (returns the number of failed checks)
+
+static int failures = 0;
+
+static void Check(bool condition, const wchar_t* what) {
+    wprintf(L"%ls : %ls\n", condition ? L"ok  " : L"FAIL", what);
+    if (!condition) {
+        failures++;
+    }
+}
+
+// Press then release key, one Update each
+static void Tap(Input::Input& input, Key key) {
+    input.OnKeyDown(static_cast<WPARAM>(key));
+    input.Update(1.0f / 60.0f);
+    input.OnKeyUp(static_cast<WPARAM>(key));
+    input.Update(1.0f / 60.0f);
+}
+
+int wmain() {
+    // Start : A callback unmaps its own action
+    {
+        Input::Input input;
+        // Captures a string : a destroyed closure would be read after it is freed
+        std::string name = "a capture long enough to live on the heap, not in the small string buffer";
+        int calls = 0;
+        std::string seen;
+        input.MapAction("Self", Key::Space, [&input, &calls, &seen, name] {
+            calls++;
+            input.UnmapAction("Self");
+            seen = name;
+        }, KeyAction::SimplePress);
+
+        Tap(input, Key::Space);
+        Check(calls == 1 && seen == name, L"self unmap : the running callback finished with its captures");
+        Check(!input.IsActionMapped("Self"), L"self unmap : unmapped once the callbacks returned");
+
+        Tap(input, Key::Space);
+        Check(calls == 1, L"self unmap : not called anymore");
+    }
+    // End : A callback unmaps its own action
+
+    // Start : A callback remaps its own action
+    {
+        Input::Input input;
+        int first = 0;
+        int second = 0;
+        input.MapAction("Swap", Key::E, [&] {
+            first++;
+            input.MapAction("Swap", Key::E, [&second] { second++; }, KeyAction::SimplePress);
+        }, KeyAction::SimplePress);
+
+        Tap(input, Key::E);
+        Tap(input, Key::E);
+        Check(first == 1 && second == 1, L"self remap : the new callback runs from the next press");
+    }
+    // End : A callback remaps its own action
+
+    // Start : A callback unmaps an action that runs after it in the same frame
+    {
+        Input::Input input;
+        int firstCalls = 0;
+        int secondCalls = 0;
+        input.MapAction("First", Key::F, [&] {
+            firstCalls++;
+            input.UnmapAction("Second");
+        }, KeyAction::SimplePress);
+        input.MapAction("Second", Key::F, [&] {
+            secondCalls++;
+            input.UnmapAction("First");
+        }, KeyAction::SimplePress);
+
+        Tap(input, Key::F);
+        Check(firstCalls + secondCalls == 1, L"unmapped later in the frame : skipped");
+    }
+    // End : A callback unmaps an action that runs after it
+
+    // Start : A binding switches the InputManager context (Escape -> menu)
+    {
+        Input::Input input;
+        InputManager::InputManager manager(&input);
+        int menuCalls = 0;
+        int gameCalls = 0;
+
+        const UINT8 game = manager.CreateContext("Game");
+        const UINT8 menu = manager.CreateContext("Menu");
+        manager.AddInputMap(game, { "Pause", Key::Escape, [&] { gameCalls++; manager.ChangeContext(menu); }, KeyAction::SimplePress });
+        manager.AddInputMap(menu, { "Resume", Key::Escape, [&] { menuCalls++; manager.ChangeContext(game); }, KeyAction::SimplePress });
+        manager.UseContext(game);
+
+        Tap(input, Key::Escape);
+        Check(gameCalls == 1 && menuCalls == 0 && input.IsActionMapped("Resume") && !input.IsActionMapped("Pause"), L"context switch : game -> menu");
+        Tap(input, Key::Escape);
+        Check(gameCalls == 1 && menuCalls == 1 && input.IsActionMapped("Pause") && !input.IsActionMapped("Resume"), L"context switch : menu -> game");
+    }
+    // End : A binding switches the InputManager context
+
+    // Start : Mouse actions and axes
+    {
+        Input::Input input;
+        int axisCalls = 0;
+        input.MapAxis("Move", Key::D, Key::A, [&](float) {
+            axisCalls++;
+            input.UnmapAxis("Move");
+        });
+
+        input.OnKeyDown(static_cast<WPARAM>(Key::D));
+        input.Update(1.0f / 60.0f);
+        input.Update(1.0f / 60.0f);
+        Check(axisCalls == 1, L"self unmap : axis");
+    }
+    // End : Mouse actions and axes
+
+    wprintf(L"%d failed\n", failures);
+    return failures;
+}
@@ -0,0 +1,36 @@
+#include "..\FileManager\FileManager.h"
+#include <cstdio>
+
+#pragma comment(lib, "FileManager.lib")
+#pragma comment(lib, "LogManager.lib")
+
+// Packs a directory into a .pak archive (see FileManager/Archive.h)
+// Usage : PakBuilder.exe [-c] <directory> <archive.pak>   (-c compresses the entries)
+
+int wmain(int argc, wchar_t* argv[]) {
+    const bool compress = argc > 1 && wstring(argv[1]) == L"-c";
+    const int first = compress ? 2 : 1;
+
+    if (argc != first + 2) {
+        wprintf(L"Usage : %ls [-c] <directory> <archive.pak>\n", argv[0]);
+        return 1;
+    }
+
+    const wstring dirPath = argv[first];
+    const wstring archivePath = argv[first + 1];
+
+    if (!FileManager::Archive::Build(dirPath, archivePath, compress)) {
+        wprintf(L"Couldn't pack %ls\n", dirPath.c_str());
+        return 1;
+    }
+
+    // Reopen it : the archive is validated the same way the game will
+    FileManager::Archive archive;
+    if (!archive.Open(archivePath)) {
+        wprintf(L"%ls was written but doesn't validate\n", archivePath.c_str());
+        return 1;
+    }
+
+    wprintf(L"%ls : %u files\n", archivePath.c_str(), archive.GetEntryCount());
+    return 0;
+}
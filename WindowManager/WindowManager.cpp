@@ -79,7 +79,8 @@ namespace WindowManager {
             }
             break;
         case WM_MOUSEMOVE:
-            //input->OnMouseMove(LOWORD(lParam), HIWORD(lParam)); // TODO
+            // Signed : client coordinates go negative when the mouse is captured outside of the window
+            input->OnMouseMove(static_cast<SHORT>(LOWORD(lParam)), static_cast<SHORT>(HIWORD(lParam)));
             break;
         default:
             return DefWindowProc(hWnd, message, wParam, lParam);